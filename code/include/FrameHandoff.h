@@ -0,0 +1,102 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+
+namespace itp {
+
+	/**
+	 * @brief lock-free single-producer / single-consumer triple buffer
+	 *
+	 * The producer fills getWriteBuffer() and calls publish(); the consumer calls acquire() and reads
+	 * getReadBuffer(). Each side owns one slot and the third is exchanged through a single atomic word,
+	 * so neither side ever waits and the consumer always sees the latest complete publication.
+	 * After publishing, the producer's new slot starts as a copy of the published one, so a producer
+	 * may update a few fields at a time (e.g. one stream per event handler) and still publish full sets.
+	 */
+	template <typename T> class TripleBuffer {
+	public:
+
+		typedef std::shared_ptr<TripleBuffer>	Ref;
+
+	private:
+
+		static const unsigned kIndexMask	= 0x3; //!< slot index bits of shared word
+		static const unsigned kFreshBit		= 0x4; //!< set when shared slot holds an unread publication
+
+		T						mSlots[ 3 ];	//!< buffer slots
+		std::atomic<unsigned>	mShared;		//!< index of exchanged slot, plus fresh bit
+		unsigned				mWriteIndex;	//!< slot owned by producer
+		unsigned				mReadIndex;		//!< slot owned by consumer
+
+		/** @brief default constructor */
+		TripleBuffer() :
+			mShared( 1 ),
+			mWriteIndex( 0 ),
+			mReadIndex( 2 )
+		{ /* no-op */ }
+
+		/** @brief non-copyable */
+		TripleBuffer(const TripleBuffer&);
+		TripleBuffer& operator=(const TripleBuffer&);
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename TripleBuffer::Ref create(Args&& ... args)
+		{
+			return typename TripleBuffer::Ref( new TripleBuffer( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns slot being filled (producer only) */
+		T& getWriteBuffer()
+		{
+			return mSlots[ mWriteIndex ];
+		}
+
+		/** @brief hands filled slot to consumer and carries its contents over to the next write slot (producer only) */
+		void publish()
+		{
+			unsigned tPublished = mWriteIndex;
+			mWriteIndex = mShared.exchange( tPublished | kFreshBit, std::memory_order_acq_rel ) & kIndexMask;
+			// Published slot is only read from here on, by either side:
+			mSlots[ mWriteIndex ] = mSlots[ tPublished ];
+		}
+
+		/** @brief takes latest publication, if any; returns true when read slot changed (consumer only) */
+		bool acquire()
+		{
+			if( ( mShared.load( std::memory_order_relaxed ) & kFreshBit ) == 0 ) return false;
+			mReadIndex = mShared.exchange( mReadIndex, std::memory_order_acq_rel ) & kIndexMask;
+			return true;
+		}
+
+		/** @brief returns latest acquired slot (consumer only) */
+		const T& getReadBuffer() const
+		{
+			return mSlots[ mReadIndex ];
+		}
+	};
+
+	/** @brief latest frames of each Kinect stream, as handed from device event handlers to the render loop */
+	struct KinectFrameSet
+	{
+		ci::Surface8uRef	mColor;		//!< latest color frame
+		ci::Channel16uRef	mDepth;		//!< latest depth frame
+		ci::Channel8uRef	mBody;		//!< latest body-index frame
+		long long			mTimeStamp;	//!< timestamp of latest depth frame (in 100ns ticks)
+
+		/** @brief default constructor */
+		KinectFrameSet() :
+			mTimeStamp( 0LL )
+		{ /* no-op */ }
+	};
+
+	typedef TripleBuffer<KinectFrameSet> KinectFrameHandoff;
+
+} // namespace itp
@@ -0,0 +1,234 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "cinder/Surface.h"
+
+#if ! defined( ITP_MULTITRACK_HEADLESS )
+	#include "cinder/gl/gl.h"
+	#include "cinder/gl/Fbo.h"
+	#include "cinder/gl/Pbo.h"
+	#include "cinder/gl/scoped.h"
+#endif
+
+#include <multitrack/FramePool.h>
+
+namespace itp {
+
+	/** @brief frame read back from a capture source, tagged with the value given when its capture started */
+	struct ReadbackFrame
+	{
+		ci::SurfaceRef	mSurface;	//!< captured pixels (pooled)
+		long long		mTag;		//!< caller's tag, e.g. sensor timestamp of the captured frame
+
+		/** @brief default constructor */
+		ReadbackFrame() :
+			mTag( 0LL )
+		{ /* no-op */ }
+	};
+
+	/**
+	 * @brief pipelined pixel readback
+	 *
+	 * capture() starts reading the source's current contents and returns the frame whose capture started
+	 * getLatency() calls earlier, so the caller never waits for the copy it just requested. Frames come back
+	 * in capture order, carrying the tag they were captured with; flush() returns the frames still in flight.
+	 */
+	class FrameReadback {
+	public:
+
+		typedef std::shared_ptr<FrameReadback> Ref;
+
+		/** @brief destructor */
+		virtual ~FrameReadback() { /* no-op */ }
+
+		/** @brief starts capture of source tagged iTag; returns true and sets oFrame when an earlier capture is complete */
+		virtual bool capture(long long iTag, ReadbackFrame& oFrame) = 0;
+
+		/** @brief completes all captures in flight, appending them to oFrames in capture order */
+		virtual void flush(std::vector<ReadbackFrame>& oFrames) = 0;
+
+		/** @brief returns number of capture calls between start and return of a frame */
+		virtual size_t getLatency() const = 0;
+	};
+
+	/** @brief readback copying a CPU surface (for headless builds and CPU compositing); frames return immediately */
+	class SurfaceReadback : public FrameReadback {
+	public:
+
+		typedef std::shared_ptr<SurfaceReadback>		Ref;
+		typedef std::function<ci::SurfaceRef(void)>		SourceFn; //!< returns surface to capture, or NULL
+
+	private:
+
+		SourceFn										mSourceFn;	//!< capture source
+		multitrack::FramePoolT<ci::SurfaceRef>::Ref		mPool;		//!< recycled output surfaces
+
+		/** @brief default constructor */
+		SurfaceReadback(SourceFn iSourceFn, multitrack::FramePoolT<ci::SurfaceRef>::Ref iPool = multitrack::FramePoolT<ci::SurfaceRef>::Ref()) :
+			mSourceFn( iSourceFn ),
+			mPool( iPool ? iPool : multitrack::FramePoolT<ci::SurfaceRef>::create() )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static SurfaceReadback::Ref create(Args&& ... args)
+		{
+			return SurfaceReadback::Ref( new SurfaceReadback( std::forward<Args>( args )... ) );
+		}
+
+		bool capture(long long iTag, ReadbackFrame& oFrame) override
+		{
+			ci::SurfaceRef tSource = mSourceFn ? mSourceFn() : ci::SurfaceRef();
+			if( ! tSource ) return false;
+			// Copy rows into pooled surface of same layout:
+			ci::SurfaceRef tOutput = multitrack::acquire_surface( *mPool, tSource->getSize(), tSource->hasAlpha() );
+			size_t tRowBytes = size_t( tSource->getWidth() ) * tSource->getPixelInc();
+			for( int32_t y = 0; y < tSource->getHeight(); y++ ) {
+				std::memcpy( tOutput->getData( ci::ivec2( 0, y ) ), tSource->getData( ci::ivec2( 0, y ) ), tRowBytes );
+			}
+			oFrame.mSurface	= tOutput;
+			oFrame.mTag		= iTag;
+			return true;
+		}
+
+		void flush(std::vector<ReadbackFrame>& oFrames) override { /* no-op */ }
+
+		size_t getLatency() const override { return 0; }
+	};
+
+#if ! defined( ITP_MULTITRACK_HEADLESS )
+
+	/**
+	 * @brief asynchronous framebuffer readback through a ring of pixel-pack buffers
+	 *
+	 * Each capture issues glReadPixels into the next buffer of the ring, which returns without waiting for
+	 * the GPU, and fences it. The buffer is mapped only when its slot comes around again, iDepth captures
+	 * later (2 = double, 3 = triple buffering), by which time the transfer has normally completed.
+	 */
+	class PboReadback : public FrameReadback {
+	public:
+
+		typedef std::shared_ptr<PboReadback> Ref;
+
+		static const size_t kDefaultDepth = 3; //!< default number of buffers in flight
+
+	private:
+
+		/** @brief ring slot */
+		struct Slot
+		{
+			ci::gl::PboRef	mPbo;		//!< pixel-pack buffer
+			GLsync			mFence;		//!< signalled when transfer completes
+			long long		mTag;		//!< caller's tag
+			bool			mPending;	//!< true while transfer is in flight
+		};
+
+		ci::gl::FboRef									mFbo;		//!< capture source
+		std::vector<Slot>								mSlots;		//!< buffer ring
+		size_t											mNext;		//!< slot of next capture
+		multitrack::FramePoolT<ci::SurfaceRef>::Ref		mPool;		//!< recycled output surfaces
+
+		/** @brief default constructor */
+		PboReadback(const ci::gl::FboRef& iFbo, size_t iDepth = kDefaultDepth, multitrack::FramePoolT<ci::SurfaceRef>::Ref iPool = multitrack::FramePoolT<ci::SurfaceRef>::Ref()) :
+			mFbo( iFbo ),
+			mSlots( std::max<size_t>( iDepth, 1 ) ),
+			mNext( 0 ),
+			mPool( iPool ? iPool : multitrack::FramePoolT<ci::SurfaceRef>::create() )
+		{
+			GLsizeiptr tBytes = GLsizeiptr( mFbo->getWidth() ) * mFbo->getHeight() * 4;
+			for( auto& tSlot : mSlots ) {
+				tSlot.mPbo		= ci::gl::Pbo::create( GL_PIXEL_PACK_BUFFER, tBytes, NULL, GL_STREAM_READ );
+				tSlot.mFence	= 0;
+				tSlot.mTag		= 0LL;
+				tSlot.mPending	= false;
+			}
+		}
+
+		/** @brief waits for slot's transfer and copies it into a pooled surface (rows flipped to top-down order) */
+		void retrieve(Slot& ioSlot, ReadbackFrame& oFrame)
+		{
+			// Wait for transfer (normally already complete):
+			if( ioSlot.mFence ) {
+				glClientWaitSync( ioSlot.mFence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64( 1000000000 ) );
+				glDeleteSync( ioSlot.mFence );
+				ioSlot.mFence = 0;
+			}
+			ioSlot.mPending = false;
+			// Copy rows from mapped buffer:
+			ci::SurfaceRef tOutput = multitrack::acquire_surface( *mPool, mFbo->getSize(), true );
+			size_t tRowBytes = size_t( mFbo->getWidth() ) * 4;
+			int32_t tHeight = mFbo->getHeight();
+			ci::gl::ScopedBuffer tBufferScope( ioSlot.mPbo );
+			const uint8_t* tSrc = static_cast<const uint8_t*>( ioSlot.mPbo->mapBufferRange( 0, tRowBytes * tHeight, GL_MAP_READ_BIT ) );
+			if( tSrc ) {
+				for( int32_t y = 0; y < tHeight; y++ ) {
+					std::memcpy( tOutput->getData( ci::ivec2( 0, tHeight - 1 - y ) ), tSrc + y * tRowBytes, tRowBytes );
+				}
+				ioSlot.mPbo->unmap();
+			}
+			oFrame.mSurface	= tOutput;
+			oFrame.mTag		= ioSlot.mTag;
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static PboReadback::Ref create(Args&& ... args)
+		{
+			return PboReadback::Ref( new PboReadback( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief destructor */
+		~PboReadback()
+		{
+			for( auto& tSlot : mSlots ) {
+				if( tSlot.mFence ) glDeleteSync( tSlot.mFence );
+			}
+		}
+
+		bool capture(long long iTag, ReadbackFrame& oFrame) override
+		{
+			Slot& tSlot = mSlots[ mNext ];
+			mNext = ( mNext + 1 ) % mSlots.size();
+			// Collect oldest capture before reusing its buffer:
+			bool tReady = tSlot.mPending;
+			if( tReady ) retrieve( tSlot, oFrame );
+			// Start transfer into buffer (returns without waiting for GPU):
+			{
+				ci::gl::ScopedFramebuffer tFboScope( GL_READ_FRAMEBUFFER, mFbo->getId() );
+				ci::gl::ScopedBuffer tBufferScope( tSlot.mPbo );
+				glReadBuffer( GL_COLOR_ATTACHMENT0 );
+				glReadPixels( 0, 0, mFbo->getWidth(), mFbo->getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+			}
+			tSlot.mFence	= glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+			tSlot.mTag		= iTag;
+			tSlot.mPending	= true;
+			return tReady;
+		}
+
+		void flush(std::vector<ReadbackFrame>& oFrames) override
+		{
+			// Oldest capture is in next slot:
+			for( size_t i = 0; i < mSlots.size(); i++ ) {
+				Slot& tSlot = mSlots[ ( mNext + i ) % mSlots.size() ];
+				if( ! tSlot.mPending ) continue;
+				ReadbackFrame tFrame;
+				retrieve( tSlot, tFrame );
+				oFrames.push_back( tFrame );
+			}
+		}
+
+		size_t getLatency() const override { return mSlots.size(); }
+	};
+
+#endif
+
+} // namespace itp
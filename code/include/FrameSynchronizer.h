@@ -0,0 +1,288 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+
+#include <multitrack/PointCloud.h>
+
+namespace itp {
+
+	/** @brief color, depth, body-index and body frames captured at the same sensor tick */
+	struct KinectMatchedFrames
+	{
+		long long						mTimeStamp;	//!< timestamp of depth frame (in 100ns ticks)
+		ci::Surface8uRef				mColor;		//!< color frame
+		ci::Channel16uRef				mDepth;		//!< depth frame
+		ci::Channel8uRef				mBody;		//!< body-index frame
+		multitrack::PointCloudRef		mBodies;	//!< tracked body joints
+
+		/** @brief default constructor */
+		KinectMatchedFrames() :
+			mTimeStamp( 0LL )
+		{ /* no-op */ }
+	};
+
+	/**
+	 * @brief groups frames from the Kinect streams into matched sets by timestamp
+	 *
+	 * Each stream keeps a few pending frames. Depth is the reference stream: a set is emitted once every
+	 * other enabled stream holds a frame within the tolerance of the oldest pending depth frame. A depth
+	 * frame that can no longer be matched, a frame that falls behind every pending depth frame, and a frame
+	 * pushed out of a full queue all count as dropped; a frame older than the last emitted set counts as late.
+	 * Pushes may come from device threads; the match callback runs on the pushing thread, with sets in order.
+	 */
+	class KinectFrameSynchronizer {
+	public:
+
+		typedef std::shared_ptr<KinectFrameSynchronizer>	Ref;
+
+		typedef std::function<void(const KinectMatchedFrames&)>	MatchFn;
+
+		enum Stream
+		{
+			COLOR,
+			DEPTH,
+			BODY_INDEX,
+			BODY,
+			STREAM_COUNT
+		};
+
+		static const long long	kDefaultTolerance	= 166666LL;	//!< half a 30 Hz frame (in 100ns ticks)
+		static const size_t		kDefaultDepth		= 4;		//!< pending frames kept per stream
+
+	private:
+
+		typedef std::deque<KinectMatchedFrames> FrameDeque; //!< pending frames (only the stream's own member is set)
+
+		std::mutex		mDeliverMutex;					//!< serializes pushes, so sets are delivered in order
+		std::mutex		mMutex;							//!< guards all members below
+		FrameDeque		mQueues[ STREAM_COUNT ];		//!< pending frames per stream, oldest first
+		bool			mEnabled[ STREAM_COUNT ];		//!< streams required for a match
+		size_t			mDropped[ STREAM_COUNT ];		//!< dropped frames per stream
+		size_t			mLate[ STREAM_COUNT ];			//!< late frames per stream
+		size_t			mMatched;						//!< emitted sets
+		long long		mTolerance;						//!< maximum distance to depth timestamp (in 100ns ticks)
+		size_t			mDepth;							//!< maximum pending frames per stream
+		bool			mHasMatched;					//!< true once a set was emitted
+		long long		mLastMatched;					//!< timestamp of last emitted set
+		MatchFn			mMatchFn;						//!< receives matched sets
+
+		/** @brief default constructor */
+		KinectFrameSynchronizer(long long iTolerance = kDefaultTolerance, size_t iDepth = kDefaultDepth) :
+			mMatched( 0 ),
+			mTolerance( iTolerance ),
+			mDepth( iDepth > 0 ? iDepth : 1 ),
+			mHasMatched( false ),
+			mLastMatched( 0LL )
+		{
+			for( size_t i = 0; i < STREAM_COUNT; i++ ) {
+				mEnabled[ i ]	= true;
+				mDropped[ i ]	= 0;
+				mLate[ i ]		= 0;
+			}
+		}
+
+		/** @brief queues a frame and emits all sets that can be matched */
+		void push(Stream iStream, const KinectMatchedFrames& iFrame)
+		{
+			std::lock_guard<std::mutex> tDeliverLock( mDeliverMutex );
+			std::vector<KinectMatchedFrames> tSets;
+			MatchFn tMatchFn;
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				if( ! mEnabled[ iStream ] ) return;
+				// Reject frames older than last emitted set:
+				bool tLate = ( iStream == DEPTH ) ? ( iFrame.mTimeStamp <= mLastMatched ) : ( iFrame.mTimeStamp < mLastMatched - mTolerance );
+				if( mHasMatched && tLate ) {
+					mLate[ iStream ]++;
+					return;
+				}
+				FrameDeque& tQueue = mQueues[ iStream ];
+				tQueue.push_back( iFrame );
+				if( tQueue.size() > mDepth ) {
+					tQueue.pop_front();
+					mDropped[ iStream ]++;
+				}
+				match( tSets );
+				tMatchFn = mMatchFn;
+			}
+			if( tMatchFn ) {
+				for( const auto& tSet : tSets ) tMatchFn( tSet );
+			}
+		}
+
+		/** @brief emits matched sets, oldest first (expects lock to be held) */
+		void match(std::vector<KinectMatchedFrames>& oSets)
+		{
+			FrameDeque& tDepthQueue = mQueues[ DEPTH ];
+			while( ! tDepthQueue.empty() ) {
+				long long tTime = tDepthQueue.front().mTimeStamp;
+				size_t tPick[ STREAM_COUNT ] = { 0 };
+				bool tReady = true;
+				bool tUnmatched = false;
+				for( size_t s = 0; s < STREAM_COUNT; s++ ) {
+					if( s == DEPTH || ! mEnabled[ s ] ) continue;
+					FrameDeque& tQueue = mQueues[ s ];
+					// Discard frames too old for this or any later depth frame:
+					while( ! tQueue.empty() && tQueue.front().mTimeStamp < tTime - mTolerance ) {
+						tQueue.pop_front();
+						mDropped[ s ]++;
+					}
+					// Wait for stream:
+					if( tQueue.empty() ) {
+						tReady = false;
+						continue;
+					}
+					// Pick nearest frame within tolerance:
+					bool tFound = false;
+					long long tBest = 0LL;
+					for( size_t i = 0; i < tQueue.size(); i++ ) {
+						long long tDistance = std::llabs( tQueue[ i ].mTimeStamp - tTime );
+						if( tDistance <= mTolerance && ( ! tFound || tDistance < tBest ) ) {
+							tFound		= true;
+							tBest		= tDistance;
+							tPick[ s ]	= i;
+						}
+					}
+					// Oldest pending frame is already past tolerance, so depth frame can never be matched:
+					if( ! tFound ) {
+						tUnmatched = true;
+						break;
+					}
+				}
+				if( tUnmatched ) {
+					tDepthQueue.pop_front();
+					mDropped[ DEPTH ]++;
+					continue;
+				}
+				if( ! tReady ) return;
+				// Assemble set and consume picked frames (and anything older):
+				KinectMatchedFrames tSet = tDepthQueue.front();
+				tDepthQueue.pop_front();
+				for( size_t s = 0; s < STREAM_COUNT; s++ ) {
+					if( s == DEPTH || ! mEnabled[ s ] ) continue;
+					FrameDeque& tQueue = mQueues[ s ];
+					const KinectMatchedFrames& tFrame = tQueue[ tPick[ s ] ];
+					if( s == COLOR )		tSet.mColor		= tFrame.mColor;
+					if( s == BODY_INDEX )	tSet.mBody		= tFrame.mBody;
+					if( s == BODY )			tSet.mBodies	= tFrame.mBodies;
+					tQueue.erase( tQueue.begin(), tQueue.begin() + tPick[ s ] + 1 );
+					mDropped[ s ] += tPick[ s ];
+				}
+				tSet.mTimeStamp = tTime;
+				mHasMatched		= true;
+				mLastMatched	= tTime;
+				mMatched++;
+				oSets.push_back( tSet );
+			}
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static KinectFrameSynchronizer::Ref create(Args&& ... args)
+		{
+			return KinectFrameSynchronizer::Ref( new KinectFrameSynchronizer( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief sets callback receiving matched sets */
+		void setMatchFn(MatchFn iMatchFn)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mMatchFn = iMatchFn;
+		}
+
+		/** @brief sets whether a stream is required for a match (depth is always required) */
+		void setStreamEnabled(Stream iStream, bool iEnabled)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			if( iStream == DEPTH ) return;
+			mEnabled[ iStream ] = iEnabled;
+			mQueues[ iStream ].clear();
+		}
+
+		/** @brief sets maximum distance between a frame and its depth frame (in 100ns ticks) */
+		void setTolerance(long long iTicks)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mTolerance = iTicks;
+		}
+
+		void pushColor(const ci::Surface8uRef& iColor, long long iTimeStamp)
+		{
+			KinectMatchedFrames tFrame;
+			tFrame.mTimeStamp	= iTimeStamp;
+			tFrame.mColor		= iColor;
+			push( COLOR, tFrame );
+		}
+
+		void pushDepth(const ci::Channel16uRef& iDepth, long long iTimeStamp)
+		{
+			KinectMatchedFrames tFrame;
+			tFrame.mTimeStamp	= iTimeStamp;
+			tFrame.mDepth		= iDepth;
+			push( DEPTH, tFrame );
+		}
+
+		void pushBodyIndex(const ci::Channel8uRef& iBody, long long iTimeStamp)
+		{
+			KinectMatchedFrames tFrame;
+			tFrame.mTimeStamp	= iTimeStamp;
+			tFrame.mBody		= iBody;
+			push( BODY_INDEX, tFrame );
+		}
+
+		void pushBodies(const multitrack::PointCloudRef& iBodies, long long iTimeStamp)
+		{
+			KinectMatchedFrames tFrame;
+			tFrame.mTimeStamp	= iTimeStamp;
+			tFrame.mBodies		= iBodies;
+			push( BODY, tFrame );
+		}
+
+		/** @brief returns number of emitted sets */
+		size_t getMatchedCount()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mMatched;
+		}
+
+		/** @brief returns number of frames of a stream that were not part of any set */
+		size_t getDroppedCount(Stream iStream)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mDropped[ iStream ];
+		}
+
+		/** @brief returns number of frames of a stream that arrived after a newer set was emitted */
+		size_t getLateCount(Stream iStream)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mLate[ iStream ];
+		}
+
+		/** @brief clears pending frames and counters */
+		void reset()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			for( size_t i = 0; i < STREAM_COUNT; i++ ) {
+				mQueues[ i ].clear();
+				mDropped[ i ]	= 0;
+				mLate[ i ]		= 0;
+			}
+			mMatched		= 0;
+			mHasMatched		= false;
+			mLastMatched	= 0LL;
+		}
+	};
+
+} // namespace itp
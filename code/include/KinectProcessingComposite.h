@@ -0,0 +1,303 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+
+#include <ParallelFor.h>
+#include <Simd.h>
+#include <multitrack/BodyIndexRle.h>
+
+namespace itp {
+
+	/** @brief returns nearest texel index for a normalized coordinate, clamped to edge (NaN maps to 0) */
+	static inline int32_t get_nearest_texel(float iCoord, float iSize, float iMax)
+	{
+		float tTexel = iCoord * iSize;
+		tTexel = ( tTexel > 0.0f ) ? tTexel : 0.0f;
+		tTexel = ( tTexel < iMax ) ? tTexel : iMax;
+		return (int32_t)tTexel;
+	}
+
+	/** @brief returns luma of an 8-bit pixel, with weights and rounding as in the grayscale shader variant */
+	static inline uint32_t get_grayscale_value(uint32_t iR, uint32_t iG, uint32_t iB)
+	{
+		return (uint32_t)( ( ( (float)iR * 0.299f + (float)iG * 0.587f ) + (float)iB * 0.114f ) + 0.5f );
+	}
+
+#if ITP_SIMD_SSE2
+	/** @brief converts four packed RGBA pixels to grayscale, keeping alpha */
+	static inline __m128i grayscale_pixels_x4(__m128i iPixels)
+	{
+		const __m128i	tMask	= _mm_set1_epi32( 0xFF );
+		__m128			tR		= _mm_cvtepi32_ps( _mm_and_si128( iPixels, tMask ) );
+		__m128			tG		= _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( iPixels, 8 ), tMask ) );
+		__m128			tB		= _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( iPixels, 16 ), tMask ) );
+		__m128			tY		= _mm_add_ps( _mm_mul_ps( tR, _mm_set1_ps( 0.299f ) ), _mm_mul_ps( tG, _mm_set1_ps( 0.587f ) ) );
+		tY = _mm_add_ps( _mm_add_ps( tY, _mm_mul_ps( tB, _mm_set1_ps( 0.114f ) ) ), _mm_set1_ps( 0.5f ) );
+		__m128i			tGray	= _mm_cvttps_epi32( tY );
+		__m128i			tAlpha	= _mm_and_si128( iPixels, _mm_set1_epi32( (int)0xFF000000 ) );
+		return _mm_or_si128( _mm_or_si128( tGray, _mm_slli_epi32( tGray, 8 ) ), _mm_or_si128( _mm_slli_epi32( tGray, 16 ), tAlpha ) );
+	}
+#endif
+
+	/**
+	 * @brief CPU implementation of kGlslKinectAlignSilhouetteFrag, split across worker threads
+	 *
+	 * Follows the shader drawn into a depth-sized framebuffer and read back top-down: alpha is 255 minus the
+	 * body-index value, and color comes from the color frame at the lookup coordinate, optionally converted
+	 * to grayscale, or is plain white in silhouette mode. Textures are sampled nearest and clamped to edge,
+	 * with the lookup coordinates as given (the color frame is addressed bottom-up, like the uploaded texture).
+	 * Stands in for the GPU path in headless builds (see SurfaceReadback), but is not compared against it;
+	 * test/CompositeTest checks that the SSE2 path matches the scalar path.
+	 */
+	class SilhouetteCompositor {
+	public:
+
+		typedef std::shared_ptr<SilhouetteCompositor> Ref;
+
+		enum Mode
+		{
+			COLOR,		//!< masked user color
+			GRAYSCALE,	//!< masked user color, converted to grayscale
+			SILHOUETTE	//!< masked white
+		};
+
+	private:
+
+		ParallelFor::Ref	mPool;		//!< worker pool
+		ci::Surface8uRef	mSurface;	//!< persistent output surface (RGBA)
+		Mode				mMode;		//!< composite mode
+		bool				mSimd;		//!< SSE2 path enabled (where compiled in)
+
+		/** @brief default constructor (0 threads uses hardware concurrency) */
+		SilhouetteCompositor(size_t iThreadCount = 0) :
+			mPool( ParallelFor::create( iThreadCount ) ),
+			mMode( COLOR ),
+			mSimd( true )
+		{ /* no-op */ }
+
+		/** @brief constructor sharing an existing worker pool */
+		SilhouetteCompositor(const ParallelFor::Ref& iPool) :
+			mPool( iPool ),
+			mMode( COLOR ),
+			mSimd( true )
+		{ /* no-op */ }
+
+		/** @brief composites row y of output surface from a body-index row with given pixel increment */
+		void compositeRow(const ci::Surface8u* iColor, const ci::Surface32f* iLookup, const uint8_t* iBody, int32_t iBodyInc, int32_t y)
+		{
+			const int32_t	tWidth	= mSurface->getWidth();
+			uint8_t*		tDst	= mSurface->getData( ci::ivec2( 0, y ) );
+			int32_t			x		= 0;
+			// Set to silhouette:
+			if( mMode == SILHOUETTE ) {
+#if ITP_SIMD_SSE2
+				// Expand sixteen body values to ( 255 255 255 255-b ) per step:
+				if( mSimd && iBodyInc == 1 ) {
+					const __m128i tOnes = _mm_set1_epi8( -1 );
+					for( ; x + 16 <= tWidth; x += 16 ) {
+						__m128i tAlpha	= _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( iBody + x ) ), tOnes );
+						__m128i tLo		= _mm_unpacklo_epi8( tOnes, tAlpha );
+						__m128i tHi		= _mm_unpackhi_epi8( tOnes, tAlpha );
+						_mm_storeu_si128( reinterpret_cast<__m128i*>( tDst + x * 4 ),      _mm_unpacklo_epi16( tOnes, tLo ) );
+						_mm_storeu_si128( reinterpret_cast<__m128i*>( tDst + x * 4 + 16 ), _mm_unpackhi_epi16( tOnes, tLo ) );
+						_mm_storeu_si128( reinterpret_cast<__m128i*>( tDst + x * 4 + 32 ), _mm_unpacklo_epi16( tOnes, tHi ) );
+						_mm_storeu_si128( reinterpret_cast<__m128i*>( tDst + x * 4 + 48 ), _mm_unpackhi_epi16( tOnes, tHi ) );
+					}
+				}
+#endif
+				for( ; x < tWidth; x++ ) {
+					tDst[ x * 4 + 0 ] = 255;
+					tDst[ x * 4 + 1 ] = 255;
+					tDst[ x * 4 + 2 ] = 255;
+					tDst[ x * 4 + 3 ] = 255 - iBody[ x * iBodyInc ];
+				}
+				return;
+			}
+			// Set from color frame at lookup coordinates:
+			const float*	tLookup		= iLookup->getData( ci::ivec2( 0, y ) );
+			const int32_t	tLookupInc	= iLookup->getPixelInc();
+			const int32_t	tColorW		= iColor->getWidth();
+			const int32_t	tColorH		= iColor->getHeight();
+			const float		tSizeX		= (float)tColorW;
+			const float		tSizeY		= (float)tColorH;
+			const float		tMaxX		= (float)( tColorW - 1 );
+			const float		tMaxY		= (float)( tColorH - 1 );
+			const uint8_t	tOffR		= iColor->getChannelOrder().getRedOffset();
+			const uint8_t	tOffG		= iColor->getChannelOrder().getGreenOffset();
+			const uint8_t	tOffB		= iColor->getChannelOrder().getBlueOffset();
+#if ITP_SIMD_SSE2
+			// Compute four texel addresses per step, then gather:
+			if( mSimd ) {
+				const __m128 tZero	= _mm_setzero_ps();
+				const __m128 tSzX	= _mm_set1_ps( tSizeX );
+				const __m128 tSzY	= _mm_set1_ps( tSizeY );
+				const __m128 tMxX	= _mm_set1_ps( tMaxX );
+				const __m128 tMxY	= _mm_set1_ps( tMaxY );
+				int32_t		tCols[ 4 ];
+				int32_t		tRows[ 4 ];
+				uint32_t	tPixels[ 4 ];
+				for( ; x + 4 <= tWidth; x += 4 ) {
+					const float* tSrc = tLookup + x * tLookupInc;
+					__m128 tU = _mm_setr_ps( tSrc[ 0 ], tSrc[ tLookupInc ], tSrc[ 2 * tLookupInc ], tSrc[ 3 * tLookupInc ] );
+					__m128 tV = _mm_setr_ps( tSrc[ 1 ], tSrc[ tLookupInc + 1 ], tSrc[ 2 * tLookupInc + 1 ], tSrc[ 3 * tLookupInc + 1 ] );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( tCols ), _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( tU, tSzX ), tZero ), tMxX ) ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( tRows ), _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( tV, tSzY ), tZero ), tMxY ) ) );
+					for( int32_t i = 0; i < 4; i++ ) {
+						const uint8_t* tTexel = iColor->getData( ci::ivec2( tCols[ i ], tColorH - 1 - tRows[ i ] ) );
+						tPixels[ i ] = (uint32_t)tTexel[ tOffR ] | ( (uint32_t)tTexel[ tOffG ] << 8 ) | ( (uint32_t)tTexel[ tOffB ] << 16 ) | ( (uint32_t)( 255 - iBody[ ( x + i ) * iBodyInc ] ) << 24 );
+					}
+					__m128i tOut = _mm_loadu_si128( reinterpret_cast<const __m128i*>( tPixels ) );
+					if( mMode == GRAYSCALE ) tOut = grayscale_pixels_x4( tOut );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( tDst + x * 4 ), tOut );
+				}
+			}
+#endif
+			// Composite remaining pixels:
+			for( ; x < tWidth; x++ ) {
+				const float*	tSrc	= tLookup + x * tLookupInc;
+				int32_t			tCol	= get_nearest_texel( tSrc[ 0 ], tSizeX, tMaxX );
+				int32_t			tRow	= get_nearest_texel( tSrc[ 1 ], tSizeY, tMaxY );
+				const uint8_t*	tTexel	= iColor->getData( ci::ivec2( tCol, tColorH - 1 - tRow ) );
+				uint8_t*		tPixel	= tDst + x * 4;
+				if( mMode == GRAYSCALE ) {
+					uint8_t tGray = (uint8_t)get_grayscale_value( tTexel[ tOffR ], tTexel[ tOffG ], tTexel[ tOffB ] );
+					tPixel[ 0 ] = tGray;
+					tPixel[ 1 ] = tGray;
+					tPixel[ 2 ] = tGray;
+				}
+				else {
+					tPixel[ 0 ] = tTexel[ tOffR ];
+					tPixel[ 1 ] = tTexel[ tOffG ];
+					tPixel[ 2 ] = tTexel[ tOffB ];
+				}
+				tPixel[ 3 ] = 255 - iBody[ x * iBodyInc ];
+			}
+		}
+
+		/** @brief composites rows [iRowBegin, iRowEnd) of output surface from a body-index channel */
+		void compositeRows(const ci::Surface8u* iColor, const ci::Surface32f* iLookup, const ci::Channel8u& iBody, size_t iRowBegin, size_t iRowEnd)
+		{
+			for( size_t y = iRowBegin; y < iRowEnd; y++ ) {
+				compositeRow( iColor, iLookup, iBody.getData( ci::ivec2( 0, int32_t( y ) ) ), iBody.getIncrement(), int32_t( y ) );
+			}
+		}
+
+		/** @brief composites rows [iRowBegin, iRowEnd) of output surface from a run-length packed body-index frame, expanding one row at a time */
+		void compositeRows(const ci::Surface8u* iColor, const ci::Surface32f* iLookup, const multitrack::BodyIndexRle& iBody, size_t iRowBegin, size_t iRowEnd)
+		{
+			if( iBody.getWidth() == 0 ) return;
+			std::vector<uint8_t> tRow( iBody.getWidth() );
+			for( size_t y = iRowBegin; y < iRowEnd; y++ ) {
+				iBody.unpackRow( int32_t( y ), &tRow[ 0 ] );
+				compositeRow( iColor, iLookup, &tRow[ 0 ], 1, int32_t( y ) );
+			}
+		}
+
+		/** @brief validates inputs and allocates output surface for a body-index frame of given size */
+		void prepare(const ci::Surface8uRef& iColor, const ci::Surface32fRef& iLookup, const ci::ivec2& iBodySize)
+		{
+			if( mMode != SILHOUETTE ) {
+				if( ! iColor || ! iLookup ) {
+					throw std::runtime_error( "SilhouetteCompositor requires color and lookup frames" );
+				}
+				if( iLookup->getSize() != iBodySize ) {
+					throw std::runtime_error( "SilhouetteCompositor received lookup and body-index frames of different size" );
+				}
+				if( iLookup->getPixelInc() < 2 || iColor->getPixelInc() < 3 ) {
+					throw std::runtime_error( "SilhouetteCompositor received color or lookup frame of unsupported layout" );
+				}
+			}
+			// Allocate surface:
+			if( ! mSurface || mSurface->getSize() != iBodySize ) {
+				mSurface = ci::Surface8u::create( iBodySize.x, iBodySize.y, true, ci::SurfaceChannelOrder::RGBA );
+			}
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static SilhouetteCompositor::Ref create(Args&& ... args)
+		{
+			return SilhouetteCompositor::Ref( new SilhouetteCompositor( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief composites a frame the size of the body-index frame (color and lookup may be NULL in silhouette mode); surface is only reallocated when size changes */
+		const ci::Surface8uRef& update(const ci::Surface8uRef& iColor, const ci::Surface32fRef& iLookup, const ci::Channel8uRef& iBody)
+		{
+			if( ! iBody ) {
+				throw std::runtime_error( "SilhouetteCompositor requires a body-index frame" );
+			}
+			prepare( iColor, iLookup, iBody->getSize() );
+			// Composite rows in parallel:
+			const ci::Surface8u*	tColor	= iColor.get();
+			const ci::Surface32f*	tLookup	= iLookup.get();
+			const ci::Channel8u&	tBody	= *iBody;
+			mPool->run( 0, iBody->getHeight(), [&] (size_t iBegin, size_t iEnd) {
+				compositeRows( tColor, tLookup, tBody, iBegin, iEnd );
+			} );
+			return mSurface;
+		}
+
+		/** @brief composites a frame from a run-length packed body-index frame (e.g. played back from a track), without expanding it in full */
+		const ci::Surface8uRef& update(const ci::Surface8uRef& iColor, const ci::Surface32fRef& iLookup, const multitrack::BodyIndexRleRef& iBody)
+		{
+			if( ! iBody ) {
+				throw std::runtime_error( "SilhouetteCompositor requires a body-index frame" );
+			}
+			prepare( iColor, iLookup, iBody->getSize() );
+			// Composite rows in parallel:
+			const ci::Surface8u*			tColor	= iColor.get();
+			const ci::Surface32f*			tLookup	= iLookup.get();
+			const multitrack::BodyIndexRle&	tBody	= *iBody;
+			mPool->run( 0, iBody->getHeight(), [&] (size_t iBegin, size_t iEnd) {
+				compositeRows( tColor, tLookup, tBody, iBegin, iEnd );
+			} );
+			return mSurface;
+		}
+
+		/** @brief sets composite mode */
+		void setMode(Mode iMode)
+		{
+			mMode = iMode;
+		}
+
+		/** @brief returns composite mode */
+		Mode getMode() const
+		{
+			return mMode;
+		}
+
+		/** @brief enables or disables SSE2 path (scalar path is used when disabled or not compiled in) */
+		void setSimdEnabled(bool iEnabled)
+		{
+			mSimd = iEnabled;
+		}
+
+		/** @brief returns true if SSE2 path is enabled */
+		bool isSimdEnabled() const
+		{
+			return mSimd;
+		}
+
+		/** @brief returns output surface (NULL before first update) */
+		const ci::Surface8uRef& getSurface() const
+		{
+			return mSurface;
+		}
+
+		/** @brief returns worker pool */
+		const ParallelFor::Ref& getPool() const
+		{
+			return mPool;
+		}
+	};
+
+} // namespace itp
@@ -0,0 +1,193 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "cinder/Channel.h"
+
+#include <Simd.h>
+
+namespace itp {
+
+	/**
+	 * @brief converts 16-bit depth frames to 8-bit channels for display, into a caller-owned channel
+	 *
+	 * Depth is clamped to [near, far] and mapped either linearly (near = 0, far = 255, as channel16To8 orders it)
+	 * or by inverse depth (near = 255, far = 0), which spends more of the 8-bit range on nearby surfaces.
+	 * Invalid (zero) depth always maps to 0. update() skips conversion when it is handed the same depth
+	 * timestamp and output channel as last time, so it can be called on every draw.
+	 */
+	class DepthConverter {
+	public:
+
+		typedef std::shared_ptr<DepthConverter> Ref;
+
+		enum Mapping
+		{
+			LINEAR,		//!< proportional to depth
+			INVERSE		//!< proportional to inverse depth
+		};
+
+		static const uint16_t kDefaultNearDepth	= 500;	//!< default near clamp (in millimeters)
+		static const uint16_t kDefaultFarDepth	= 4500;	//!< default far clamp (in millimeters)
+
+	private:
+
+		Mapping			mMapping;		//!< depth mapping
+		uint16_t		mNear;			//!< near clamp (in millimeters)
+		uint16_t		mFar;			//!< far clamp (in millimeters)
+		bool			mHasConverted;	//!< true once a frame was converted with current settings
+		long long		mTimeStamp;		//!< timestamp of last converted frame
+		const void*		mOutput;		//!< output buffer of last converted frame
+
+		/** @brief default constructor */
+		DepthConverter(Mapping iMapping = LINEAR, uint16_t iNear = kDefaultNearDepth, uint16_t iFar = kDefaultFarDepth) :
+			mMapping( iMapping ),
+			mHasConverted( false ),
+			mTimeStamp( 0LL ),
+			mOutput( NULL )
+		{
+			setRange( iNear, iFar );
+		}
+
+		/** @brief converts rows [iRowBegin, iRowEnd) */
+		void convertRows(const ci::Channel16u& iDepth, ci::Channel8u& oChannel, int32_t iRowBegin, int32_t iRowEnd) const
+		{
+			const int32_t	tWidth		= iDepth.getWidth();
+			const int32_t	tSrcInc		= iDepth.getIncrement();
+			const int32_t	tDstInc		= oChannel.getIncrement();
+			const bool		tInverse	= ( mMapping == INVERSE );
+			const float		tNear		= (float)mNear;
+			const float		tFar		= (float)mFar;
+			const float		tInvFar		= 1.0f / tFar;
+			const float		tOffset		= tInverse ? tInvFar : tNear;
+			const float		tScale		= tInverse ? 255.0f / ( 1.0f / tNear - tInvFar ) : 255.0f / ( tFar - tNear );
+			for( int32_t y = iRowBegin; y < iRowEnd; y++ ) {
+				const uint16_t*	tSrc	= iDepth.getData( ci::ivec2( 0, y ) );
+				uint8_t*		tDst	= oChannel.getData( ci::ivec2( 0, y ) );
+				int32_t			x		= 0;
+#if ITP_SIMD_SSE2
+				// Convert eight pixels per step:
+				if( tSrcInc == 1 && tDstInc == 1 ) {
+					const __m128i	tZeroI		= _mm_setzero_si128();
+					const __m128	tZero		= _mm_setzero_ps();
+					const __m128	tOne		= _mm_set1_ps( 1.0f );
+					const __m128	tHalf		= _mm_set1_ps( 0.5f );
+					const __m128	tNearV		= _mm_set1_ps( tNear );
+					const __m128	tFarV		= _mm_set1_ps( tFar );
+					const __m128	tOffsetV	= _mm_set1_ps( tOffset );
+					const __m128	tScaleV		= _mm_set1_ps( tScale );
+					for( ; x + 8 <= tWidth; x += 8 ) {
+						__m128i tZ		= _mm_loadu_si128( reinterpret_cast<const __m128i*>( tSrc + x ) );
+						__m128i tOut[ 2 ];
+						for( int32_t i = 0; i < 2; i++ ) {
+							__m128 tV		= _mm_cvtepi32_ps( i == 0 ? _mm_unpacklo_epi16( tZ, tZeroI ) : _mm_unpackhi_epi16( tZ, tZeroI ) );
+							__m128 tValid	= _mm_cmpneq_ps( tV, tZero );
+							tV = _mm_min_ps( _mm_max_ps( tV, tNearV ), tFarV );
+							if( tInverse ) tV = _mm_div_ps( tOne, tV );
+							tV = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( tV, tOffsetV ), tScaleV ), tHalf );
+							tOut[ i ] = _mm_and_si128( _mm_cvttps_epi32( tV ), _mm_castps_si128( tValid ) );
+						}
+						__m128i tPacked = _mm_packs_epi32( tOut[ 0 ], tOut[ 1 ] );
+						_mm_storel_epi64( reinterpret_cast<__m128i*>( tDst + x ), _mm_packus_epi16( tPacked, tPacked ) );
+					}
+				}
+#endif
+				// Convert remaining pixels:
+				for( ; x < tWidth; x++ ) {
+					uint16_t tZ = tSrc[ x * tSrcInc ];
+					if( tZ == 0 ) {
+						tDst[ x * tDstInc ] = 0;
+						continue;
+					}
+					float tV = (float)tZ;
+					tV = ( tV > tNear ) ? tV : tNear;
+					tV = ( tV < tFar ) ? tV : tFar;
+					if( tInverse ) tV = 1.0f / tV;
+					tDst[ x * tDstInc ] = (uint8_t)(int32_t)( ( tV - tOffset ) * tScale + 0.5f );
+				}
+			}
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static DepthConverter::Ref create(Args&& ... args)
+		{
+			return DepthConverter::Ref( new DepthConverter( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief converts depth frame into channel of same size, unconditionally */
+		void convert(const ci::Channel16u& iDepth, ci::Channel8u& oChannel) const
+		{
+			if( iDepth.getWidth() != oChannel.getWidth() || iDepth.getHeight() != oChannel.getHeight() ) {
+				throw std::runtime_error( "DepthConverter received output channel of unexpected size" );
+			}
+			convertRows( iDepth, oChannel, 0, iDepth.getHeight() );
+		}
+
+		/** @brief converts depth frame taken at iTimeStamp into ioChannel (allocated when NULL or of different size); returns false if conversion was skipped */
+		bool update(const ci::Channel16uRef& iDepth, long long iTimeStamp, ci::Channel8uRef& ioChannel)
+		{
+			if( ! iDepth ) {
+				throw std::runtime_error( "DepthConverter requires a depth frame" );
+			}
+			// Allocate channel:
+			if( ! ioChannel || ioChannel->getWidth() != iDepth->getWidth() || ioChannel->getHeight() != iDepth->getHeight() ) {
+				ioChannel = ci::Channel8u::create( iDepth->getWidth(), iDepth->getHeight() );
+			}
+			// Skip frame already in channel:
+			if( mHasConverted && iTimeStamp == mTimeStamp && ioChannel->getData() == mOutput ) {
+				return false;
+			}
+			convertRows( *iDepth, *ioChannel, 0, iDepth->getHeight() );
+			mHasConverted	= true;
+			mTimeStamp		= iTimeStamp;
+			mOutput			= ioChannel->getData();
+			return true;
+		}
+
+		/** @brief forces conversion on next update */
+		void invalidate()
+		{
+			mHasConverted = false;
+		}
+
+		/** @brief sets depth clamp range (in millimeters); near is raised to 1 and far kept above near */
+		void setRange(uint16_t iNear, uint16_t iFar)
+		{
+			mNear	= ( iNear > 0 ) ? ( iNear < 65535 ? iNear : uint16_t( 65534 ) ) : uint16_t( 1 );
+			mFar	= ( iFar > mNear ) ? iFar : uint16_t( mNear + 1 );
+			invalidate();
+		}
+
+		/** @brief sets depth mapping */
+		void setMapping(Mapping iMapping)
+		{
+			mMapping = iMapping;
+			invalidate();
+		}
+
+		/** @brief returns depth mapping */
+		Mapping getMapping() const
+		{
+			return mMapping;
+		}
+
+		/** @brief returns near clamp (in millimeters) */
+		uint16_t getNear() const
+		{
+			return mNear;
+		}
+
+		/** @brief returns far clamp (in millimeters) */
+		uint16_t getFar() const
+		{
+			return mFar;
+		}
+	};
+
+} // namespace itp
@@ -30,6 +30,7 @@ namespace itp {
 	STRINGIFY(
 			  // CONFIG:
 			  
+			  uniform bool		uGrayscale;
 			  uniform bool		uSilhouette;
 			  
 			  // USER TEXTURES:
@@ -58,6 +59,10 @@ namespace itp {
 					  vec2 tCoordAdj = texture( uTextureLookup, vTexCoord0 ).rg;
 					  // Set final color from  masked-user color pixel:
 					  fragColor = vec4(texture(uTextureColor, tCoordAdj).rgb, tBodyMask);
+					  // Set to grayscale, if desired:
+					  if( uGrayscale ) {
+						  fragColor.rgb = vec3( dot( fragColor.rgb, vec3( 0.299, 0.587, 0.114 ) ) );
+					  }
 				  }
 		
 				  // For debug only:
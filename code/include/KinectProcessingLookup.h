@@ -0,0 +1,430 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+#include "cinder/Timer.h"
+
+#include <ParallelFor.h>
+#include <Simd.h>
+
+namespace itp {
+
+#if ITP_SIMD_SSE2
+	/** @brief stores four RGB lookup pixels from ( r0 g0 r1 g1 ) and ( r2 g2 r3 g3 ), with zero blue channel */
+	static inline void store_lookup_pixels_x4(float* oDst, __m128 iA, __m128 iB)
+	{
+		// Interleave into ( r0 g0 0 r1 ) ( g1 0 r2 g2 ) ( 0 r3 g3 0 ):
+		const __m128 tZero	= _mm_setzero_ps();
+		__m128 tAHi			= _mm_shuffle_ps( tZero, iA, _MM_SHUFFLE( 3, 2, 0, 0 ) );
+		__m128 tBHi			= _mm_shuffle_ps( iB, tZero, _MM_SHUFFLE( 0, 0, 3, 2 ) );
+		_mm_storeu_ps( oDst,     _mm_shuffle_ps( iA, tAHi, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+		_mm_storeu_ps( oDst + 4, _mm_shuffle_ps( tAHi, iB, _MM_SHUFFLE( 1, 0, 0, 3 ) ) );
+		_mm_storeu_ps( oDst + 8, _mm_shuffle_ps( tBHi, tBHi, _MM_SHUFFLE( 2, 1, 0, 2 ) ) );
+	}
+#endif
+
+	/**
+	 * @brief converts rows [iRowBegin, iRowEnd) of depth-to-color mapping points to normalized lookup coordinates
+	 *
+	 * Each output pixel is ( x / colorWidth, 1 - y / colorHeight, 0 ), matching the lookup texture
+	 * sampled by kGlslKinectAlignSilhouetteFrag. Points are row-major, one per depth pixel.
+	 */
+	static inline void convert_depth_to_color_rows(const ci::ivec2* iPoints, const ci::vec2& iColorFrameDim, ci::Surface32f& oSurface, size_t iRowBegin, size_t iRowEnd)
+	{
+		const int32_t	tWidth		= oSurface.getWidth();
+		const int32_t	tPixelInc	= oSurface.getPixelInc();
+		const float		tScaleX		= 1.0f / iColorFrameDim.x;
+		const float		tScaleY		= 1.0f / iColorFrameDim.y;
+		for( size_t y = iRowBegin; y < iRowEnd; y++ ) {
+			const int32_t*	tSrc	= reinterpret_cast<const int32_t*>( iPoints + y * tWidth );
+			float*			tDst	= reinterpret_cast<float*>( reinterpret_cast<uint8_t*>( oSurface.getData() ) + y * oSurface.getRowBytes() );
+			int32_t			x		= 0;
+#if ITP_SIMD_SSE2
+			// Convert four RGB pixels per step:
+			if( tPixelInc == 3 ) {
+				const __m128 tScale	= _mm_setr_ps( tScaleX, -tScaleY, tScaleX, -tScaleY );
+				const __m128 tBias	= _mm_setr_ps( 0.0f, 1.0f, 0.0f, 1.0f );
+				for( ; x + 4 <= tWidth; x += 4, tSrc += 8, tDst += 12 ) {
+					// Normalize ( x0 y0 x1 y1 ) and ( x2 y2 x3 y3 ):
+					__m128 tA = _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( tSrc ) ) ), tScale ), tBias );
+					__m128 tB = _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( tSrc + 4 ) ) ), tScale ), tBias );
+					store_lookup_pixels_x4( tDst, tA, tB );
+				}
+			}
+#endif
+			// Convert remaining pixels:
+			for( ; x < tWidth; x++, tSrc += 2, tDst += tPixelInc ) {
+				tDst[ 0 ] = (float)tSrc[ 0 ] * tScaleX;
+				tDst[ 1 ] = 1.0f - (float)tSrc[ 1 ] * tScaleY;
+				tDst[ 2 ] = 0.0f;
+				if( tPixelInc == 4 ) tDst[ 3 ] = 1.0f;
+			}
+		}
+	}
+
+	/** @brief builds the depth-to-color lookup surface into a persistent buffer, split across worker threads */
+	class DepthToColorLookup {
+	public:
+
+		typedef std::shared_ptr<DepthToColorLookup> Ref;
+
+	private:
+
+		ParallelFor::Ref	mPool;		//!< worker pool
+		ci::Surface32fRef	mSurface;	//!< persistent lookup surface (RGB)
+
+		/** @brief default constructor (0 threads uses hardware concurrency) */
+		DepthToColorLookup(size_t iThreadCount = 0) :
+			mPool( ParallelFor::create( iThreadCount ) )
+		{ /* no-op */ }
+
+		/** @brief constructor sharing an existing worker pool */
+		DepthToColorLookup(const ParallelFor::Ref& iPool) :
+			mPool( iPool )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static DepthToColorLookup::Ref create(Args&& ... args)
+		{
+			return DepthToColorLookup::Ref( new DepthToColorLookup( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief rebuilds lookup surface from mapping points (one per depth pixel); surface is only reallocated when depth size changes */
+		const ci::Surface32fRef& update(const std::vector<ci::ivec2>& iPoints, const ci::ivec2& iDepthSize, const ci::vec2& iColorFrameDim)
+		{
+			if( iPoints.size() < size_t( iDepthSize.x ) * size_t( iDepthSize.y ) ) {
+				throw std::runtime_error( "DepthToColorLookup received too few mapping points" );
+			}
+			// Allocate surface:
+			if( ! mSurface || mSurface->getWidth() != iDepthSize.x || mSurface->getHeight() != iDepthSize.y ) {
+				mSurface = ci::Surface32f::create( iDepthSize.x, iDepthSize.y, false, ci::SurfaceChannelOrder::RGB );
+			}
+			// Convert rows in parallel:
+			const ci::ivec2*	tPoints		= iPoints.data();
+			ci::Surface32f&		tSurface	= *mSurface;
+			mPool->run( 0, iDepthSize.y, [&] (size_t iBegin, size_t iEnd) {
+				convert_depth_to_color_rows( tPoints, iColorFrameDim, tSurface, iBegin, iEnd );
+			} );
+			return mSurface;
+		}
+
+		/** @brief returns lookup surface (NULL before first update) */
+		const ci::Surface32fRef& getSurface() const
+		{
+			return mSurface;
+		}
+
+		/** @brief returns worker pool */
+		const ParallelFor::Ref& getPool() const
+		{
+			return mPool;
+		}
+	};
+
+	/**
+	 * @brief cached depth-to-color lookup for a fixed sensor, evaluated per pixel from the depth value alone
+	 *
+	 * For each depth pixel the color coordinate follows c(z) = a + b / z, where z is the depth in millimeters.
+	 * The coefficients a and b are fitted once from the mapping at two calibration depths, after which
+	 * update() only needs the depth channel: each pixel costs one lookup into a precomputed reciprocal
+	 * table (no division) and two multiply-adds. Pixels with zero (invalid) depth map to the far-plane
+	 * coordinate a. Callers should check getFitError() after calibrate() and fall back to the full
+	 * mapping (DepthToColorLookup) when it is too large for their use.
+	 *
+	 * With a change threshold set, only pixels whose depth moved by more than the threshold since they
+	 * were last evaluated are recomputed, and update() reports how many pixels changed.
+	 */
+	class DepthToColorTable {
+	public:
+
+		typedef std::shared_ptr<DepthToColorTable> Ref;
+
+		static const uint16_t kDefaultNearDepth	= 1000; //!< default near calibration depth (in millimeters)
+		static const uint16_t kDefaultFarDepth	= 4000; //!< default far calibration depth (in millimeters)
+
+	private:
+
+		ParallelFor::Ref		mPool;			//!< worker pool
+		ci::Surface32fRef		mSurface;		//!< persistent lookup surface (RGB)
+		ci::ivec2				mSize;			//!< depth frame size
+		std::vector<float>		mOffsetR;		//!< per-pixel red (normalized x) offset
+		std::vector<float>		mSlopeR;		//!< per-pixel red (normalized x) inverse-depth slope
+		std::vector<float>		mOffsetG;		//!< per-pixel green (flipped normalized y) offset
+		std::vector<float>		mSlopeG;		//!< per-pixel green (flipped normalized y) inverse-depth slope
+		std::vector<float>		mInvDepth;		//!< inverse depth for every 16-bit depth value (0 for invalid)
+		std::vector<uint16_t>	mDepth;			//!< depth each pixel was last evaluated at
+		uint16_t				mThreshold;		//!< per-pixel depth change threshold (0 evaluates every pixel)
+		bool					mEvaluated;		//!< true once surface holds a full evaluation
+		float					mFitError;		//!< largest fit error at mid calibration depth (in color pixels)
+
+		/** @brief default constructor (0 threads uses hardware concurrency) */
+		DepthToColorTable(size_t iThreadCount = 0) :
+			mPool( ParallelFor::create( iThreadCount ) ),
+			mThreshold( 0 ),
+			mEvaluated( false ),
+			mFitError( 0.0f )
+		{ /* no-op */ }
+
+		/** @brief constructor sharing an existing worker pool */
+		DepthToColorTable(const ParallelFor::Ref& iPool) :
+			mPool( iPool ),
+			mThreshold( 0 ),
+			mEvaluated( false ),
+			mFitError( 0.0f )
+		{ /* no-op */ }
+
+		/** @brief evaluates every pixel in rows [iRowBegin, iRowEnd) */
+		void evaluateRows(const uint16_t* iDepth, size_t iRowBegin, size_t iRowEnd)
+		{
+			const int32_t tWidth = mSize.x;
+			for( size_t y = iRowBegin; y < iRowEnd; y++ ) {
+				const size_t	tIndex	= y * tWidth;
+				const uint16_t*	tSrc	= iDepth + tIndex;
+				float*			tDst	= reinterpret_cast<float*>( reinterpret_cast<uint8_t*>( mSurface->getData() ) + y * mSurface->getRowBytes() );
+				int32_t			x		= 0;
+#if ITP_SIMD_SSE2
+				// Evaluate four pixels per step (inverse depths come from the table, as in the scalar loop):
+				const float* tInvDepth = mInvDepth.data();
+				for( ; x + 4 <= tWidth; x += 4, tDst += 12 ) {
+					__m128 tInv	= _mm_setr_ps( tInvDepth[ tSrc[ x ] ], tInvDepth[ tSrc[ x + 1 ] ], tInvDepth[ tSrc[ x + 2 ] ], tInvDepth[ tSrc[ x + 3 ] ] );
+					__m128 tR	= _mm_add_ps( _mm_loadu_ps( &mOffsetR[ tIndex + x ] ), _mm_mul_ps( _mm_loadu_ps( &mSlopeR[ tIndex + x ] ), tInv ) );
+					__m128 tG	= _mm_add_ps( _mm_loadu_ps( &mOffsetG[ tIndex + x ] ), _mm_mul_ps( _mm_loadu_ps( &mSlopeG[ tIndex + x ] ), tInv ) );
+					store_lookup_pixels_x4( tDst, _mm_unpacklo_ps( tR, tG ), _mm_unpackhi_ps( tR, tG ) );
+				}
+#endif
+				// Evaluate remaining pixels:
+				for( ; x < tWidth; x++, tDst += 3 ) {
+					float tInv = mInvDepth[ tSrc[ x ] ];
+					tDst[ 0 ] = mOffsetR[ tIndex + x ] + mSlopeR[ tIndex + x ] * tInv;
+					tDst[ 1 ] = mOffsetG[ tIndex + x ] + mSlopeG[ tIndex + x ] * tInv;
+					tDst[ 2 ] = 0.0f;
+				}
+				// Record evaluated depth:
+				std::copy( tSrc, tSrc + tWidth, mDepth.begin() + tIndex );
+			}
+		}
+
+		/** @brief evaluates pixels in rows [iRowBegin, iRowEnd) whose depth moved beyond threshold; returns changed pixel count */
+		size_t evaluateChangedRows(const uint16_t* iDepth, size_t iRowBegin, size_t iRowEnd)
+		{
+			const int32_t	tWidth		= mSize.x;
+			size_t			tChanged	= 0;
+			for( size_t y = iRowBegin; y < iRowEnd; y++ ) {
+				const size_t	tIndex	= y * tWidth;
+				float*			tDst	= reinterpret_cast<float*>( reinterpret_cast<uint8_t*>( mSurface->getData() ) + y * mSurface->getRowBytes() );
+				for( int32_t x = 0; x < tWidth; x++, tDst += 3 ) {
+					uint16_t tZ		= iDepth[ tIndex + x ];
+					uint16_t tPrev	= mDepth[ tIndex + x ];
+					if( ( tZ > tPrev ? tZ - tPrev : tPrev - tZ ) <= mThreshold ) continue;
+					float tInv = mInvDepth[ tZ ];
+					tDst[ 0 ] = mOffsetR[ tIndex + x ] + mSlopeR[ tIndex + x ] * tInv;
+					tDst[ 1 ] = mOffsetG[ tIndex + x ] + mSlopeG[ tIndex + x ] * tInv;
+					mDepth[ tIndex + x ] = tZ;
+					tChanged++;
+				}
+			}
+			return tChanged;
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static DepthToColorTable::Ref create(Args&& ... args)
+		{
+			return DepthToColorTable::Ref( new DepthToColorTable( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief fits per-pixel coefficients from mapping points (one per depth pixel) taken at two constant depths */
+		void fit(const std::vector<ci::ivec2>& iPointsNear, uint16_t iDepthNear, const std::vector<ci::ivec2>& iPointsFar, uint16_t iDepthFar, const ci::ivec2& iDepthSize, const ci::vec2& iColorFrameDim)
+		{
+			const size_t tCount = size_t( iDepthSize.x ) * size_t( iDepthSize.y );
+			if( iPointsNear.size() < tCount || iPointsFar.size() < tCount ) {
+				throw std::runtime_error( "DepthToColorTable received too few mapping points" );
+			}
+			if( iDepthNear == 0 || iDepthFar == 0 || iDepthNear == iDepthFar ) {
+				throw std::runtime_error( "DepthToColorTable requires two distinct non-zero calibration depths" );
+			}
+			// Allocate tables:
+			mSize = iDepthSize;
+			mOffsetR.resize( tCount );
+			mSlopeR.resize( tCount );
+			mOffsetG.resize( tCount );
+			mSlopeG.resize( tCount );
+			mDepth.assign( tCount, 0 );
+			mSurface	= ci::Surface32f::create( iDepthSize.x, iDepthSize.y, false, ci::SurfaceChannelOrder::RGB );
+			mEvaluated	= false;
+			mFitError	= 0.0f;
+			// Build inverse-depth table:
+			if( mInvDepth.empty() ) {
+				mInvDepth.resize( 65536 );
+				mInvDepth[ 0 ] = 0.0f;
+				for( size_t z = 1; z < mInvDepth.size(); z++ ) {
+					mInvDepth[ z ] = 1.0f / (float)z;
+				}
+			}
+			// Solve c = a + b / z from both depths, in normalized lookup space:
+			const double tInvNear	= 1.0 / (double)iDepthNear;
+			const double tInvFar	= 1.0 / (double)iDepthFar;
+			const double tInvSpan	= 1.0 / ( tInvNear - tInvFar );
+			for( size_t i = 0; i < tCount; i++ ) {
+				double tSlopeX	= ( (double)iPointsNear[ i ].x - (double)iPointsFar[ i ].x ) * tInvSpan;
+				double tSlopeY	= ( (double)iPointsNear[ i ].y - (double)iPointsFar[ i ].y ) * tInvSpan;
+				double tOffsetX	= (double)iPointsFar[ i ].x - tSlopeX * tInvFar;
+				double tOffsetY	= (double)iPointsFar[ i ].y - tSlopeY * tInvFar;
+				mOffsetR[ i ]	= (float)( tOffsetX / iColorFrameDim.x );
+				mSlopeR[ i ]	= (float)( tSlopeX / iColorFrameDim.x );
+				mOffsetG[ i ]	= (float)( 1.0 - tOffsetY / iColorFrameDim.y );
+				mSlopeG[ i ]	= (float)( -tSlopeY / iColorFrameDim.y );
+			}
+		}
+
+		/** @brief fits coefficients by mapping constant-depth frames through a device exposing mapDepthToColor(Channel16uRef) */
+		template <typename DeviceRefT> void calibrate(const DeviceRefT& iDevice, const ci::ivec2& iDepthSize, const ci::vec2& iColorFrameDim, uint16_t iDepthNear = kDefaultNearDepth, uint16_t iDepthFar = kDefaultFarDepth)
+		{
+			// Map constant-depth frames:
+			ci::Channel16uRef tChannel = ci::Channel16u::create( iDepthSize.x, iDepthSize.y );
+			std::fill( tChannel->getData(), tChannel->getData() + size_t( iDepthSize.x ) * size_t( iDepthSize.y ), iDepthNear );
+			std::vector<ci::ivec2> tPointsNear = iDevice->mapDepthToColor( tChannel );
+			std::fill( tChannel->getData(), tChannel->getData() + size_t( iDepthSize.x ) * size_t( iDepthSize.y ), iDepthFar );
+			std::vector<ci::ivec2> tPointsFar = iDevice->mapDepthToColor( tChannel );
+			fit( tPointsNear, iDepthNear, tPointsFar, iDepthFar, iDepthSize, iColorFrameDim );
+			// Measure fit error at a depth between both calibration depths:
+			uint16_t tDepthMid = (uint16_t)( ( (uint32_t)iDepthNear + (uint32_t)iDepthFar ) / 2 );
+			std::fill( tChannel->getData(), tChannel->getData() + size_t( iDepthSize.x ) * size_t( iDepthSize.y ), tDepthMid );
+			std::vector<ci::ivec2> tPointsMid = iDevice->mapDepthToColor( tChannel );
+			float tInv = mInvDepth[ tDepthMid ];
+			for( size_t i = 0; i < tPointsMid.size() && i < mOffsetR.size(); i++ ) {
+				float tErrX = std::fabs( ( mOffsetR[ i ] + mSlopeR[ i ] * tInv ) * iColorFrameDim.x - (float)tPointsMid[ i ].x );
+				float tErrY = std::fabs( ( 1.0f - ( mOffsetG[ i ] + mSlopeG[ i ] * tInv ) ) * iColorFrameDim.y - (float)tPointsMid[ i ].y );
+				mFitError = std::max( mFitError, std::max( tErrX, tErrY ) );
+			}
+		}
+
+		/** @brief evaluates lookup surface from a depth frame; returns number of pixels that changed (all pixels when no threshold is set) */
+		size_t update(const ci::Channel16uRef& iDepth)
+		{
+			if( ! isCalibrated() ) {
+				throw std::runtime_error( "DepthToColorTable used before calibration" );
+			}
+			if( ! iDepth || iDepth->getWidth() != mSize.x || iDepth->getHeight() != mSize.y ) {
+				throw std::runtime_error( "DepthToColorTable received depth frame of unexpected size" );
+			}
+			if( iDepth->getIncrement() != 1 || iDepth->getRowBytes() != mSize.x * (int32_t)sizeof( uint16_t ) ) {
+				throw std::runtime_error( "DepthToColorTable requires a tightly packed depth frame" );
+			}
+			const uint16_t* tDepth = iDepth->getData();
+			// Evaluate every pixel:
+			if( mThreshold == 0 || ! mEvaluated ) {
+				mPool->run( 0, mSize.y, [&] (size_t iBegin, size_t iEnd) {
+					evaluateRows( tDepth, iBegin, iEnd );
+				} );
+				mEvaluated = true;
+				return size_t( mSize.x ) * size_t( mSize.y );
+			}
+			// Evaluate pixels whose depth moved beyond threshold:
+			std::mutex tMutex;
+			size_t tTotal = 0;
+			mPool->run( 0, mSize.y, [&] (size_t iBegin, size_t iEnd) {
+				size_t tCount = evaluateChangedRows( tDepth, iBegin, iEnd );
+				std::lock_guard<std::mutex> tLock( tMutex );
+				tTotal += tCount;
+			} );
+			return tTotal;
+		}
+
+		/** @brief sets per-pixel depth change threshold (in millimeters); 0 evaluates every pixel on every update */
+		void setChangeThreshold(uint16_t iThreshold)
+		{
+			mThreshold = iThreshold;
+		}
+
+		/** @brief returns per-pixel depth change threshold (in millimeters) */
+		uint16_t getChangeThreshold() const
+		{
+			return mThreshold;
+		}
+
+		/** @brief returns true once coefficients have been fitted */
+		bool isCalibrated() const
+		{
+			return ( mSurface != NULL );
+		}
+
+		/** @brief returns largest fit error measured by calibrate() (in color pixels) */
+		float getFitError() const
+		{
+			return mFitError;
+		}
+
+		/** @brief returns lookup surface (NULL before calibration) */
+		const ci::Surface32fRef& getSurface() const
+		{
+			return mSurface;
+		}
+	};
+
+	/** @brief lookup builder timings (in milliseconds per frame) */
+	struct DepthToColorLookupBenchmark
+	{
+		double	mReferenceMs;	//!< per-frame allocation and Surface32f::Iter loop (as in the samples)
+		double	mSingleMs;		//!< persistent buffer, single thread
+		double	mParallelMs;	//!< persistent buffer, all threads
+	};
+
+	/** @brief times the reference lookup loop against the persistent single-threaded and parallel builders */
+	static inline DepthToColorLookupBenchmark benchmark_depth_to_color_lookup(const std::vector<ci::ivec2>& iPoints, const ci::ivec2& iDepthSize, const ci::vec2& iColorFrameDim, size_t iIterations = 100)
+	{
+		DepthToColorLookupBenchmark tResult;
+		ci::Timer tTimer;
+		iIterations = std::max<size_t>( iIterations, 1 );
+		// Time reference loop:
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			ci::Surface32fRef tSurface = ci::Surface32f::create( iDepthSize.x, iDepthSize.y, false, ci::SurfaceChannelOrder::RGB );
+			ci::Surface32f::Iter iter = tSurface->getIter();
+			std::vector<ci::ivec2>::const_iterator v = iPoints.begin();
+			while( iter.line() ) {
+				while( iter.pixel() ) {
+					iter.r() = (float)v->x / iColorFrameDim.x;
+					iter.g() = 1.0f - (float)v->y / iColorFrameDim.y;
+					iter.b() = 0.0f;
+					++v;
+				}
+			}
+		}
+		tTimer.stop();
+		tResult.mReferenceMs = tTimer.getSeconds() * 1000.0 / (double)iIterations;
+		// Time single-threaded builder:
+		DepthToColorLookup::Ref tSingle = DepthToColorLookup::create( size_t( 1 ) );
+		tSingle->update( iPoints, iDepthSize, iColorFrameDim );
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			tSingle->update( iPoints, iDepthSize, iColorFrameDim );
+		}
+		tTimer.stop();
+		tResult.mSingleMs = tTimer.getSeconds() * 1000.0 / (double)iIterations;
+		// Time parallel builder:
+		DepthToColorLookup::Ref tParallel = DepthToColorLookup::create();
+		tParallel->update( iPoints, iDepthSize, iColorFrameDim );
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			tParallel->update( iPoints, iDepthSize, iColorFrameDim );
+		}
+		tTimer.stop();
+		tResult.mParallelMs = tTimer.getSeconds() * 1000.0 / (double)iIterations;
+		return tResult;
+	}
+
+} // namespace itp
@@ -0,0 +1,161 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+
+namespace itp {
+
+	/** @brief persistent worker pool that splits an index range into contiguous chunks, one per thread */
+	class ParallelFor {
+	public:
+
+		typedef std::shared_ptr<ParallelFor>				Ref;
+
+		typedef std::function<void(size_t, size_t)>		RangeFn; //!< processes indices in [begin, end)
+
+	private:
+
+		std::vector<std::thread>	mThreads;		//!< worker threads (caller thread runs the first chunk)
+		std::mutex					mRunMutex;		//!< serializes callers of run()
+		std::mutex					mMutex;			//!< guards all members below
+		std::condition_variable		mStartCond;		//!< signalled when a job is posted or on stop
+		std::condition_variable		mDoneCond;		//!< signalled when a worker finishes its chunk
+		bool						mRunning;		//!< activity flag
+		uint64_t					mGeneration;	//!< incremented on every posted job
+		const RangeFn*				mFn;			//!< current job
+		size_t						mBegin;			//!< current job range start
+		size_t						mEnd;			//!< current job range end
+		size_t						mChunk;			//!< current job chunk size
+		size_t						mPending;		//!< workers still running current job
+		std::exception_ptr			mError;			//!< first error thrown by a worker
+
+		/** @brief default constructor (0 threads uses hardware concurrency) */
+		ParallelFor(size_t iThreadCount = 0) :
+			mRunning( true ),
+			mGeneration( 0 ),
+			mFn( NULL ),
+			mBegin( 0 ),
+			mEnd( 0 ),
+			mChunk( 0 ),
+			mPending( 0 )
+		{
+			if( iThreadCount == 0 ) {
+				iThreadCount = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+			}
+			for( size_t i = 1; i < iThreadCount; i++ ) {
+				mThreads.push_back( std::thread( &ParallelFor::work, this, i ) );
+			}
+		}
+
+		/** @brief worker thread loop */
+		void work(size_t iSlot)
+		{
+			// Start from generation at construction, so a job posted before this thread runs is not missed:
+			uint64_t tGeneration = 0;
+			std::unique_lock<std::mutex> tLock( mMutex );
+			while( true ) {
+				mStartCond.wait( tLock, [&] { return ! mRunning || mGeneration != tGeneration; } );
+				if( ! mRunning ) return;
+				tGeneration = mGeneration;
+				// Run chunk outside of lock:
+				const RangeFn*	tFn		= mFn;
+				size_t			tBegin	= std::min( mBegin + iSlot * mChunk, mEnd );
+				size_t			tEnd	= std::min( tBegin + mChunk, mEnd );
+				tLock.unlock();
+				std::exception_ptr tError;
+				if( tBegin < tEnd ) {
+					try {
+						( *tFn )( tBegin, tEnd );
+					}
+					catch( ... ) {
+						tError = std::current_exception();
+					}
+				}
+				tLock.lock();
+				if( tError && ! mError ) mError = tError;
+				if( --mPending == 0 ) mDoneCond.notify_one();
+			}
+		}
+
+		ParallelFor(const ParallelFor&);
+		ParallelFor& operator=(const ParallelFor&);
+
+	public:
+
+		/** @brief destructor */
+		~ParallelFor()
+		{
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				mRunning = false;
+				mStartCond.notify_all();
+			}
+			for( auto& tThread : mThreads ) {
+				tThread.join();
+			}
+		}
+
+		/** @brief static creational method */
+		template <typename ... Args> static ParallelFor::Ref create(Args&& ... args)
+		{
+			return ParallelFor::Ref( new ParallelFor( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief runs iFn over [iBegin, iEnd) split across all threads, blocking until done; rethrows the first error */
+		void run(size_t iBegin, size_t iEnd, const RangeFn& iFn)
+		{
+			if( iBegin >= iEnd ) return;
+			size_t tCount = iEnd - iBegin;
+			size_t tChunk = ( tCount + mThreads.size() ) / ( mThreads.size() + 1 );
+			// Run inline when there is nothing to split:
+			if( mThreads.empty() || tChunk >= tCount ) {
+				iFn( iBegin, iEnd );
+				return;
+			}
+			std::lock_guard<std::mutex> tRunLock( mRunMutex );
+			// Post job:
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				mFn			= &iFn;
+				mBegin		= iBegin;
+				mEnd		= iEnd;
+				mChunk		= tChunk;
+				mPending	= mThreads.size();
+				mGeneration++;
+				mStartCond.notify_all();
+			}
+			// Run first chunk on caller thread:
+			std::exception_ptr tError;
+			try {
+				iFn( iBegin, iBegin + tChunk );
+			}
+			catch( ... ) {
+				tError = std::current_exception();
+			}
+			// Wait for workers:
+			std::unique_lock<std::mutex> tLock( mMutex );
+			mDoneCond.wait( tLock, [&] { return mPending == 0; } );
+			mFn = NULL;
+			if( ! tError && mError ) tError = mError;
+			mError = std::exception_ptr();
+			tLock.unlock();
+			if( tError ) std::rethrow_exception( tError );
+		}
+
+		/** @brief returns number of threads used per job (including caller thread) */
+		size_t getThreadCount() const
+		{
+			return mThreads.size() + 1;
+		}
+	};
+
+} // namespace itp
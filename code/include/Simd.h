@@ -0,0 +1,12 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+// SSE2 is available on all x64 targets, and on x86 when enabled by the compiler.
+// Define ITP_DISABLE_SIMD to force the scalar code paths:
+#if !defined( ITP_DISABLE_SIMD ) && ( defined( _M_X64 ) || defined( _M_AMD64 ) || defined( __SSE2__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+	#define ITP_SIMD_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define ITP_SIMD_SSE2 0
+#endif
@@ -0,0 +1,307 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include <SyntheticKinect.h>
+#include <multitrack/Controller.h>
+
+namespace itp { namespace synthetic {
+
+	static const uint64_t kHashSeed = 14695981039346656037ULL; //!< FNV-1a offset basis
+
+	/** @brief continues FNV-1a hash over a byte range */
+	static inline uint64_t hash_bytes(const void* iData, size_t iSize, uint64_t iHash = kHashSeed)
+	{
+		const uint8_t* tData = static_cast<const uint8_t*>( iData );
+		for( size_t i = 0; i < iSize; i++ ) {
+			iHash = ( iHash ^ tData[ i ] ) * 1099511628211ULL;
+		}
+		return iHash;
+	}
+
+	/** @brief hashes channel values row by row (independent of row padding) */
+	template <typename V> static inline uint64_t hash_frame(const std::shared_ptr<ci::ChannelT<V>>& iChannel)
+	{
+		uint64_t tHash = kHashSeed;
+		for( int32_t y = 0; y < iChannel->getHeight(); y++ ) {
+			const V* tSrc = iChannel->getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < iChannel->getWidth(); x++ ) {
+				tHash = hash_bytes( &tSrc[ x * iChannel->getIncrement() ], sizeof( V ), tHash );
+			}
+		}
+		return tHash;
+	}
+
+	/** @brief hashes surface pixels as RGBA (independent of row padding and channel order) */
+	static inline uint64_t hash_frame(const ci::SurfaceRef& iSurface)
+	{
+		const ci::SurfaceChannelOrder&	tOrder	= iSurface->getChannelOrder();
+		const uint8_t					tInc	= iSurface->getPixelInc();
+		uint64_t tHash = kHashSeed;
+		for( int32_t y = 0; y < iSurface->getHeight(); y++ ) {
+			const uint8_t* tSrc = iSurface->getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < iSurface->getWidth(); x++, tSrc += tInc ) {
+				uint8_t tPixel[ 4 ] = { tSrc[ tOrder.getRedOffset() ], tSrc[ tOrder.getGreenOffset() ], tSrc[ tOrder.getBlueOffset() ], iSurface->hasAlpha() ? tSrc[ tOrder.getAlphaOffset() ] : (uint8_t)255 };
+				tHash = hash_bytes( tPixel, 4, tHash );
+			}
+		}
+		return tHash;
+	}
+
+	/** @brief hashes point cloud through its serialized form */
+	static inline uint64_t hash_frame(const multitrack::PointCloudRef& iCloud)
+	{
+		std::vector<uint8_t> tData;
+		multitrack::write_to_buffer<multitrack::PointCloudRef>( tData, iCloud );
+		return hash_bytes( tData.data(), tData.size() );
+	}
+
+	/** @brief checks frames shown during playback against the frames recorded on one stream */
+	class FrameSequenceCheck {
+	private:
+
+		std::vector<uint64_t>	mRecorded;		//!< hashes of recorded frames, in recording order
+		std::vector<double>		mTimes;			//!< sensor times of recorded frames (in seconds)
+		std::vector<bool>		mExpected;		//!< true for recorded frames playback is expected to show
+		std::vector<bool>		mSeen;			//!< true for recorded frames shown
+		size_t					mCursor;		//!< index of last matched frame
+		bool					mStarted;		//!< true once a frame was matched
+		uint64_t				mShown;			//!< distinct recorded frames shown
+		uint64_t				mMismatches;	//!< shown frames matching no later recorded frame
+
+	public:
+
+		FrameSequenceCheck() :
+			mCursor( 0 ),
+			mStarted( false ),
+			mShown( 0 ),
+			mMismatches( 0 )
+		{ /* no-op */ }
+
+		/** @brief adds recorded frame with its sensor time (in seconds) */
+		void record(uint64_t iHash, double iTime)
+		{
+			mRecorded.push_back( iHash );
+			mTimes.push_back( iTime );
+			mExpected.push_back( true );
+			mSeen.push_back( false );
+		}
+
+		/**
+		 * @brief expects only recorded frames whose display interval holds a playback step (at k / iStepRate, for k below iStepCount)
+		 *
+		 * A frame is shown from its own time up to, but excluding, the next frame's time. Sensor timestamps are
+		 * rounded to ticks, so a frame's time may fall just after the step that nominally shows it, and a frame
+		 * whose interval then holds no step is skipped by playback as well.
+		 */
+		void expect(double iStepRate, size_t iStepCount)
+		{
+			mExpected.assign( mTimes.size(), false );
+			size_t tFrame = 0;
+			for( size_t k = 0; k < iStepCount && ! mTimes.empty(); k++ ) {
+				double tTime = (double)k / iStepRate;
+				while( tFrame + 1 < mTimes.size() && mTimes[ tFrame + 1 ] <= tTime ) tFrame++;
+				if( mTimes[ tFrame ] <= tTime ) mExpected[ tFrame ] = true;
+			}
+		}
+
+		/** @brief matches shown frame against current or a later recorded frame */
+		void show(uint64_t iHash)
+		{
+			if( mStarted && mRecorded[ mCursor ] == iHash ) return;
+			size_t tFind = mStarted ? mCursor + 1 : 0;
+			while( tFind < mRecorded.size() && mRecorded[ tFind ] != iHash ) tFind++;
+			if( tFind == mRecorded.size() ) {
+				mMismatches++;
+				return;
+			}
+			mCursor			= tFind;
+			mStarted		= true;
+			mSeen[ tFind ]	= true;
+			mShown++;
+		}
+
+		uint64_t getRecordedCount() const	{ return mRecorded.size(); }
+		uint64_t getShownCount() const		{ return mShown; }
+		uint64_t getMismatchCount() const	{ return mMismatches; }
+
+		/** @brief returns number of expected frames never shown */
+		uint64_t getMissingCount() const
+		{
+			uint64_t tCount = 0;
+			for( size_t i = 0; i < mExpected.size(); i++ ) {
+				if( mExpected[ i ] && ! mSeen[ i ] ) tCount++;
+			}
+			return tCount;
+		}
+	};
+
+	/** @brief record and playback timings of the synthetic pipeline, with regression counts */
+	struct PipelineBenchmark
+	{
+		uint64_t	mRecordedCount;	//!< frames pushed to recorders (all streams)
+		double		mRecordFps;		//!< frames recorded per second of wall time (pushing and draining writers)
+		double		mPushMeanMs;	//!< mean push latency (recording cost inside a device event handler)
+		double		mPushMaxMs;		//!< worst push latency
+		double		mCompleteMs;	//!< time to drain writers and switch tracks to playback
+		uint64_t	mShownCount;	//!< distinct recorded frames shown during playback (all streams)
+		double		mPlaybackFps;	//!< playback steps per second of wall time (offline render)
+		double		mStepMeanMs;	//!< mean playback step latency (decode, update and draw)
+		double		mStepMaxMs;		//!< worst playback step latency
+		uint64_t	mMissingCount;	//!< recorded frames never shown during playback, although a step fell within their display interval
+		uint64_t	mMismatchCount;	//!< shown frames that differ from the recorded ones, or are out of order
+		uint64_t	mUnderrunCount;	//!< draws that held the previous frame during real-time playback, as read-ahead fell behind (all streams)
+
+		/** @brief returns true if playback showed every recorded frame unchanged and in order */
+		bool passed() const { return ( mMissingCount == 0 && mMismatchCount == 0 ); }
+	};
+
+	/**
+	 * @brief records synthetic color, depth, body-index and body streams for a duration, then plays them back
+	 *
+	 * Frames are pushed from the device event handlers with their sensor timestamps, on a virtual clock
+	 * (as fast as they can be recorded). Playback renders offline at twice the fastest stream rate and compares every
+	 * frame handed to the player callbacks against the recorded frames, so the result doubles as a regression
+	 * test of the whole pipeline. The recording is then played once more in real time with read-ahead, counting
+	 * the draws that had to hold a frame. Streams with zero rate are skipped. Runs without a sensor or GL context.
+	 */
+	static inline PipelineBenchmark benchmark_synthetic_pipeline(const ci::fs::path& iDirectory, const Device::Format& iFormat = Device::Format(), double iDuration = 5.0, multitrack::TrackFormat iTrackFormat = multitrack::TrackFormat::CONTAINER)
+	{
+		typedef std::chrono::steady_clock Clock;
+		PipelineBenchmark tResult = PipelineBenchmark();
+		FrameSequenceCheck tColorCheck, tDepthCheck, tBodyIndexCheck, tBodyCheck;
+		double tPushTotalMs = 0.0;
+		// Setup device and controller:
+		DeviceRef tDevice = Device::create( iFormat );
+		multitrack::ManualClock::Ref tClock = multitrack::ManualClock::create();
+		multitrack::Controller::Ref tController = multitrack::Controller::create( iDirectory, tClock );
+		tController->start();
+		std::vector<multitrack::Track::Ref> tTracks;
+		std::vector<std::function<uint64_t(void)>> tUnderrunFns;
+		bool tChecking = true; // hash shown frames (off during real-time pass, so hashing does not starve the players)
+		// Times push and records hash of accepted frame:
+		auto tPush = [&] ( FrameSequenceCheck& ioCheck, uint64_t iHash, long long iTimeStamp, std::function<bool(void)> iPushFn ) {
+			Clock::time_point tBegin = Clock::now();
+			bool tAccepted = iPushFn();
+			double tMs = std::chrono::duration<double, std::milli>( Clock::now() - tBegin ).count();
+			tPushTotalMs		+= tMs;
+			tResult.mPushMaxMs	= std::max( tResult.mPushMaxMs, tMs );
+			if( ! tAccepted ) return;
+			ioCheck.record( iHash, (double)iTimeStamp / kTicksPerSecond );
+			tResult.mRecordedCount++;
+		};
+		// Add recorder per enabled stream:
+		if( iFormat.mColorFps > 0.0 ) {
+			multitrack::TrackT<ci::SurfaceRef>::Ref tTrack = tController->addPushRecorder<ci::SurfaceRef>( [&] ( const ci::SurfaceRef& iFrame ) { if( iFrame && tChecking ) tColorCheck.show( hash_frame( iFrame ) ); }, iTrackFormat );
+			tDevice->connectColorEventHandler( [&, tTrack] ( const ColorFrame& iFrame ) {
+				tPush( tColorCheck, hash_frame( iFrame.getSurface() ), iFrame.getTimeStamp(), [&] () { return tTrack->push( iFrame.getSurface(), iFrame.getTimeStamp() ); } );
+			} );
+			tTracks.push_back( tTrack );
+			tUnderrunFns.push_back( [tTrack] () { return tTrack->getUnderrunCount(); } );
+		}
+		if( iFormat.mDepthFps > 0.0 ) {
+			multitrack::TrackT<ci::Channel16uRef>::Ref tTrack = tController->addPushRecorder<ci::Channel16uRef>( [&] ( const ci::Channel16uRef& iFrame ) { if( iFrame && tChecking ) tDepthCheck.show( hash_frame( iFrame ) ); }, iTrackFormat );
+			tDevice->connectDepthEventHandler( [&, tTrack] ( const DepthFrame& iFrame ) {
+				tPush( tDepthCheck, hash_frame( iFrame.getChannel() ), iFrame.getTimeStamp(), [&] () { return tTrack->push( iFrame.getChannel(), iFrame.getTimeStamp() ); } );
+			} );
+			tTracks.push_back( tTrack );
+			tUnderrunFns.push_back( [tTrack] () { return tTrack->getUnderrunCount(); } );
+		}
+		if( iFormat.mBodyIndexFps > 0.0 ) {
+			multitrack::TrackT<ci::Channel8uRef>::Ref tTrack = tController->addPushRecorder<ci::Channel8uRef>( [&] ( const ci::Channel8uRef& iFrame ) { if( iFrame && tChecking ) tBodyIndexCheck.show( hash_frame( iFrame ) ); }, iTrackFormat );
+			tDevice->connectBodyIndexEventHandler( [&, tTrack] ( const BodyIndexFrame& iFrame ) {
+				tPush( tBodyIndexCheck, hash_frame( iFrame.getChannel() ), iFrame.getTimeStamp(), [&] () { return tTrack->push( iFrame.getChannel(), iFrame.getTimeStamp() ); } );
+			} );
+			tTracks.push_back( tTrack );
+			tUnderrunFns.push_back( [tTrack] () { return tTrack->getUnderrunCount(); } );
+		}
+		if( iFormat.mBodyFps > 0.0 ) {
+			multitrack::TrackT<multitrack::PointCloudRef>::Ref tTrack = tController->addPushRecorder<multitrack::PointCloudRef>( [&] ( const multitrack::PointCloudRef& iFrame ) { if( iFrame && tChecking ) tBodyCheck.show( hash_frame( iFrame ) ); }, iTrackFormat );
+			const Device* tDeviceRaw = tDevice.get(); // device owns handler, so it is not captured by reference count
+			tDevice->connectBodyEventHandler( [&, tTrack, tDeviceRaw] ( const BodyFrame& iFrame ) {
+				multitrack::PointCloudRef tCloud = std::make_shared<multitrack::PointCloud>( iFrame, tDeviceRaw );
+				tPush( tBodyCheck, hash_frame( tCloud ), iFrame.getTimeStamp(), [&] () { return tTrack->push( tCloud, iFrame.getTimeStamp() ); } );
+			} );
+			tTracks.push_back( tTrack );
+			tUnderrunFns.push_back( [tTrack] () { return tTrack->getUnderrunCount(); } );
+		}
+		if( tTracks.empty() ) return tResult;
+		// Record on virtual clock, stepping at fastest stream rate (one frame of slowest stream past duration, as the final frame of a track is only shown at its own time):
+		const double tRates[] = { iFormat.mColorFps, iFormat.mDepthFps, iFormat.mBodyIndexFps, iFormat.mBodyFps };
+		double tFrameRate = 0.0, tMinRate = 0.0;
+		for( double tRate : tRates ) {
+			if( tRate <= 0.0 ) continue;
+			tFrameRate	= std::max( tFrameRate, tRate );
+			tMinRate	= ( tMinRate > 0.0 ) ? std::min( tMinRate, tRate ) : tRate;
+		}
+		const size_t tStepCount		= static_cast<size_t>( std::floor( iDuration * tFrameRate + 1e-6 ) ) + 1;
+		const size_t tRecordCount	= tStepCount + static_cast<size_t>( std::ceil( tFrameRate / tMinRate - 1e-6 ) );
+		Clock::time_point tRecordBegin = Clock::now();
+		tDevice->start();
+		for( size_t i = 0; i < tRecordCount; i++ ) {
+			tDevice->advance( ( i == 0 ) ? 0.0 : 1.0 / tFrameRate );
+			tClock->advance( 1.0 / tFrameRate );
+			tController->update();
+		}
+		tDevice->stop();
+		Clock::time_point tCompleteBegin = Clock::now();
+		tController->completeRecorder();
+		Clock::time_point tRecordEnd = Clock::now();
+		tResult.mCompleteMs	= std::chrono::duration<double, std::milli>( tRecordEnd - tCompleteBegin ).count();
+		tResult.mRecordFps	= (double)tResult.mRecordedCount / std::max( std::chrono::duration<double>( tRecordEnd - tRecordBegin ).count(), 1e-9 );
+		tResult.mPushMeanMs	= tPushTotalMs / (double)std::max<uint64_t>( tResult.mRecordedCount, 1 );
+		// Render at twice the fastest rate, so every frame's display interval holds a step, and expect those frames:
+		const double tRenderEnd			= (double)( tStepCount - 1 ) / tFrameRate;
+		const double tRenderRate		= 2.0 * tFrameRate;
+		const size_t tRenderStepCount	= 2 * tStepCount - 1;
+		FrameSequenceCheck* tChecks[] = { &tColorCheck, &tDepthCheck, &tBodyIndexCheck, &tBodyCheck };
+		for( FrameSequenceCheck* tCheck : tChecks ) {
+			tCheck->expect( tRenderRate, tRenderStepCount );
+		}
+		// Play back offline, timing each step:
+		double tStepTotalMs = 0.0;
+		Clock::time_point tPlayBegin = Clock::now();
+		Clock::time_point tStepBegin = tPlayBegin;
+		tController->render( tRenderRate, tRenderEnd, [&] ( size_t, double ) {
+			Clock::time_point tStepEnd = Clock::now();
+			double tMs = std::chrono::duration<double, std::milli>( tStepEnd - tStepBegin ).count();
+			tStepTotalMs		+= tMs;
+			tResult.mStepMaxMs	= std::max( tResult.mStepMaxMs, tMs );
+			tStepBegin			= tStepEnd;
+		} );
+		tResult.mPlaybackFps	= (double)tRenderStepCount / std::max( std::chrono::duration<double>( Clock::now() - tPlayBegin ).count(), 1e-9 );
+		tResult.mStepMeanMs		= tStepTotalMs / (double)tRenderStepCount;
+		// Collect regression counts:
+		for( const FrameSequenceCheck* tCheck : tChecks ) {
+			tResult.mShownCount		+= tCheck->getShownCount();
+			tResult.mMissingCount	+= tCheck->getMissingCount();
+			tResult.mMismatchCount	+= tCheck->getMismatchCount();
+		}
+		// Play back in real time with read-ahead, counting held frames:
+		tChecking = false;
+		multitrack::ManualClock::Ref tPlayClock = multitrack::ManualClock::create();
+		tController->setClock( tPlayClock );
+		tController->seek( 0.0 );
+		tController->start();
+		Clock::time_point tRealBegin = Clock::now();
+		for( size_t tStep = 0; tStep < tStepCount; tStep++ ) {
+			double tTime = (double)tStep / tFrameRate;
+			std::this_thread::sleep_until( tRealBegin + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( tTime ) ) );
+			tPlayClock->setSeconds( tTime );
+			tController->update();
+			tController->draw();
+		}
+		for( auto& tUnderrunFn : tUnderrunFns ) {
+			tResult.mUnderrunCount += tUnderrunFn();
+		}
+		tController->stop();
+		return tResult;
+	}
+
+} } // namespace itp::synthetic
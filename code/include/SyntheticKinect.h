@@ -0,0 +1,573 @@
+/* ITP Future of Storytelling */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+#include "cinder/Vector.h"
+
+#if defined( ITP_MULTITRACK_HEADLESS )
+
+// Kinect SDK enums used by Kinect2 accessors (values match Kinect.h):
+enum _TrackingState
+{
+	TrackingState_NotTracked	= 0,
+	TrackingState_Inferred		= 1,
+	TrackingState_Tracked		= 2
+};
+typedef enum _TrackingState TrackingState;
+
+enum _JointType
+{
+	JointType_SpineBase		= 0,
+	JointType_SpineMid		= 1,
+	JointType_Neck			= 2,
+	JointType_Head			= 3,
+	JointType_ShoulderLeft	= 4,
+	JointType_ElbowLeft		= 5,
+	JointType_WristLeft		= 6,
+	JointType_HandLeft		= 7,
+	JointType_ShoulderRight	= 8,
+	JointType_ElbowRight	= 9,
+	JointType_WristRight	= 10,
+	JointType_HandRight		= 11,
+	JointType_HipLeft		= 12,
+	JointType_KneeLeft		= 13,
+	JointType_AnkleLeft		= 14,
+	JointType_FootLeft		= 15,
+	JointType_HipRight		= 16,
+	JointType_KneeRight		= 17,
+	JointType_AnkleRight	= 18,
+	JointType_FootRight		= 19,
+	JointType_SpineShoulder	= 20,
+	JointType_HandTipLeft	= 21,
+	JointType_ThumbLeft		= 22,
+	JointType_HandTipRight	= 23,
+	JointType_ThumbRight	= 24,
+	JointType_Count			= 25
+};
+typedef enum _JointType JointType;
+
+#else
+
+#include "Kinect2.h"
+
+#endif
+
+namespace itp { namespace synthetic {
+
+	static const int32_t	kDepthWidth		= 512;	//!< default depth and body-index frame width
+	static const int32_t	kDepthHeight	= 424;	//!< default depth and body-index frame height
+	static const int32_t	kColorWidth		= 1920;	//!< default color frame width
+	static const int32_t	kColorHeight	= 1080;	//!< default color frame height
+
+	static const double		kTicksPerSecond	= 10000000.0; //!< sensor timestamp resolution (100ns ticks, as reported by the Kinect)
+
+	/** @brief tracked body, mirroring Kinect2::Body accessors */
+	class Body {
+	public:
+
+		/** @brief body joint, mirroring Kinect2::Body::Joint accessors */
+		class Joint {
+		public:
+
+			Joint() :
+				mState( TrackingState_NotTracked )
+			{ /* no-op */ }
+
+			Joint(const ci::vec3& iPosition, TrackingState iState) :
+				mPosition( iPosition ),
+				mState( iState )
+			{ /* no-op */ }
+
+			const ci::vec3&	getPosition() const			{ return mPosition; }
+			TrackingState	getTrackingState() const	{ return mState; }
+
+		protected:
+
+			ci::vec3		mPosition;	//!< camera-space position (in meters)
+			TrackingState	mState;		//!< tracking state
+		};
+
+		Body() :
+			mId( 0 ),
+			mIndex( 0 ),
+			mTracked( false )
+		{ /* no-op */ }
+
+		Body(uint64_t iId, uint8_t iIndex, const std::map<JointType, Joint>& iJointMap) :
+			mId( iId ),
+			mIndex( iIndex ),
+			mJointMap( iJointMap ),
+			mTracked( true )
+		{ /* no-op */ }
+
+		uint64_t							getId() const		{ return mId; }
+		uint8_t								getIndex() const	{ return mIndex; }
+		const std::map<JointType, Joint>&	getJointMap() const	{ return mJointMap; }
+		bool								isTracked() const	{ return mTracked; }
+
+	protected:
+
+		uint64_t					mId;		//!< tracking id
+		uint8_t						mIndex;		//!< body slot
+		std::map<JointType, Joint>	mJointMap;	//!< joints
+		bool						mTracked;	//!< tracking flag
+	};
+
+	/** @brief base frame with sensor timestamp (in 100ns ticks) */
+	class Frame {
+	public:
+
+		Frame(long long iTimeStamp = 0L) :
+			mTimeStamp( iTimeStamp )
+		{ /* no-op */ }
+
+		long long getTimeStamp() const { return mTimeStamp; }
+
+	protected:
+
+		long long mTimeStamp; //!< sensor timestamp
+	};
+
+	/** @brief body frame, mirroring Kinect2::BodyFrame accessors */
+	class BodyFrame : public Frame {
+	public:
+
+		BodyFrame(long long iTimeStamp = 0L, const std::vector<Body>& iBodies = std::vector<Body>()) :
+			Frame( iTimeStamp ),
+			mBodies( iBodies )
+		{ /* no-op */ }
+
+		const std::vector<Body>& getBodies() const { return mBodies; }
+
+	protected:
+
+		std::vector<Body> mBodies; //!< bodies
+	};
+
+	/** @brief body-index frame, mirroring Kinect2::BodyIndexFrame accessors (255 marks background) */
+	class BodyIndexFrame : public Frame {
+	public:
+
+		BodyIndexFrame(long long iTimeStamp = 0L, const ci::Channel8uRef& iChannel = ci::Channel8uRef()) :
+			Frame( iTimeStamp ),
+			mChannel( iChannel )
+		{ /* no-op */ }
+
+		const ci::Channel8uRef& getChannel() const { return mChannel; }
+
+	protected:
+
+		ci::Channel8uRef mChannel; //!< body-index channel
+	};
+
+	/** @brief color frame, mirroring Kinect2::ColorFrame accessors */
+	class ColorFrame : public Frame {
+	public:
+
+		ColorFrame(long long iTimeStamp = 0L, const ci::Surface8uRef& iSurface = ci::Surface8uRef()) :
+			Frame( iTimeStamp ),
+			mSurface( iSurface )
+		{ /* no-op */ }
+
+		const ci::Surface8uRef&	getSurface() const	{ return mSurface; }
+		ci::ivec2				getSize() const		{ return mSurface ? mSurface->getSize() : ci::ivec2( kColorWidth, kColorHeight ); }
+
+	protected:
+
+		ci::Surface8uRef mSurface; //!< color surface
+	};
+
+	/** @brief depth frame, mirroring Kinect2::DepthFrame accessors (depth in millimeters, 0 is invalid) */
+	class DepthFrame : public Frame {
+	public:
+
+		DepthFrame(long long iTimeStamp = 0L, const ci::Channel16uRef& iChannel = ci::Channel16uRef()) :
+			Frame( iTimeStamp ),
+			mChannel( iChannel )
+		{ /* no-op */ }
+
+		const ci::Channel16uRef& getChannel() const { return mChannel; }
+
+	protected:
+
+		ci::Channel16uRef mChannel; //!< depth channel
+	};
+
+	/** @brief scales depth channel to 8 bits, mirroring Kinect2::channel16To8 */
+	static inline ci::Channel8uRef channel16To8(const ci::Channel16uRef& iChannel)
+	{
+		ci::Channel8uRef tOutput = ci::Channel8u::create( iChannel->getWidth(), iChannel->getHeight() );
+		for( int32_t y = 0; y < iChannel->getHeight(); y++ ) {
+			const uint16_t*	tSrc = iChannel->getData( ci::ivec2( 0, y ) );
+			uint8_t*		tDst = tOutput->getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < iChannel->getWidth(); x++ ) {
+				tDst[ x ] = static_cast<uint8_t>( tSrc[ x * iChannel->getIncrement() ] >> 5 );
+			}
+		}
+		return tOutput;
+	}
+
+	typedef std::shared_ptr<class Device> DeviceRef;
+
+	/**
+	 * @brief software Kinect device that synthesizes (or replays) color, depth, body-index and body frames
+	 *
+	 * The device exposes the Kinect2::Device callback interface. Frames are emitted on the calling thread,
+	 * either from update() at the configured rates in real time (late frames are dropped, as on the sensor),
+	 * or from advance() on a virtual clock, faster than real time and without drops.
+	 *
+	 * By default a single tracked body sways in front of a flat background; any stream can be replaced by
+	 * a generator function, e.g. to replay recorded frames.
+	 */
+	class Device {
+	public:
+
+		/** @brief stream configuration */
+		struct Format
+		{
+			ci::ivec2	mColorSize;		//!< color frame size
+			ci::ivec2	mDepthSize;		//!< depth and body-index frame size
+			double		mColorFps;		//!< color frame rate (0 disables stream)
+			double		mDepthFps;		//!< depth frame rate (0 disables stream)
+			double		mBodyIndexFps;	//!< body-index frame rate (0 disables stream)
+			double		mBodyFps;		//!< body frame rate (0 disables stream)
+			size_t		mBodyCount;		//!< number of synthesized bodies (at most 6)
+
+			Format() :
+				mColorSize( kColorWidth, kColorHeight ),
+				mDepthSize( kDepthWidth, kDepthHeight ),
+				mColorFps( 30.0 ),
+				mDepthFps( 30.0 ),
+				mBodyIndexFps( 30.0 ),
+				mBodyFps( 30.0 ),
+				mBodyCount( 1 )
+			{ /* no-op */ }
+
+			Format& colorSize(const ci::ivec2& iSize)	{ mColorSize = iSize; return *this; }
+			Format& depthSize(const ci::ivec2& iSize)	{ mDepthSize = iSize; return *this; }
+			Format& colorFps(double iFps)				{ mColorFps = iFps; return *this; }
+			Format& depthFps(double iFps)				{ mDepthFps = iFps; return *this; }
+			Format& bodyIndexFps(double iFps)			{ mBodyIndexFps = iFps; return *this; }
+			Format& bodyFps(double iFps)				{ mBodyFps = iFps; return *this; }
+			Format& bodyCount(size_t iCount)			{ mBodyCount = std::min<size_t>( iCount, 6 ); return *this; }
+		};
+
+		typedef std::function<void(const BodyFrame&)>		BodyEventHandler;
+		typedef std::function<void(const BodyIndexFrame&)>	BodyIndexEventHandler;
+		typedef std::function<void(const ColorFrame&)>		ColorEventHandler;
+		typedef std::function<void(const DepthFrame&)>		DepthEventHandler;
+
+		typedef std::function<BodyFrame(long long)>			BodyGenerator;		//!< produces body frame for a timestamp
+		typedef std::function<BodyIndexFrame(long long)>	BodyIndexGenerator;	//!< produces body-index frame for a timestamp
+		typedef std::function<ColorFrame(long long)>		ColorGenerator;		//!< produces color frame for a timestamp
+		typedef std::function<DepthFrame(long long)>		DepthGenerator;		//!< produces depth frame for a timestamp
+
+	private:
+
+		/** @brief emission state of a single stream */
+		struct Stream
+		{
+			double		mFps;		//!< frame rate
+			uint64_t	mNext;		//!< index of next frame to emit
+			uint64_t	mEmitted;	//!< emitted frame count
+			uint64_t	mDropped;	//!< dropped frame count (real-time mode only)
+
+			Stream(double iFps = 0.0) : mFps( iFps ), mNext( 0 ), mEmitted( 0 ), mDropped( 0 ) { /* no-op */ }
+
+			/** @brief returns time of frame at index (in seconds) */
+			double getTime(uint64_t iIndex) const { return (double)iIndex / mFps; }
+		};
+
+		Format					mFormat;			//!< stream configuration
+		bool					mRunning;			//!< activity flag
+		double					mTime;				//!< device time of last emission (in seconds)
+		std::chrono::steady_clock::time_point	mStartTime;	//!< real-time start
+
+		Stream					mColorStream;		//!< color stream state
+		Stream					mDepthStream;		//!< depth stream state
+		Stream					mBodyIndexStream;	//!< body-index stream state
+		Stream					mBodyStream;		//!< body stream state
+
+		BodyEventHandler		mBodyHandler;		//!< body callback
+		BodyIndexEventHandler	mBodyIndexHandler;	//!< body-index callback
+		ColorEventHandler		mColorHandler;		//!< color callback
+		DepthEventHandler		mDepthHandler;		//!< depth callback
+
+		BodyGenerator			mBodyGenerator;		//!< body frame source
+		BodyIndexGenerator		mBodyIndexGenerator;//!< body-index frame source
+		ColorGenerator			mColorGenerator;	//!< color frame source
+		DepthGenerator			mDepthGenerator;	//!< depth frame source
+
+		/** @brief default constructor */
+		Device(const Format& iFormat = Format()) :
+			mFormat( iFormat ),
+			mRunning( false ),
+			mTime( 0.0 ),
+			mColorStream( iFormat.mColorFps ),
+			mDepthStream( iFormat.mDepthFps ),
+			mBodyIndexStream( iFormat.mBodyIndexFps ),
+			mBodyStream( iFormat.mBodyFps )
+		{ /* no-op */ }
+
+		/** @brief returns depth-space center of synthesized body (normalized) at time */
+		ci::vec2 getBodyCenter(size_t iBody, double iTime) const
+		{
+			double tSpan = 1.0 / (double)( mFormat.mBodyCount + 1 );
+			return ci::vec2( (float)( tSpan * ( iBody + 1 ) + 0.1 * tSpan * std::sin( 1.5 * iTime + (double)iBody ) ), 0.55f );
+		}
+
+		/** @brief returns depth of synthesized body (in millimeters) */
+		uint16_t getBodyDepth(size_t iBody) const
+		{
+			return (uint16_t)( 1500 + 400 * iBody );
+		}
+
+		/** @brief returns body slot covering depth pixel, or -1 for background */
+		int getBodyAt(int32_t iX, int32_t iY, double iTime) const
+		{
+			float tX = ( (float)iX + 0.5f ) / (float)mFormat.mDepthSize.x;
+			float tY = ( (float)iY + 0.5f ) / (float)mFormat.mDepthSize.y;
+			for( size_t i = 0; i < mFormat.mBodyCount; i++ ) {
+				ci::vec2 tCenter = getBodyCenter( i, iTime );
+				float tDx = ( tX - tCenter.x ) / 0.06f;
+				float tDy = ( tY - tCenter.y ) / 0.32f;
+				if( tDx * tDx + tDy * tDy <= 1.0f ) return (int)i;
+			}
+			return -1;
+		}
+
+		/** @brief synthesizes body frame */
+		BodyFrame makeBodyFrame(long long iTimeStamp) const
+		{
+			// Joint offsets from body center (in meters):
+			static const float kJointOffsets[ JointType_Count ][ 2 ] = {
+				{  0.00f, -0.10f }, {  0.00f,  0.15f }, {  0.00f,  0.45f }, {  0.00f,  0.60f }, { -0.18f,  0.38f },
+				{ -0.28f,  0.15f }, { -0.32f, -0.08f }, { -0.33f, -0.15f }, {  0.18f,  0.38f }, {  0.28f,  0.15f },
+				{  0.32f, -0.08f }, {  0.33f, -0.15f }, { -0.09f, -0.12f }, { -0.11f, -0.50f }, { -0.12f, -0.85f },
+				{ -0.13f, -0.92f }, {  0.09f, -0.12f }, {  0.11f, -0.50f }, {  0.12f, -0.85f }, {  0.13f, -0.92f },
+				{  0.00f,  0.38f }, { -0.34f, -0.22f }, { -0.30f, -0.16f }, {  0.34f, -0.22f }, {  0.30f, -0.16f }
+			};
+			double tTime = (double)iTimeStamp / kTicksPerSecond;
+			std::vector<Body> tBodies;
+			for( size_t i = 0; i < mFormat.mBodyCount; i++ ) {
+				// Unproject body center:
+				ci::vec2	tCenter	= getBodyCenter( i, tTime );
+				float		tZ		= (float)getBodyDepth( i ) * 0.001f;
+				ci::vec3	tOrigin( ( tCenter.x - 0.5f ) * tZ / getFocalScale(), ( 0.5f - tCenter.y ) * tZ / getFocalScale(), tZ );
+				// Place joints:
+				std::map<JointType, Body::Joint> tJoints;
+				for( int j = 0; j < JointType_Count; j++ ) {
+					ci::vec3 tPosition( tOrigin.x + kJointOffsets[ j ][ 0 ], tOrigin.y + kJointOffsets[ j ][ 1 ], tOrigin.z );
+					tJoints[ (JointType)j ] = Body::Joint( tPosition, TrackingState_Tracked );
+				}
+				tBodies.push_back( Body( 1000 + i, (uint8_t)i, tJoints ) );
+			}
+			return BodyFrame( iTimeStamp, tBodies );
+		}
+
+		/** @brief synthesizes body-index frame */
+		BodyIndexFrame makeBodyIndexFrame(long long iTimeStamp) const
+		{
+			double tTime = (double)iTimeStamp / kTicksPerSecond;
+			ci::Channel8uRef tChannel = ci::Channel8u::create( mFormat.mDepthSize.x, mFormat.mDepthSize.y );
+			for( int32_t y = 0; y < mFormat.mDepthSize.y; y++ ) {
+				uint8_t* tDst = tChannel->getData( ci::ivec2( 0, y ) );
+				for( int32_t x = 0; x < mFormat.mDepthSize.x; x++ ) {
+					int tBody = getBodyAt( x, y, tTime );
+					tDst[ x ] = ( tBody < 0 ) ? 255 : (uint8_t)tBody;
+				}
+			}
+			return BodyIndexFrame( iTimeStamp, tChannel );
+		}
+
+		/** @brief synthesizes depth frame (background wall at 4m, invalid border columns) */
+		DepthFrame makeDepthFrame(long long iTimeStamp) const
+		{
+			double tTime = (double)iTimeStamp / kTicksPerSecond;
+			ci::Channel16uRef tChannel = ci::Channel16u::create( mFormat.mDepthSize.x, mFormat.mDepthSize.y );
+			for( int32_t y = 0; y < mFormat.mDepthSize.y; y++ ) {
+				uint16_t* tDst = tChannel->getData( ci::ivec2( 0, y ) );
+				for( int32_t x = 0; x < mFormat.mDepthSize.x; x++ ) {
+					int tBody = getBodyAt( x, y, tTime );
+					if( tBody >= 0 ) {
+						tDst[ x ] = getBodyDepth( tBody );
+					}
+					else if( x < 8 || x >= mFormat.mDepthSize.x - 8 ) {
+						tDst[ x ] = 0;
+					}
+					else {
+						tDst[ x ] = (uint16_t)( 4000 + ( y >> 2 ) );
+					}
+				}
+			}
+			return DepthFrame( iTimeStamp, tChannel );
+		}
+
+		/** @brief synthesizes color frame (BGRA gradient with moving bar) */
+		ColorFrame makeColorFrame(long long iTimeStamp) const
+		{
+			double tTime = (double)iTimeStamp / kTicksPerSecond;
+			ci::Surface8uRef tSurface = ci::Surface8u::create( mFormat.mColorSize.x, mFormat.mColorSize.y, true, ci::SurfaceChannelOrder::BGRA );
+			int32_t tBar = (int32_t)( std::fmod( tTime * 0.25, 1.0 ) * mFormat.mColorSize.x );
+			for( int32_t y = 0; y < mFormat.mColorSize.y; y++ ) {
+				uint8_t* tDst = tSurface->getData( ci::ivec2( 0, y ) );
+				uint8_t tGreen = (uint8_t)( ( y * 255 ) / std::max( mFormat.mColorSize.y - 1, 1 ) );
+				for( int32_t x = 0; x < mFormat.mColorSize.x; x++, tDst += 4 ) {
+					bool tOnBar = ( x >= tBar && x < tBar + 32 );
+					tDst[ 0 ] = tOnBar ? 255 : (uint8_t)( x & 0xFF );
+					tDst[ 1 ] = tGreen;
+					tDst[ 2 ] = tOnBar ? 255 : 64;
+					tDst[ 3 ] = 255;
+				}
+			}
+			return ColorFrame( iTimeStamp, tSurface );
+		}
+
+		/** @brief returns normalized focal scale (depth-space pixels per meter at 1m, over frame width) */
+		float getFocalScale() const
+		{
+			return 365.0f / 512.0f;
+		}
+
+		/** @brief emits all frames of a stream due up to time; when dropping, only the newest due frame is emitted */
+		template <typename FrameT, typename GeneratorT, typename MakerT, typename HandlerT>
+		void emitStream(Stream& ioStream, double iTime, bool iDropLate, const GeneratorT& iGenerator, MakerT iMaker, const HandlerT& iHandler)
+		{
+			if( ioStream.mFps <= 0.0 ) return;
+			uint64_t tLast = (uint64_t)std::floor( iTime * ioStream.mFps + 1e-9 );
+			if( ioStream.mNext > tLast ) return;
+			// Drop late frames:
+			if( iDropLate && tLast > ioStream.mNext ) {
+				ioStream.mDropped += tLast - ioStream.mNext;
+				ioStream.mNext = tLast;
+			}
+			for( ; ioStream.mNext <= tLast; ioStream.mNext++ ) {
+				long long tTimeStamp = (long long)( ioStream.getTime( ioStream.mNext ) * kTicksPerSecond + 0.5 );
+				if( iHandler ) {
+					FrameT tFrame = iGenerator ? iGenerator( tTimeStamp ) : ( this->*iMaker )( tTimeStamp );
+					iHandler( tFrame );
+				}
+				ioStream.mEmitted++;
+			}
+		}
+
+		/** @brief emits all streams up to time, in stream order body, body-index, color, depth (as in Kinect2::Device::update) */
+		void emitUntil(double iTime, bool iDropLate)
+		{
+			mTime = iTime;
+			emitStream<BodyFrame>( mBodyStream, iTime, iDropLate, mBodyGenerator, &Device::makeBodyFrame, mBodyHandler );
+			emitStream<BodyIndexFrame>( mBodyIndexStream, iTime, iDropLate, mBodyIndexGenerator, &Device::makeBodyIndexFrame, mBodyIndexHandler );
+			emitStream<ColorFrame>( mColorStream, iTime, iDropLate, mColorGenerator, &Device::makeColorFrame, mColorHandler );
+			emitStream<DepthFrame>( mDepthStream, iTime, iDropLate, mDepthGenerator, &Device::makeDepthFrame, mDepthHandler );
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static DeviceRef create(Args&& ... args)
+		{
+			return DeviceRef( new Device( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief starts device clock at zero */
+		void start()
+		{
+			mRunning	= true;
+			mTime		= 0.0;
+			mStartTime	= std::chrono::steady_clock::now();
+			mColorStream		= Stream( mFormat.mColorFps );
+			mDepthStream		= Stream( mFormat.mDepthFps );
+			mBodyIndexStream	= Stream( mFormat.mBodyIndexFps );
+			mBodyStream			= Stream( mFormat.mBodyFps );
+		}
+
+		/** @brief stops device */
+		void stop()
+		{
+			mRunning = false;
+		}
+
+		/** @brief emits frames due since start in real time, dropping frames that are already late */
+		void update()
+		{
+			if( ! mRunning ) return;
+			emitUntil( std::chrono::duration<double>( std::chrono::steady_clock::now() - mStartTime ).count(), true );
+		}
+
+		/** @brief advances virtual clock and emits every frame due, without drops */
+		void advance(double iSeconds)
+		{
+			if( ! mRunning ) return;
+			emitUntil( mTime + std::max( iSeconds, 0.0 ), false );
+		}
+
+		void connectBodyEventHandler(const BodyEventHandler& iHandler)				{ mBodyHandler = iHandler; }
+		void connectBodyIndexEventHandler(const BodyIndexEventHandler& iHandler)	{ mBodyIndexHandler = iHandler; }
+		void connectColorEventHandler(const ColorEventHandler& iHandler)			{ mColorHandler = iHandler; }
+		void connectDepthEventHandler(const DepthEventHandler& iHandler)			{ mDepthHandler = iHandler; }
+
+		void setBodyGenerator(const BodyGenerator& iGenerator)						{ mBodyGenerator = iGenerator; }
+		void setBodyIndexGenerator(const BodyIndexGenerator& iGenerator)			{ mBodyIndexGenerator = iGenerator; }
+		void setColorGenerator(const ColorGenerator& iGenerator)					{ mColorGenerator = iGenerator; }
+		void setDepthGenerator(const DepthGenerator& iGenerator)					{ mDepthGenerator = iGenerator; }
+
+		/** @brief projects camera-space point (in meters) to depth-space pixel coordinates */
+		ci::vec2 mapCameraToDepth(const ci::vec3& iPoint) const
+		{
+			if( iPoint.z <= 0.0f ) return ci::vec2( -1.0f, -1.0f );
+			float tScale = getFocalScale() / iPoint.z;
+			return ci::vec2( ( 0.5f + iPoint.x * tScale ) * (float)mFormat.mDepthSize.x, ( 0.5f - iPoint.y * tScale ) * (float)mFormat.mDepthSize.y );
+		}
+
+		/** @brief maps every depth pixel to color-space pixel coordinates; pixels with zero depth map to ( -1, -1 ) */
+		std::vector<ci::ivec2> mapDepthToColor(const ci::Channel16uRef& iDepth) const
+		{
+			// Color camera sees a slightly wider field, offset by a 52mm baseline:
+			const float tScaleX		= (float)mFormat.mColorSize.x / (float)iDepth->getWidth() * 0.85f;
+			const float tScaleY		= (float)mFormat.mColorSize.y / (float)iDepth->getHeight() * 0.85f;
+			const float tParallax	= 1060.0f * 52.0f;
+			std::vector<ci::ivec2> tOutput( size_t( iDepth->getWidth() ) * size_t( iDepth->getHeight() ) );
+			std::vector<ci::ivec2>::iterator tDst = tOutput.begin();
+			for( int32_t y = 0; y < iDepth->getHeight(); y++ ) {
+				const uint16_t* tSrc = iDepth->getData( ci::ivec2( 0, y ) );
+				for( int32_t x = 0; x < iDepth->getWidth(); x++, ++tDst ) {
+					uint16_t tZ = tSrc[ x * iDepth->getIncrement() ];
+					if( tZ == 0 ) {
+						*tDst = ci::ivec2( -1, -1 );
+						continue;
+					}
+					float tX = 0.5f * (float)mFormat.mColorSize.x + ( (float)x - 0.5f * (float)iDepth->getWidth() ) * tScaleX + tParallax / (float)tZ;
+					float tY = 0.5f * (float)mFormat.mColorSize.y + ( (float)y - 0.5f * (float)iDepth->getHeight() ) * tScaleY;
+					*tDst = ci::ivec2( (int32_t)std::floor( tX + 0.5f ), (int32_t)std::floor( tY + 0.5f ) );
+				}
+			}
+			return tOutput;
+		}
+
+		const Format&	getFormat() const				{ return mFormat; }
+		bool			isRunning() const				{ return mRunning; }
+		double			getTime() const					{ return mTime; }
+		uint64_t		getColorFrameCount() const		{ return mColorStream.mEmitted; }
+		uint64_t		getDepthFrameCount() const		{ return mDepthStream.mEmitted; }
+		uint64_t		getBodyIndexFrameCount() const	{ return mBodyIndexStream.mEmitted; }
+		uint64_t		getBodyFrameCount() const		{ return mBodyStream.mEmitted; }
+		uint64_t		getDroppedFrameCount() const	{ return mColorStream.mDropped + mDepthStream.mDropped + mBodyIndexStream.mDropped + mBodyStream.mDropped; }
+	};
+
+} } // namespace itp::synthetic
+
+#if defined( ITP_MULTITRACK_HEADLESS )
+// Stand in for the Kinect2 block in headless builds:
+namespace Kinect2 = ::itp::synthetic;
+#endif
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "cinder/Channel.h"
+
+#include <Simd.h>
+
+namespace itp { namespace multitrack {
+
+	typedef std::shared_ptr<struct BodyIndexRle> BodyIndexRleRef;
+
+	/**
+	 * @brief body-index frame packed as runs of body pixels, row by row
+	 *
+	 * Body-index frames are mostly background (255) with a few runs of body slots per row, so only those runs
+	 * are kept: the runs of row y are mRuns[ mRowStarts[ y ], mRowStarts[ y + 1 ] ), in left-to-right order,
+	 * and every pixel outside them is background. Storage is kept when a frame is packed again, so pooled
+	 * frames can be refilled every frame without allocating.
+	 */
+	struct BodyIndexRle
+	{
+		static const uint8_t kBackground = 255; //!< body-index value of pixels without a body
+
+		/** @brief run of pixels sharing one body-index value */
+		struct Run
+		{
+			uint16_t	mBegin;		//!< first pixel of run
+			uint16_t	mLength;	//!< number of pixels in run
+			uint8_t		mValue;		//!< body-index value
+		};
+
+		int32_t					mWidth;		//!< frame width (in pixels)
+		int32_t					mHeight;	//!< frame height (in pixels)
+		std::vector<uint32_t>	mRowStarts;	//!< index of first run of each row, plus total run count
+		std::vector<Run>		mRuns;		//!< runs of all rows
+
+		/** @brief default constructor */
+		BodyIndexRle() :
+			mWidth( 0 ),
+			mHeight( 0 )
+		{ /* no-op */ }
+
+		/** @brief packs a body-index channel (frames wider than 65535 pixels are not supported) */
+		void pack(const ci::Channel8u& iChannel)
+		{
+			if( iChannel.getWidth() > 0xFFFF ) {
+				throw std::runtime_error( "BodyIndexRle received frame wider than 65535 pixels" );
+			}
+			mWidth	= iChannel.getWidth();
+			mHeight	= iChannel.getHeight();
+			mRowStarts.resize( size_t( mHeight ) + 1 );
+			mRuns.clear();
+			const int32_t tInc = iChannel.getIncrement();
+			for( int32_t y = 0; y < mHeight; y++ ) {
+				mRowStarts[ y ] = static_cast<uint32_t>( mRuns.size() );
+				const uint8_t*	tRow	= iChannel.getData( ci::ivec2( 0, y ) );
+				int32_t			x		= 0;
+				while( x < mWidth ) {
+					// Find next body pixel, then end of its run:
+					x = find_value_end( tRow, tInc, x, mWidth, kBackground );
+					if( x == mWidth ) break;
+					uint8_t	tValue	= tRow[ x * tInc ];
+					int32_t	tEnd	= find_value_end( tRow, tInc, x + 1, mWidth, tValue );
+					Run		tRun	= { static_cast<uint16_t>( x ), static_cast<uint16_t>( tEnd - x ), tValue };
+					mRuns.push_back( tRun );
+					x = tEnd;
+				}
+			}
+			mRowStarts[ mHeight ] = static_cast<uint32_t>( mRuns.size() );
+		}
+
+		/** @brief returns index of first pixel in [iBegin, iEnd) of a row with given pixel increment that differs from iValue, or iEnd */
+		static int32_t find_value_end(const uint8_t* iRow, int32_t iInc, int32_t iBegin, int32_t iEnd, uint8_t iValue)
+		{
+			int32_t x = iBegin;
+#if ITP_SIMD_SSE2
+			// Compare sixteen pixels per step:
+			if( iInc == 1 ) {
+				const __m128i tValue = _mm_set1_epi8( static_cast<char>( iValue ) );
+				for( ; x + 16 <= iEnd; x += 16 ) {
+					__m128i tPixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( iRow + x ) );
+					if( _mm_movemask_epi8( _mm_cmpeq_epi8( tPixels, tValue ) ) != 0xFFFF ) break;
+				}
+			}
+#endif
+			for( ; x < iEnd; x++ ) {
+				if( iRow[ x * iInc ] != iValue ) return x;
+			}
+			return iEnd;
+		}
+
+		/** @brief expands row y into frame-width tightly packed pixels */
+		void unpackRow(int32_t y, uint8_t* oRow) const
+		{
+			std::memset( oRow, kBackground, mWidth );
+			const Run* tRun = getRowRuns( y );
+			for( const Run* tEnd = tRun + getRowRunCount( y ); tRun != tEnd; ++tRun ) {
+				std::memset( oRow + tRun->mBegin, tRun->mValue, tRun->mLength );
+			}
+		}
+
+		/** @brief expands frame into caller-owned pixels with given row stride (e.g. a mapped texture upload buffer) */
+		void unpack(uint8_t* oPixels, size_t iRowBytes) const
+		{
+			for( int32_t y = 0; y < mHeight; y++, oPixels += iRowBytes ) {
+				unpackRow( y, oPixels );
+			}
+		}
+
+		/** @brief expands frame into a channel of same size */
+		void unpack(ci::Channel8u& oChannel) const
+		{
+			if( oChannel.getWidth() != mWidth || oChannel.getHeight() != mHeight ) {
+				throw std::runtime_error( "BodyIndexRle received output channel of unexpected size" );
+			}
+			if( oChannel.getIncrement() == 1 ) {
+				unpack( oChannel.getData(), oChannel.getRowBytes() );
+				return;
+			}
+			if( mWidth == 0 ) return;
+			std::vector<uint8_t> tRow( mWidth );
+			for( int32_t y = 0; y < mHeight; y++ ) {
+				unpackRow( y, &tRow[ 0 ] );
+				uint8_t* tDst = oChannel.getData( ci::ivec2( 0, y ) );
+				for( int32_t x = 0; x < mWidth; x++ ) {
+					tDst[ x * oChannel.getIncrement() ] = tRow[ x ];
+				}
+			}
+		}
+
+		/** @brief returns first run of row y */
+		const Run* getRowRuns(int32_t y) const
+		{
+			return mRuns.empty() ? NULL : &mRuns[ 0 ] + mRowStarts[ y ];
+		}
+
+		/** @brief returns number of runs in row y */
+		size_t getRowRunCount(int32_t y) const
+		{
+			return mRowStarts[ y + 1 ] - mRowStarts[ y ];
+		}
+
+		int32_t		getWidth() const	{ return mWidth; }
+		int32_t		getHeight() const	{ return mHeight; }
+		ci::ivec2	getSize() const		{ return ci::ivec2( mWidth, mHeight ); }
+		size_t		getRunCount() const	{ return mRuns.size(); }
+	};
+
+} } // namespace itp::multitrack
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <Simd.h>
+
+namespace itp { namespace multitrack {
+
+	/*
+	 * Channel delta encoding, against the previous frame of the same size (pixels in row order):
+	 *
+	 *   { varint skip, varint count, varint residual * count } until every pixel is covered
+	 *
+	 * Skipped pixels keep their previous value. Each residual is the difference to the previous value,
+	 * wrapped to the pixel width and zigzag-mapped (0, -1, 1, -2, ... to 0, 1, 2, 3, ...), so sensor noise
+	 * of a few units takes a single byte and decoding is lossless for any pair of frames.
+	 * Varints are little-endian base-128 (seven bits per byte, high bit set on all but the last byte).
+	 */
+
+	static const size_t kChannelDeltaMinSkip = 8; //!< shortest unchanged span that ends a run of residuals (in pixels)
+
+	/** @brief appends a base-128 varint */
+	inline void write_varint(std::vector<uint8_t>& ioData, uint32_t iValue)
+	{
+		while( iValue >= 0x80 ) {
+			ioData.push_back( static_cast<uint8_t>( iValue | 0x80 ) );
+			iValue >>= 7;
+		}
+		ioData.push_back( static_cast<uint8_t>( iValue ) );
+	}
+
+	/** @brief reads a base-128 varint and advances input; returns false if input ends or value exceeds 32 bits */
+	inline bool read_varint(const uint8_t*& ioCurr, const uint8_t* iEnd, uint32_t& oValue)
+	{
+		uint32_t tValue = 0;
+		for( uint32_t tShift = 0; tShift < 35; tShift += 7 ) {
+			if( ioCurr == iEnd ) return false;
+			uint8_t tByte = *ioCurr++;
+			tValue |= uint32_t( tByte & 0x7F ) << tShift;
+			if( ( tByte & 0x80 ) == 0 ) {
+				oValue = tValue;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** @brief returns zigzag-mapped difference between two pixel values, wrapped to pixel width */
+	template<typename V> inline uint32_t get_delta_residual(V iCurr, V iPrev)
+	{
+		const uint32_t tMask = std::numeric_limits<V>::max();
+		const uint32_t tSign = ( tMask >> 1 ) + 1;
+		uint32_t tDiff = ( uint32_t( iCurr ) - uint32_t( iPrev ) ) & tMask;
+		return ( tDiff & tSign ) ? ( ( ~tDiff << 1 ) | 1 ) & tMask : ( tDiff << 1 ) & tMask;
+	}
+
+	/** @brief returns pixel value from previous value and zigzag-mapped residual */
+	template<typename V> inline V apply_delta_residual(V iPrev, uint32_t iResidual)
+	{
+		uint32_t tDiff = ( iResidual & 1 ) ? ~( iResidual >> 1 ) : ( iResidual >> 1 );
+		return static_cast<V>( uint32_t( iPrev ) + tDiff );
+	}
+
+	/** @brief returns index of first pixel in [iBegin, iEnd) that differs between frames, or iEnd */
+	template<typename V> inline size_t find_changed_pixel(const V* iCurr, const V* iPrev, size_t iBegin, size_t iEnd)
+	{
+		size_t x = iBegin;
+#if ITP_SIMD_SSE2
+		// Compare sixteen bytes per step:
+		const size_t tStep = 16 / sizeof( V );
+		for( ; x + tStep <= iEnd; x += tStep ) {
+			__m128i tCurr = _mm_loadu_si128( reinterpret_cast<const __m128i*>( iCurr + x ) );
+			__m128i tPrev = _mm_loadu_si128( reinterpret_cast<const __m128i*>( iPrev + x ) );
+			if( _mm_movemask_epi8( _mm_cmpeq_epi8( tCurr, tPrev ) ) != 0xFFFF ) break;
+		}
+#endif
+		for( ; x < iEnd; x++ ) {
+			if( iCurr[ x ] != iPrev[ x ] ) return x;
+		}
+		return iEnd;
+	}
+
+	/** @brief returns index of first unchanged span in [iBegin, iEnd) that is at least iMinSkip long or reaches iEnd, or iEnd */
+	template<typename V> inline size_t find_unchanged_span(const V* iCurr, const V* iPrev, size_t iBegin, size_t iEnd, size_t iMinSkip)
+	{
+		size_t x = iBegin;
+		while( x < iEnd ) {
+			if( iCurr[ x ] != iPrev[ x ] ) {
+				x++;
+				continue;
+			}
+			size_t tNext = find_changed_pixel( iCurr, iPrev, x, iEnd );
+			if( tNext == iEnd || tNext - x >= iMinSkip ) return x;
+			x = tNext;
+		}
+		return iEnd;
+	}
+
+	/** @brief appends delta of iCount pixels against previous frame */
+	template<typename V> inline void write_channel_delta(std::vector<uint8_t>& ioData, const V* iCurr, const V* iPrev, size_t iCount)
+	{
+		size_t x = 0;
+		while( x < iCount ) {
+			// Skip unchanged pixels, then take residuals up to the next long unchanged span:
+			size_t tBegin	= find_changed_pixel( iCurr, iPrev, x, iCount );
+			size_t tEnd		= find_unchanged_span( iCurr, iPrev, tBegin, iCount, kChannelDeltaMinSkip );
+			write_varint( ioData, static_cast<uint32_t>( tBegin - x ) );
+			write_varint( ioData, static_cast<uint32_t>( tEnd - tBegin ) );
+			for( size_t i = tBegin; i < tEnd; i++ ) {
+				write_varint( ioData, get_delta_residual<V>( iCurr[ i ], iPrev[ i ] ) );
+			}
+			x = tEnd;
+		}
+	}
+
+	/** @brief applies delta of iCount pixels to previous frame in place */
+	template<typename V> inline void read_channel_delta(const uint8_t* iData, size_t iSize, V* ioFrame, size_t iCount)
+	{
+		const uint8_t*	tCurr	= iData;
+		const uint8_t*	tEnd	= iData + iSize;
+		const uint32_t	tMax	= std::numeric_limits<V>::max();
+		size_t x = 0;
+		while( x < iCount ) {
+			uint32_t tSkip, tLength;
+			if( ! read_varint( tCurr, tEnd, tSkip ) || ! read_varint( tCurr, tEnd, tLength ) || tSkip > iCount - x || tLength > iCount - x - tSkip || ( tSkip == 0 && tLength == 0 ) ) {
+				throw std::runtime_error( "Could not read channel delta payload" );
+			}
+			x += tSkip;
+			for( size_t tStop = x + tLength; x < tStop; x++ ) {
+				uint32_t tResidual;
+				if( ! read_varint( tCurr, tEnd, tResidual ) || tResidual > tMax ) {
+					throw std::runtime_error( "Could not read channel delta payload" );
+				}
+				ioFrame[ x ] = apply_delta_residual<V>( ioFrame[ x ], tResidual );
+			}
+		}
+	}
+
+} } // namespace itp::multitrack
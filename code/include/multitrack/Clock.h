@@ -0,0 +1,228 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "cinder/Timer.h"
+
+namespace itp { namespace multitrack {
+
+	/** @brief time source for timers and recorders (in seconds, from an arbitrary origin) */
+	class Clock {
+	public:
+
+		typedef std::shared_ptr<Clock>			Ref;
+		typedef std::shared_ptr<const Clock>	ConstRef;
+
+		/** @brief destructor */
+		virtual ~Clock() { /* no-op */ }
+
+		/** @brief returns current time (in seconds) */
+		virtual double getSeconds() const = 0;
+	};
+
+	/** @brief monotonic real-time clock, starting at zero on construction */
+	class SteadyClock : public Clock {
+	public:
+
+		typedef std::shared_ptr<SteadyClock> Ref;
+
+	private:
+
+		ci::Timer mTimer; //!< high-resolution timer
+
+		/** @brief default constructor */
+		SteadyClock() :
+			mTimer( true )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static SteadyClock::Ref create(Args&& ... args)
+		{
+			return SteadyClock::Ref( new SteadyClock( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns seconds since construction */
+		double getSeconds() const override
+		{
+			return mTimer.getSeconds();
+		}
+	};
+
+	/** @brief clock that only moves when set or advanced, for offline rendering and tests */
+	class ManualClock : public Clock {
+	public:
+
+		typedef std::shared_ptr<ManualClock> Ref;
+
+	private:
+
+		mutable std::mutex	mMutex;		//!< guards time
+		double				mSeconds;	//!< current time (in seconds)
+
+		/** @brief default constructor */
+		ManualClock(double iSeconds = 0.0) :
+			mSeconds( iSeconds )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static ManualClock::Ref create(Args&& ... args)
+		{
+			return ManualClock::Ref( new ManualClock( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns current time (in seconds) */
+		double getSeconds() const override
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mSeconds;
+		}
+
+		/** @brief sets current time (in seconds) */
+		void setSeconds(double iSeconds)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mSeconds = iSeconds;
+		}
+
+		/** @brief moves current time forward (in seconds) */
+		void advance(double iSeconds)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mSeconds += iSeconds;
+		}
+	};
+
+	/** @brief shared anchor mapping sensor timestamps (100ns ticks) to clock time, so all pushed tracks of a recording share one epoch */
+	class SensorEpoch {
+	public:
+
+		typedef std::shared_ptr<SensorEpoch> Ref;
+
+		static const long long kTicksPerSecond = 10000000LL; //!< sensor timestamp resolution
+
+	private:
+
+		mutable std::mutex	mMutex;		//!< guards all members below
+		bool				mHasOrigin;	//!< true once first timestamp was seen
+		long long			mOrigin;	//!< first timestamp seen by any track (in ticks)
+		double				mSeconds;	//!< clock time of first timestamp (in seconds)
+
+		/** @brief default constructor */
+		SensorEpoch() :
+			mHasOrigin( false ),
+			mOrigin( 0LL ),
+			mSeconds( 0.0 )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static SensorEpoch::Ref create(Args&& ... args)
+		{
+			return SensorEpoch::Ref( new SensorEpoch( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief converts a sensor timestamp (in ticks) to clock time (in seconds); the first timestamp is anchored at iClockSeconds */
+		double toSeconds(long long iTimeStamp, double iClockSeconds)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			if( ! mHasOrigin ) {
+				mHasOrigin	= true;
+				mOrigin		= iTimeStamp;
+				mSeconds	= iClockSeconds;
+			}
+			return mSeconds + (double)( iTimeStamp - mOrigin ) / (double)kTicksPerSecond;
+		}
+
+		/** @brief forgets anchor, so the next timestamp starts a new epoch */
+		void reset()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mHasOrigin	= false;
+			mOrigin		= 0LL;
+			mSeconds	= 0.0;
+		}
+	};
+
+	/**
+	 * @brief clock following sensor frame timestamps (100ns ticks, as reported by the Kinect), zero at the first timestamp
+	 *
+	 * Inject it through Controller::create( directory, clock ) and feed it from the device frame handlers, so
+	 * playback and recording advance with the sensor rather than with the wall clock.
+	 */
+	class SensorClock : public Clock {
+	public:
+
+		typedef std::shared_ptr<SensorClock> Ref;
+
+	private:
+
+		mutable std::mutex	mMutex;		//!< guards all members below
+		SensorEpoch::Ref	mEpoch;		//!< maps timestamps to seconds (anchored at zero by first timestamp)
+		bool				mHasTime;	//!< true once first timestamp was seen
+		long long			mLatest;	//!< latest timestamp (in ticks)
+		double				mSeconds;	//!< clock time of latest timestamp (in seconds)
+
+		/** @brief default constructor (own epoch if none is given) */
+		SensorClock(SensorEpoch::Ref iEpoch = SensorEpoch::Ref()) :
+			mEpoch( iEpoch ? iEpoch : SensorEpoch::create() ),
+			mHasTime( false ),
+			mLatest( 0LL ),
+			mSeconds( 0.0 )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static SensorClock::Ref create(Args&& ... args)
+		{
+			return SensorClock::Ref( new SensorClock( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns seconds between first and latest timestamp */
+		double getSeconds() const override
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mSeconds;
+		}
+
+		/** @brief records a sensor timestamp (in ticks); timestamps older than the latest are ignored */
+		void setTimeStamp(long long iTimeStamp)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			if( mHasTime && iTimeStamp <= mLatest ) return;
+			mHasTime	= true;
+			mLatest		= iTimeStamp;
+			mSeconds	= mEpoch->toSeconds( iTimeStamp, 0.0 );
+		}
+
+		/** @brief returns latest timestamp (in ticks) */
+		long long getTimeStamp() const
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mLatest;
+		}
+
+		/** @brief returns epoch mapping timestamps to clock time */
+		const SensorEpoch::Ref& getEpoch() const
+		{
+			return mEpoch;
+		}
+
+		/** @brief forgets first timestamp, so the next one becomes zero */
+		void reset()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mEpoch->reset();
+			mHasTime	= false;
+			mLatest		= 0LL;
+			mSeconds	= 0.0;
+		}
+	};
+
+} } // namespace itp::multitrack
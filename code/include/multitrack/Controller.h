@@ -1,5 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <sstream>
+
+#include <ParallelFor.h>
+
+#include <multitrack/Clock.h>
 #include <multitrack/Track.h>
 #include <multitrack/TypeTrack.h>
 #include <multitrack/TrackGroup.h>
@@ -20,9 +29,9 @@ namespace itp { namespace multitrack {
 		ci::fs::path	mDirectory;
 		size_t			mUidGenerator;
 		
-		/** @brief default constructor */
-		Controller(const ci::fs::path& iDirectory) :
-			mTimer( Timer::create() ),
+		/** @brief default constructor (steady real-time clock if none is given) */
+		Controller(const ci::fs::path& iDirectory, Clock::Ref iClock = Clock::Ref()) :
+			mTimer( Timer::create( iClock ) ),
 			mSequence( TrackGroup::create( mTimer ) ),
 			mDirectory( iDirectory ),
 			mUidGenerator( 0 )
@@ -64,6 +73,127 @@ namespace itp { namespace multitrack {
 			mTimer->reset();
 		}
 
+		/** @brief moves sequence playhead to given time (in seconds) */
+		void seek(double iPlayhead)
+		{
+			mTimer->seek( iPlayhead );
+		}
+
+		/** @brief returns clock driving playback and recording */
+		const Clock::Ref& getClock() const
+		{
+			return mTimer->getClock();
+		}
+
+		/** @brief replaces clock driving playback and recording, keeping current playhead */
+		void setClock(Clock::Ref iClock)
+		{
+			mTimer->setClock( iClock );
+		}
+
+		/** @brief returns sequence playhead (in seconds) */
+		double getPlayhead() const
+		{
+			return mTimer->getPlayhead();
+		}
+
+		/**
+		 * @brief renders sequence offline at a fixed frame rate, as fast as frames can be decoded
+		 *
+		 * Playback is driven by a manual clock stepped by 1/iFrameRate, so every step shows exactly the frame
+		 * due at that time. Frames due within the next batch of steps are decoded on all cores (iThreadCount
+		 * workers, zero picks one per core), then each step is updated and drawn on the calling thread and
+		 * handed to iStepFn (step index, sequence time). The previous clock, playhead and activity are restored
+		 * when done. Recording must be completed or cancelled first, since starting the sequence would restart
+		 * active recorders.
+		 */
+		void render(double iFrameRate, double iDuration, std::function<void(size_t, double)> iStepFn, size_t iThreadCount = 0)
+		{
+			if( iFrameRate <= 0.0 || iDuration < 0.0 ) {
+				throw std::runtime_error( "Invalid render range" );
+			}
+			if( ! mRecordingDevices.empty() ) {
+				throw std::runtime_error( "Cannot render sequence while recording" );
+			}
+			ParallelFor::Ref tPool = ParallelFor::create( iThreadCount );
+			size_t tStepCount = static_cast<size_t>( std::floor( iDuration * iFrameRate + 1e-6 ) ) + 1;
+			size_t tBatchSize = tPool->getThreadCount() * 2;
+			// Swap in manual clock and switch players to synchronous decoding:
+			Clock::Ref tPrevClock = mTimer->getClock();
+			double tPrevPlayhead = mTimer->getPlayhead();
+			bool tWasActive = mTimer->isActive();
+			ManualClock::Ref tClock = ManualClock::create();
+			mTimer->setClock( tClock );
+			mTimer->seek( 0.0 );
+			mSequence->setOffline( true );
+			start();
+			// Restores real-time playback (players only resume read-ahead once restarted):
+			auto tRestore = [&] () {
+				stop();
+				mSequence->setOffline( false );
+				mTimer->setClock( tPrevClock );
+				if( tWasActive ) start();
+				mTimer->seek( tPrevPlayhead );
+			};
+			try {
+				for( size_t tBatch = 0; tBatch < tStepCount; tBatch += tBatchSize ) {
+					size_t tBatchEnd = std::min( tBatch + tBatchSize, tStepCount );
+					// Decode frames due within batch in parallel:
+					TrackBase::DecodeJobVec tJobs;
+					mSequence->collectDecodeJobs( (double)tBatch / iFrameRate, (double)( tBatchEnd - 1 ) / iFrameRate, tJobs );
+					tPool->run( 0, tJobs.size(), [&tJobs] ( size_t iBegin, size_t iEnd ) {
+						for( size_t i = iBegin; i < iEnd; i++ ) tJobs[ i ]();
+					} );
+					// Step, draw and emit each frame:
+					for( size_t tStep = tBatch; tStep < tBatchEnd; tStep++ ) {
+						double tTime = (double)tStep / iFrameRate;
+						tClock->setSeconds( tTime );
+						update();
+						draw();
+						if( iStepFn ) iStepFn( tStep, tTime );
+					}
+				}
+			}
+			catch( ... ) {
+				tRestore();
+				throw;
+			}
+			tRestore();
+		}
+
+		/**
+		 * @brief renders sequence offline and writes one captured frame per step to a directory
+		 *
+		 * iCaptureFn is called after each step is drawn (e.g. to read back a composited FBO); frames are
+		 * written as "frame_000000.<ext>" by a background writer, so encoding overlaps the next steps. The
+		 * writer is stopped even if a step fails; the first failure (step or write) is rethrown.
+		 */
+		template <typename T> void render(double iFrameRate, double iDuration, std::function<T(void)> iCaptureFn, const ci::fs::path& iDirectory, size_t iThreadCount = 0)
+		{
+			if( ! ci::fs::exists( iDirectory ) && ! ci::fs::create_directories( iDirectory ) ) {
+				throw std::runtime_error( "Failed to create render directory \'" + iDirectory.string() + "\'" );
+			}
+			WriterQueue::Ref tWriter = WriterQueue::create();
+			tWriter->start();
+			std::string tExtension = get_file_extension<T>();
+			std::exception_ptr tError;
+			try {
+				render( iFrameRate, iDuration, [&] ( size_t iStep, double iTime ) {
+					T tItem = iCaptureFn();
+					if( ! tItem ) return;
+					std::ostringstream tName;
+					tName << "frame_" << std::setw( 6 ) << std::setfill( '0' ) << iStep << "." << tExtension;
+					ci::fs::path tPath = iDirectory / tName.str();
+					tWriter->push( [tPath, tItem] () { write_to_file<T>( tPath, tItem ); } );
+				}, iThreadCount );
+			}
+			catch( ... ) { tError = std::current_exception(); }
+			// Drain pending writes and join writer (also after a failed step):
+			try { tWriter->stop(); } catch( ... ) { if( ! tError ) tError = std::current_exception(); }
+			// Report first failure:
+			if( tError ) std::rethrow_exception( tError );
+		}
+
 		void cancelRecorder()
 		{
 			for (auto& tDevice : mRecordingDevices) {
@@ -87,11 +217,25 @@ namespace itp { namespace multitrack {
 			mRecordingDevices.clear();
 		}
 		
-		template <typename T> void addRecorder(std::function<T(void)> iRecorderCallbackFn, std::function<void(const T&)> iPlayerCallbackFn)
+		template <typename T> void addRecorder(std::function<T(void)> iRecorderCallbackFn, std::function<void(const T&)> iPlayerCallbackFn, TrackFormat iFormat = TrackFormat::FILE_SEQUENCE)
+		{
+			// First recorder starts a new sensor epoch:
+			if( mRecordingDevices.empty() ) mTimer->getSensorEpoch()->reset();
+			mRecordingDevices.push_back(mSequence->addTrackRecorder<T>( mDirectory, "track_" + std::to_string( mUidGenerator ), iRecorderCallbackFn, iPlayerCallbackFn, iFormat));
+			// Increment uid generator:
+			mUidGenerator++;
+		}
+		
+		/** @brief adds a push-mode recorder, fed from device event handlers through the returned track's push(); pushed tracks of one recording share a sensor epoch */
+		template <typename T> typename TrackT<T>::Ref addPushRecorder(std::function<void(const T&)> iPlayerCallbackFn, TrackFormat iFormat = TrackFormat::FILE_SEQUENCE)
 		{
-			mRecordingDevices.push_back(mSequence->addTrackRecorder<T>( mDirectory, "track_" + std::to_string( mUidGenerator ), iRecorderCallbackFn, iPlayerCallbackFn));
+			// First recorder starts a new sensor epoch:
+			if( mRecordingDevices.empty() ) mTimer->getSensorEpoch()->reset();
+			Track::Ref tTrack = mSequence->addTrackRecorder<T>( mDirectory, "track_" + std::to_string( mUidGenerator ), std::function<T(void)>(), iPlayerCallbackFn, iFormat );
+			mRecordingDevices.push_back( tTrack );
 			// Increment uid generator:
 			mUidGenerator++;
+			return std::static_pointer_cast<TrackT<T>>( tTrack );
 		}
 	};
 	
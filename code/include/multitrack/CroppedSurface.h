@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/Area.h"
+#include "cinder/Rect.h"
+
+#include <Simd.h>
+#include <multitrack/FramePool.h>
+
+namespace itp { namespace multitrack {
+
+	/**
+	 * @brief sub-rect of a mostly transparent frame, e.g. a silhouette
+	 *
+	 * Holds only the pixels inside the bounding rect of non-zero alpha, plus where that rect sits in the
+	 * full frame. Every pixel outside the rect has zero alpha; its color is not kept and expands to zero.
+	 */
+	struct CroppedSurface
+	{
+		ci::SurfaceRef	mSurface;	//!< pixels inside bounds (NULL when frame is fully transparent)
+		ci::ivec2		mOffset;	//!< upper-left corner of bounds in full frame
+		ci::ivec2		mFrameSize;	//!< full frame size
+		std::shared_ptr<std::vector<uint8_t>> mStorage; //!< pixels viewed by mSurface when filled by crop_surface (kept, so a recycled frame crops without allocating)
+
+		/** @brief default constructor */
+		CroppedSurface() :
+			mOffset( 0 ),
+			mFrameSize( 0 )
+		{ /* no-op */ }
+
+		/** @brief returns bounds in full frame */
+		ci::Area getBounds() const
+		{
+			return mSurface ? ci::Area( mOffset.x, mOffset.y, mOffset.x + mSurface->getWidth(), mOffset.y + mSurface->getHeight() ) : ci::Area( 0, 0, 0, 0 );
+		}
+
+		/** @brief returns where to draw sub-rect when full frame is drawn into iFrameRect */
+		ci::Rectf getDrawRect(const ci::Rectf& iFrameRect) const
+		{
+			ci::Area	tBounds	= getBounds();
+			float		tScaleX	= ( mFrameSize.x > 0 ) ? ( iFrameRect.x2 - iFrameRect.x1 ) / (float)mFrameSize.x : 0.0f;
+			float		tScaleY	= ( mFrameSize.y > 0 ) ? ( iFrameRect.y2 - iFrameRect.y1 ) / (float)mFrameSize.y : 0.0f;
+			return ci::Rectf( iFrameRect.x1 + tBounds.x1 * tScaleX, iFrameRect.y1 + tBounds.y1 * tScaleY, iFrameRect.x1 + tBounds.x2 * tScaleX, iFrameRect.y1 + tBounds.y2 * tScaleY );
+		}
+	};
+
+	typedef std::shared_ptr<CroppedSurface> CroppedSurfaceRef;
+
+	/** @brief returns index of first pixel in [iBegin, iEnd) of a 4-byte pixel row with non-zero alpha, or iEnd */
+	inline int32_t find_first_alpha(const uint8_t* iRow, int32_t iBegin, int32_t iEnd, uint8_t iAlphaOffset)
+	{
+		int32_t x = iBegin;
+#if ITP_SIMD_SSE2
+		// Test four pixels per step:
+		const __m128i tMask = _mm_set1_epi32( int32_t( 0xFFu << ( 8 * iAlphaOffset ) ) );
+		const __m128i tZero = _mm_setzero_si128();
+		for( ; x + 4 <= iEnd; x += 4 ) {
+			__m128i	tAlpha	= _mm_and_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( iRow + x * 4 ) ), tMask );
+			int		tEmpty	= _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( tAlpha, tZero ) ) );
+			if( tEmpty != 0xF ) break;
+		}
+#endif
+		for( ; x < iEnd; x++ ) {
+			if( iRow[ x * 4 + iAlphaOffset ] != 0 ) return x;
+		}
+		return iEnd;
+	}
+
+	/** @brief returns index of last pixel in [iBegin, iEnd) of a 4-byte pixel row with non-zero alpha, or iBegin - 1 */
+	inline int32_t find_last_alpha(const uint8_t* iRow, int32_t iBegin, int32_t iEnd, uint8_t iAlphaOffset)
+	{
+		int32_t x = iEnd;
+#if ITP_SIMD_SSE2
+		// Test four pixels per step:
+		const __m128i tMask = _mm_set1_epi32( int32_t( 0xFFu << ( 8 * iAlphaOffset ) ) );
+		const __m128i tZero = _mm_setzero_si128();
+		for( ; x - 4 >= iBegin; x -= 4 ) {
+			__m128i	tAlpha	= _mm_and_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( iRow + ( x - 4 ) * 4 ) ), tMask );
+			int		tEmpty	= _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( tAlpha, tZero ) ) );
+			if( tEmpty != 0xF ) break;
+		}
+#endif
+		for( ; x > iBegin; x-- ) {
+			if( iRow[ ( x - 1 ) * 4 + iAlphaOffset ] != 0 ) return x - 1;
+		}
+		return iBegin - 1;
+	}
+
+	/** @brief returns bounding rect of pixels with non-zero alpha (empty area if there are none; whole surface if it has no alpha) */
+	inline ci::Area find_alpha_bounds(const ci::Surface8u& iSurface)
+	{
+		const int32_t tWidth	= iSurface.getWidth();
+		const int32_t tHeight	= iSurface.getHeight();
+		if( ! iSurface.hasAlpha() || iSurface.getPixelInc() != 4 ) {
+			return ci::Area( 0, 0, tWidth, tHeight );
+		}
+		const uint8_t tAlphaOffset = iSurface.getChannelOrder().getAlphaOffset();
+		int32_t tMinX = tWidth;
+		int32_t tMaxX = -1;
+		int32_t tMinY = tHeight;
+		int32_t tMaxY = -1;
+		for( int32_t y = 0; y < tHeight; y++ ) {
+			const uint8_t* tRow = iSurface.getData( ci::ivec2( 0, y ) );
+			// Skip empty row:
+			int32_t tFirst = find_first_alpha( tRow, 0, tWidth, tAlphaOffset );
+			if( tFirst == tWidth ) continue;
+			// Widen bounds (only pixels outside current bounds need testing):
+			if( tFirst < tMinX ) tMinX = tFirst;
+			int32_t tLast = find_last_alpha( tRow, tMaxX + 1 > tFirst ? tMaxX + 1 : tFirst, tWidth, tAlphaOffset );
+			if( tLast > tMaxX ) tMaxX = tLast;
+			if( tMinY == tHeight ) tMinY = y;
+			tMaxY = y;
+		}
+		if( tMaxY < 0 ) return ci::Area( 0, 0, 0, 0 );
+		return ci::Area( tMinX, tMinY, tMaxX + 1, tMaxY + 1 );
+	}
+
+	/** @brief copies pixels inside alpha bounds of a surface into a cropped frame, reusing its surface or pixel storage when large enough (its previous surface is overwritten) */
+	inline void crop_surface(const ci::Surface8u& iSurface, CroppedSurface& oOutput)
+	{
+		oOutput.mFrameSize	= iSurface.getSize();
+		oOutput.mOffset		= ci::ivec2( 0 );
+		ci::Area tBounds = find_alpha_bounds( iSurface );
+		if( tBounds.getWidth() <= 0 || tBounds.getHeight() <= 0 ) {
+			oOutput.mSurface.reset();
+			return;
+		}
+		ci::ivec2	tSize( tBounds.getWidth(), tBounds.getHeight() );
+		size_t		tRowBytes = size_t( tSize.x ) * iSurface.getPixelInc();
+		oOutput.mOffset = ci::ivec2( tBounds.x1, tBounds.y1 );
+		// Grow storage only when bounds outgrow it:
+		if( ! oOutput.mStorage || oOutput.mStorage->size() < tRowBytes * tSize.y ) {
+			oOutput.mStorage = std::make_shared<std::vector<uint8_t>>( tRowBytes * tSize.y );
+			oOutput.mSurface.reset();
+		}
+		// View storage as surface of bounds size (surface keeps its storage alive):
+		bool tViewsStorage = oOutput.mSurface && oOutput.mSurface->getData() == oOutput.mStorage->data();
+		if( ! tViewsStorage || oOutput.mSurface->getSize() != tSize || oOutput.mSurface->getChannelOrder() != iSurface.getChannelOrder() ) {
+			std::shared_ptr<std::vector<uint8_t>> tStorage = oOutput.mStorage;
+			oOutput.mSurface = ci::SurfaceRef( new ci::Surface8u( tStorage->data(), tSize.x, tSize.y, tRowBytes, iSurface.getChannelOrder() ), [tStorage] ( ci::Surface8u* iView ) { delete iView; } );
+		}
+		// Copy rows of bounds:
+		for( int32_t y = 0; y < tSize.y; y++ ) {
+			std::memcpy( oOutput.mSurface->getData( ci::ivec2( 0, y ) ), iSurface.getData( ci::ivec2( tBounds.x1, tBounds.y1 + y ) ), tRowBytes );
+		}
+	}
+
+	/** @brief copies pixels inside alpha bounds of a surface into a recycled cropped frame (see FramePoolT) */
+	inline CroppedSurfaceRef crop_surface(const ci::Surface8u& iSurface, FramePoolT<CroppedSurfaceRef>& ioPool)
+	{
+		CroppedSurfaceRef tOutput = ioPool.acquire();
+		crop_surface( iSurface, *tOutput );
+		return tOutput;
+	}
+
+	/** @brief copies pixels inside alpha bounds of a surface into a new cropped frame */
+	inline CroppedSurfaceRef crop_surface(const ci::Surface8u& iSurface)
+	{
+		CroppedSurfaceRef tOutput = std::make_shared<CroppedSurface>();
+		crop_surface( iSurface, *tOutput );
+		return tOutput;
+	}
+
+	/** @brief reconstructs full frame from a cropped frame (pixels outside bounds are zero) */
+	inline ci::SurfaceRef expand_surface(const CroppedSurface& iFrame)
+	{
+		bool tAlpha = iFrame.mSurface ? iFrame.mSurface->hasAlpha() : true;
+		ci::SurfaceRef tOutput = iFrame.mSurface
+			? ci::Surface8u::create( iFrame.mFrameSize.x, iFrame.mFrameSize.y, tAlpha, iFrame.mSurface->getChannelOrder() )
+			: ci::Surface8u::create( iFrame.mFrameSize.x, iFrame.mFrameSize.y, tAlpha );
+		size_t tFrameRowBytes = size_t( iFrame.mFrameSize.x ) * tOutput->getPixelInc();
+		for( int32_t y = 0; y < iFrame.mFrameSize.y; y++ ) {
+			std::memset( tOutput->getData( ci::ivec2( 0, y ) ), 0, tFrameRowBytes );
+		}
+		if( iFrame.mSurface ) {
+			size_t tRowBytes = size_t( iFrame.mSurface->getWidth() ) * tOutput->getPixelInc();
+			for( int32_t y = 0; y < iFrame.mSurface->getHeight(); y++ ) {
+				std::memcpy( tOutput->getData( ci::ivec2( iFrame.mOffset.x, iFrame.mOffset.y + y ) ), iFrame.mSurface->getData( ci::ivec2( 0, y ) ), tRowBytes );
+			}
+		}
+		return tOutput;
+	}
+
+} } // namespace itp::multitrack
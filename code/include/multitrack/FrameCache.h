@@ -0,0 +1,155 @@
+#pragma once
+
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+namespace itp { namespace multitrack {
+
+	/** @brief thread-safe LRU cache of decoded frames keyed by frame index, bounded by a byte budget */
+	template <typename T> class FrameCacheT {
+	public:
+
+		typedef std::shared_ptr<FrameCacheT>	Ref;
+
+		static const size_t kDefaultBudget = 256 * 1024 * 1024; //!< default byte budget
+
+	private:
+
+		/** @brief cache entry */
+		struct Entry
+		{
+			size_t	mIndex;	//!< frame index
+			T		mItem;	//!< decoded frame
+			size_t	mBytes;	//!< approximate decoded size (in bytes)
+		};
+
+		typedef std::list<Entry>												EntryList;
+		typedef std::unordered_map<size_t, typename EntryList::iterator>	EntryMap;
+
+		mutable std::mutex	mMutex;		//!< guards all members below
+		EntryList			mEntries;	//!< entries, most recently used first
+		EntryMap			mLookup;	//!< frame index to entry
+		size_t				mBudget;	//!< byte budget
+		size_t				mBytes;		//!< current byte count
+		uint64_t			mHits;		//!< lookup hit count
+		uint64_t			mMisses;	//!< lookup miss count
+		uint64_t			mEvictions;	//!< eviction count
+
+		/** @brief default constructor */
+		FrameCacheT(size_t iBudget = kDefaultBudget) :
+			mBudget( iBudget ),
+			mBytes( 0 ),
+			mHits( 0 ),
+			mMisses( 0 ),
+			mEvictions( 0 )
+		{ /* no-op */ }
+
+		/** @brief evicts least recently used entries until budget is met (expects lock to be held) */
+		void evict()
+		{
+			while( mBytes > mBudget && ! mEntries.empty() ) {
+				mBytes -= mEntries.back().mBytes;
+				mLookup.erase( mEntries.back().mIndex );
+				mEntries.pop_back();
+				mEvictions++;
+			}
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename FrameCacheT::Ref create(Args&& ... args)
+		{
+			return typename FrameCacheT::Ref( new FrameCacheT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief looks up a frame, marking it most recently used; returns false on miss */
+		bool get(size_t iIndex, T& oItem)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			typename EntryMap::iterator tFind = mLookup.find( iIndex );
+			if( tFind == mLookup.end() ) {
+				mMisses++;
+				return false;
+			}
+			mHits++;
+			mEntries.splice( mEntries.begin(), mEntries, tFind->second );
+			oItem = tFind->second->mItem;
+			return true;
+		}
+
+		/** @brief looks up a frame; returns false on miss (does not affect counters or recency) */
+		bool peek(size_t iIndex, T& oItem) const
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			typename EntryMap::const_iterator tFind = mLookup.find( iIndex );
+			if( tFind == mLookup.end() ) return false;
+			oItem = tFind->second->mItem;
+			return true;
+		}
+
+		/** @brief returns true if frame is cached (does not affect counters or recency) */
+		bool contains(size_t iIndex) const
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return ( mLookup.find( iIndex ) != mLookup.end() );
+		}
+
+		/** @brief inserts or replaces a frame, evicting as needed; frames larger than the budget are not kept */
+		void put(size_t iIndex, const T& iItem, size_t iBytes)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			// Replace existing entry:
+			typename EntryMap::iterator tFind = mLookup.find( iIndex );
+			if( tFind != mLookup.end() ) {
+				mBytes -= tFind->second->mBytes;
+				mEntries.erase( tFind->second );
+				mLookup.erase( tFind );
+			}
+			if( iBytes > mBudget ) return;
+			// Insert as most recently used:
+			Entry tEntry = { iIndex, iItem, iBytes };
+			mEntries.push_front( tEntry );
+			mLookup[ iIndex ] = mEntries.begin();
+			mBytes += iBytes;
+			evict();
+		}
+
+		/** @brief removes all frames (counters are kept) */
+		void clear()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mEntries.clear();
+			mLookup.clear();
+			mBytes = 0;
+		}
+
+		/** @brief sets byte budget, evicting as needed */
+		void setBudget(size_t iBudget)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mBudget = iBudget;
+			evict();
+		}
+
+		/** @brief resets hit, miss and eviction counters */
+		void resetCounters()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mHits      = 0;
+			mMisses    = 0;
+			mEvictions = 0;
+		}
+
+		size_t		getBudget() const		{ std::lock_guard<std::mutex> tLock( mMutex ); return mBudget; }
+		size_t		getBytes() const		{ std::lock_guard<std::mutex> tLock( mMutex ); return mBytes; }
+		size_t		size() const			{ std::lock_guard<std::mutex> tLock( mMutex ); return mEntries.size(); }
+		uint64_t	getHitCount() const		{ std::lock_guard<std::mutex> tLock( mMutex ); return mHits; }
+		uint64_t	getMissCount() const	{ std::lock_guard<std::mutex> tLock( mMutex ); return mMisses; }
+		uint64_t	getEvictionCount() const{ std::lock_guard<std::mutex> tLock( mMutex ); return mEvictions; }
+	};
+
+} } // namespace itp::multitrack
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/Channel.h"
+
+namespace itp { namespace multitrack {
+
+	/** @brief returns pool key for a frame of given size and pixel layout (channel count or bytes per pixel) */
+	inline uint64_t get_pool_shape(const ci::ivec2& iSize, uint32_t iChannels = 1)
+	{
+		return ( uint64_t( uint32_t( iSize.x ) ) & 0xFFFFFF ) | ( ( uint64_t( uint32_t( iSize.y ) ) & 0xFFFFFF ) << 24 ) | ( uint64_t( iChannels & 0xFF ) << 48 );
+	}
+
+	/**
+	 * @brief recycling allocator for frame payloads held by shared pointer type T (e.g. ci::SurfaceRef)
+	 *
+	 * Frames handed out by acquire() go back to the pool instead of being deleted once their last reference
+	 * is released (by the background writer, the frame cache or the player callback), and are handed out
+	 * again for requests of the same shape. Contents of a recycled frame are stale; callers overwrite them.
+	 * Frames released after the pool is gone are deleted normally.
+	 */
+	template <typename T> class FramePoolT {
+	public:
+
+		typedef std::shared_ptr<FramePoolT>			Ref;
+		typedef typename T::element_type			Element;
+		typedef std::function<Element*(void)>		CreateFn;
+
+		static const size_t kDefaultCapacity = 8; //!< default maximum number of idle frames kept
+
+	private:
+
+		/** @brief idle frames and counters, shared with the deleters of frames in use */
+		struct State
+		{
+			std::mutex									mMutex;		//!< guards all members below
+			std::vector<std::pair<uint64_t, Element*>>	mFree;		//!< idle frames and their shapes
+			size_t										mCapacity;	//!< maximum number of idle frames
+			size_t										mAllocCount; //!< frames created
+			size_t										mReuseCount; //!< frames handed out again
+
+			State(size_t iCapacity) :
+				mCapacity( iCapacity ),
+				mAllocCount( 0 ),
+				mReuseCount( 0 )
+			{ /* no-op */ }
+
+			~State()
+			{
+				for( auto& tEntry : mFree ) delete tEntry.second;
+			}
+		};
+
+		/** @brief returns released frames to pool, or deletes them if pool is gone or full */
+		struct Recycler
+		{
+			std::weak_ptr<State>	mState;
+			uint64_t				mShape;
+
+			void operator()(Element* iElement) const
+			{
+				std::shared_ptr<State> tState = mState.lock();
+				if( tState ) {
+					std::lock_guard<std::mutex> tLock( tState->mMutex );
+					if( tState->mFree.size() < tState->mCapacity ) {
+						tState->mFree.push_back( std::make_pair( mShape, iElement ) );
+						return;
+					}
+				}
+				delete iElement;
+			}
+		};
+
+		std::shared_ptr<State> mState; //!< pool state
+
+		/** @brief default constructor */
+		FramePoolT(size_t iCapacity = kDefaultCapacity) :
+			mState( std::make_shared<State>( iCapacity ) )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename FramePoolT::Ref create(Args&& ... args)
+		{
+			return typename FramePoolT::Ref( new FramePoolT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns an idle frame of given shape, or one made by iCreateFn if none is idle */
+		T acquire(uint64_t iShape, const CreateFn& iCreateFn)
+		{
+			Element* tElement = NULL;
+			{
+				std::lock_guard<std::mutex> tLock( mState->mMutex );
+				for( size_t i = mState->mFree.size(); i > 0; i-- ) {
+					if( mState->mFree[ i - 1 ].first == iShape ) {
+						tElement = mState->mFree[ i - 1 ].second;
+						mState->mFree.erase( mState->mFree.begin() + ( i - 1 ) );
+						mState->mReuseCount++;
+						break;
+					}
+				}
+				if( ! tElement ) mState->mAllocCount++;
+			}
+			if( ! tElement ) tElement = iCreateFn();
+			Recycler tRecycler;
+			tRecycler.mState = mState;
+			tRecycler.mShape = iShape;
+			return T( tElement, tRecycler );
+		}
+
+		/** @brief returns an idle or default-constructed frame (for fixed-size types such as PointCloud) */
+		T acquire()
+		{
+			return acquire( 0, [] () { return new Element(); } );
+		}
+
+		/** @brief sets maximum number of idle frames kept (excess frames are deleted) */
+		void setCapacity(size_t iCapacity)
+		{
+			std::lock_guard<std::mutex> tLock( mState->mMutex );
+			mState->mCapacity = iCapacity;
+			while( mState->mFree.size() > iCapacity ) {
+				delete mState->mFree.back().second;
+				mState->mFree.pop_back();
+			}
+		}
+
+		/** @brief deletes all idle frames */
+		void clear()
+		{
+			std::lock_guard<std::mutex> tLock( mState->mMutex );
+			for( auto& tEntry : mState->mFree ) delete tEntry.second;
+			mState->mFree.clear();
+		}
+
+		/** @brief returns number of frames created by pool */
+		size_t getAllocCount() const
+		{
+			std::lock_guard<std::mutex> tLock( mState->mMutex );
+			return mState->mAllocCount;
+		}
+
+		/** @brief returns number of recycled frames handed out */
+		size_t getReuseCount() const
+		{
+			std::lock_guard<std::mutex> tLock( mState->mMutex );
+			return mState->mReuseCount;
+		}
+
+		/** @brief returns number of idle frames */
+		size_t getFreeCount() const
+		{
+			std::lock_guard<std::mutex> tLock( mState->mMutex );
+			return mState->mFree.size();
+		}
+	};
+
+	/** @brief returns a pooled 8-bit surface of given size */
+	inline ci::SurfaceRef acquire_surface(FramePoolT<ci::SurfaceRef>& iPool, const ci::ivec2& iSize, bool iAlpha = true)
+	{
+		return iPool.acquire( get_pool_shape( iSize, iAlpha ? 4 : 3 ), [iSize, iAlpha] () { return new ci::Surface8u( iSize.x, iSize.y, iAlpha ); } );
+	}
+
+	/** @brief returns a pooled channel of given size */
+	template<typename V> inline std::shared_ptr<ci::ChannelT<V>> acquire_channel(FramePoolT<std::shared_ptr<ci::ChannelT<V>>>& iPool, const ci::ivec2& iSize)
+	{
+		return iPool.acquire( get_pool_shape( iSize, sizeof( V ) ), [iSize] () { return new ci::ChannelT<V>( iSize.x, iSize.y ); } );
+	}
+
+} } // namespace itp::multitrack
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include <multitrack/FrameCache.h>
+
+namespace itp { namespace multitrack {
+
+	/**
+	 * @brief decodes frames ahead of the playhead on a worker thread, into a shared frame cache
+	 *
+	 * Frames of the current prefetch window are also held in handoff slots outside of the cache budget, so a
+	 * small (or zero) budget cannot evict frames before the playhead reaches them.
+	 */
+	template <typename T> class FramePrefetcherT {
+	public:
+
+		typedef std::shared_ptr<FramePrefetcherT>	Ref;
+
+		typedef std::function<T(size_t)>			DecodeFn;	//!< decodes frame at index
+		typedef std::function<size_t(const T&)>		SizeFn;		//!< returns decoded frame size (in bytes)
+
+		static const size_t kDefaultDepth = 8; //!< default number of frames decoded ahead of the playhead
+
+	private:
+
+		typename FrameCacheT<T>::Ref	mCache;			//!< destination cache
+		DecodeFn						mDecodeFn;		//!< frame decoder
+		SizeFn							mSizeFn;		//!< frame sizer
+		size_t							mFrameCount;	//!< number of frames in track
+		size_t							mDepth;			//!< number of frames decoded ahead of target
+
+		std::thread						mThread;		//!< worker thread
+		std::mutex						mMutex;			//!< guards all members below
+		std::condition_variable			mCond;			//!< signalled on new target or stop
+		bool							mRunning;		//!< activity flag
+		size_t							mTarget;		//!< frame the playhead is on
+		int								mDirection;		//!< playback direction (+1 or -1)
+		uint64_t						mGeneration;	//!< incremented on every new target
+		std::map<size_t, T>				mSlots;			//!< handoff slots: decoded frames of current window
+		uint64_t						mReadyCount;	//!< frames that were ready when requested
+		uint64_t						mUnderrunCount;	//!< frames that were not ready when requested
+		uint64_t						mDecodeCount;	//!< frames decoded by worker
+		std::exception_ptr				mError;			//!< first decode error
+
+		/** @brief default constructor */
+		FramePrefetcherT(typename FrameCacheT<T>::Ref iCache, DecodeFn iDecodeFn, SizeFn iSizeFn, size_t iFrameCount, size_t iDepth = kDefaultDepth) :
+			mCache( iCache ),
+			mDecodeFn( iDecodeFn ),
+			mSizeFn( iSizeFn ),
+			mFrameCount( iFrameCount ),
+			mDepth( iDepth ),
+			mRunning( true ),
+			mTarget( 0 ),
+			mDirection( 1 ),
+			mGeneration( 0 ),
+			mReadyCount( 0 ),
+			mUnderrunCount( 0 ),
+			mDecodeCount( 0 )
+		{
+			mThread = std::thread( &FramePrefetcherT::run, this );
+		}
+
+		/** @brief worker thread loop */
+		void run()
+		{
+			std::unique_lock<std::mutex> tLock( mMutex );
+			uint64_t tGeneration = mGeneration;
+			bool tPending = true; // prefetch from initial target
+			while( true ) {
+				// Wait for a new target:
+				mCond.wait( tLock, [&] { return ! mRunning || tPending || mGeneration != tGeneration; } );
+				if( ! mRunning ) return;
+				tPending    = false;
+				tGeneration = mGeneration;
+				size_t	tTarget		= mTarget;
+				int		tDirection	= mDirection;
+				// Decode target and the frames after it, in playback direction:
+				for( size_t k = 0; k <= mDepth; k++ ) {
+					// Restart when target moves:
+					if( ! mRunning || mGeneration != tGeneration ) break;
+					// Stop at track bounds:
+					if( tDirection < 0 && k > tTarget ) break;
+					size_t tIndex = ( tDirection < 0 ) ? ( tTarget - k ) : ( tTarget + k );
+					if( tIndex >= mFrameCount ) break;
+					if( mSlots.find( tIndex ) != mSlots.end() ) continue;
+					// Decode outside of lock (or take frame from cache):
+					tLock.unlock();
+					bool				tDecoded = false;
+					std::exception_ptr	tError;
+					T					tItem;
+					if( ! mCache->peek( tIndex, tItem ) ) {
+						try {
+							tItem = mDecodeFn( tIndex );
+							mCache->put( tIndex, tItem, mSizeFn( tItem ) );
+							tDecoded = true;
+						}
+						catch( ... ) {
+							tError = std::current_exception();
+						}
+					}
+					tLock.lock();
+					// Hand off frame unless it left the window meanwhile:
+					if( tItem && in_window( tIndex ) ) mSlots[ tIndex ] = tItem;
+					if( tDecoded ) mDecodeCount++;
+					if( tError && ! mError ) mError = tError;
+				}
+			}
+		}
+
+		/** @brief returns true if frame is within prefetch window of current target (expects lock to be held) */
+		bool in_window(size_t iIndex) const
+		{
+			return ( mDirection < 0 ) ? ( iIndex <= mTarget && mTarget - iIndex <= mDepth ) : ( iIndex >= mTarget && iIndex - mTarget <= mDepth );
+		}
+
+	public:
+
+		/** @brief destructor */
+		~FramePrefetcherT()
+		{
+			stop();
+		}
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename FramePrefetcherT::Ref create(Args&& ... args)
+		{
+			return typename FramePrefetcherT::Ref( new FramePrefetcherT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief moves prefetch target to a frame and playback direction (+1 forward, -1 reverse) */
+		void request(size_t iIndex, int iDirection = 1)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			iDirection = ( iDirection < 0 ) ? -1 : 1;
+			if( iIndex == mTarget && iDirection == mDirection ) return;
+			mTarget    = iIndex;
+			mDirection = iDirection;
+			mGeneration++;
+			// Release handoff slots that left the window:
+			for( typename std::map<size_t, T>::iterator it = mSlots.begin(); it != mSlots.end(); ) {
+				if( in_window( it->first ) ) ++it;
+				else it = mSlots.erase( it );
+			}
+			mCond.notify_one();
+		}
+
+		/** @brief takes a frame if it is ready, counting an underrun otherwise; rethrows any decode error */
+		bool acquire(size_t iIndex, T& oItem)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			// Take frame from handoff slots, then from cache:
+			typename std::map<size_t, T>::const_iterator tSlot = mSlots.find( iIndex );
+			bool tReady = ( tSlot != mSlots.end() );
+			if( tReady ) oItem = tSlot->second;
+			else tReady = mCache->get( iIndex, oItem );
+			if( mError ) {
+				std::exception_ptr tError = mError;
+				mError = std::exception_ptr();
+				std::rethrow_exception( tError );
+			}
+			if( tReady ) mReadyCount++;
+			else mUnderrunCount++;
+			return tReady;
+		}
+
+		/** @brief stops and joins worker thread */
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				mRunning = false;
+				mCond.notify_all();
+			}
+			if( mThread.joinable() ) {
+				mThread.join();
+			}
+			mSlots.clear();
+		}
+
+		/** @brief resets ready, underrun and decode counters */
+		void resetCounters()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mReadyCount    = 0;
+			mUnderrunCount = 0;
+			mDecodeCount   = 0;
+		}
+
+		size_t		getDepth() const	{ return mDepth; }
+		uint64_t	getReadyCount()		{ std::lock_guard<std::mutex> tLock( mMutex ); return mReadyCount; }
+		uint64_t	getUnderrunCount()	{ std::lock_guard<std::mutex> tLock( mMutex ); return mUnderrunCount; }
+		uint64_t	getDecodeCount()	{ std::lock_guard<std::mutex> tLock( mMutex ); return mDecodeCount; }
+	};
+
+} } // namespace itp::multitrack
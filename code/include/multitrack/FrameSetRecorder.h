@@ -0,0 +1,135 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <multitrack/TypeTrack.h>
+
+namespace itp { namespace multitrack {
+
+	/**
+	 * @brief records one set of frames across several push-mode tracks as a unit
+	 *
+	 * Each track takes its frame from the set through a selector, called once per set. A set is recorded only
+	 * if every selector yields a frame and every track accepts the set's sensor timestamp, and all tracks
+	 * receive it under one lock with that timestamp, so the tracks keep exactly one entry per set and stay
+	 * aligned entry for entry.
+	 */
+	template <typename SetT> class FrameSetRecorderT {
+	public:
+
+		typedef std::shared_ptr<FrameSetRecorderT> Ref;
+
+	private:
+
+		typedef std::function<bool(long long)>		PushFn;		//!< pushes a selected frame to its track; returns false if track refused it
+		typedef std::function<PushFn(const SetT&)>	SelectFn;	//!< selects track's frame from set, bound to its push (empty if set lacks the frame)
+		typedef std::function<bool(long long)>		AcceptFn;	//!< returns true if track would record a frame at timestamp
+
+		std::mutex				mMutex;			//!< serializes set pushes
+		std::vector<SelectFn>	mSelectFns;		//!< per-track frame selectors
+		std::vector<AcceptFn>	mAcceptFns;		//!< per-track timestamp checks
+		std::vector<PushFn>		mPushFns;		//!< frames selected from current set (storage kept between sets)
+		size_t					mSetCount;		//!< number of recorded sets
+		size_t					mRejectCount;	//!< number of incomplete sets
+		size_t					mRefuseCount;	//!< number of sets refused by a track
+
+		/** @brief default constructor */
+		FrameSetRecorderT() :
+			mSetCount( 0 ),
+			mRejectCount( 0 ),
+			mRefuseCount( 0 )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename FrameSetRecorderT::Ref create(Args&& ... args)
+		{
+			return typename FrameSetRecorderT::Ref( new FrameSetRecorderT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief adds a push-mode track fed with the frame selected from each set */
+		template <typename T> void addTrack(typename TrackT<T>::Ref iTrack, std::function<T(const SetT&)> iSelectFn)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mSelectFns.push_back( [iTrack, iSelectFn] ( const SetT& iSet ) -> PushFn {
+				T tFrame = iSelectFn( iSet );
+				if( ! tFrame ) return PushFn();
+				return [iTrack, tFrame] ( long long iTimeStamp ) { return iTrack->push( tFrame, iTimeStamp ); };
+			} );
+			mAcceptFns.push_back( [iTrack] ( long long iTimeStamp ) { return iTrack->accepts( iTimeStamp ); } );
+		}
+
+		/** @brief removes all tracks */
+		void clear()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mSelectFns.clear();
+			mAcceptFns.clear();
+			mPushFns.clear();
+		}
+
+		/** @brief records set on all tracks at given sensor timestamp (in 100ns ticks); returns false if set is incomplete or refused by a track */
+		bool push(const SetT& iSet, long long iTimeStamp)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			if( mSelectFns.empty() ) return false;
+			// Select every track's frame once:
+			mPushFns.clear();
+			for( const auto& tSelectFn : mSelectFns ) {
+				PushFn tPushFn = tSelectFn( iSet );
+				if( ! tPushFn ) {
+					mPushFns.clear();
+					mRejectCount++;
+					return false;
+				}
+				mPushFns.push_back( std::move( tPushFn ) );
+			}
+			// Check that every track takes the set before recording any of it:
+			for( const auto& tAcceptFn : mAcceptFns ) {
+				if( ! tAcceptFn( iTimeStamp ) ) {
+					mPushFns.clear();
+					mRefuseCount++;
+					return false;
+				}
+			}
+			// Push selected frames (a track fed from elsewhere may still refuse, leaving the set partially recorded):
+			bool tRecorded = true;
+			for( const auto& tPushFn : mPushFns ) {
+				tRecorded = tPushFn( iTimeStamp ) && tRecorded;
+			}
+			mPushFns.clear();
+			if( ! tRecorded ) {
+				mRefuseCount++;
+				return false;
+			}
+			mSetCount++;
+			return true;
+		}
+
+		/** @brief returns number of recorded sets */
+		size_t getSetCount()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mSetCount;
+		}
+
+		/** @brief returns number of sets rejected as incomplete */
+		size_t getRejectCount()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mRejectCount;
+		}
+
+		/** @brief returns number of sets refused by a track (not recording, or timestamp not newer than its latest frame) */
+		size_t getRefuseCount()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mRefuseCount;
+		}
+	};
+
+} } // namespace itp::multitrack
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "cinder/Filesystem.h"
+
+#if defined( _WIN32 )
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace itp { namespace multitrack {
+
+	/** @brief read-only memory-mapped file (frames viewed in place are only handed out as const views) */
+	class MappedFile {
+	public:
+
+		typedef std::shared_ptr<MappedFile>			Ref;
+		typedef std::shared_ptr<const MappedFile>	ConstRef;
+
+	private:
+
+		ci::fs::path	mPath;		//!< mapped path
+		const uint8_t*	mData;		//!< start of mapping
+		uint64_t		mSize;		//!< mapping size (in bytes)
+#if defined( _WIN32 )
+		HANDLE			mFile;		//!< file handle
+		HANDLE			mMapping;	//!< file-mapping handle
+#endif
+
+		/** @brief default constructor */
+		MappedFile(const ci::fs::path& iPath) :
+			mPath( iPath ),
+			mData( NULL ),
+			mSize( 0 )
+#if defined( _WIN32 )
+			, mFile( INVALID_HANDLE_VALUE ),
+			mMapping( NULL )
+#endif
+		{
+#if defined( _WIN32 )
+			// Open file:
+			mFile = ::CreateFileW( mPath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL );
+			if( mFile == INVALID_HANDLE_VALUE ) {
+				throw std::runtime_error( "MappedFile could not open file: \'" + mPath.string() + "\'" );
+			}
+			// Get size:
+			LARGE_INTEGER tSize;
+			if( ! ::GetFileSizeEx( mFile, &tSize ) ) {
+				close();
+				throw std::runtime_error( "MappedFile could not read size of file: \'" + mPath.string() + "\'" );
+			}
+			mSize = static_cast<uint64_t>( tSize.QuadPart );
+			if( mSize == 0 ) return;
+			// Map file:
+			mMapping = ::CreateFileMappingW( mFile, NULL, PAGE_READONLY, 0, 0, NULL );
+			if( mMapping != NULL ) {
+				mData = static_cast<const uint8_t*>( ::MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 ) );
+			}
+#else
+			// Open file:
+			int tFile = ::open( mPath.string().c_str(), O_RDONLY );
+			if( tFile < 0 ) {
+				throw std::runtime_error( "MappedFile could not open file: \'" + mPath.string() + "\'" );
+			}
+			// Get size:
+			struct stat tStat;
+			if( ::fstat( tFile, &tStat ) != 0 ) {
+				::close( tFile );
+				throw std::runtime_error( "MappedFile could not read size of file: \'" + mPath.string() + "\'" );
+			}
+			mSize = static_cast<uint64_t>( tStat.st_size );
+			if( mSize == 0 ) {
+				::close( tFile );
+				return;
+			}
+			// Map file (mapping stays valid after descriptor is closed):
+			void* tData = ::mmap( NULL, static_cast<size_t>( mSize ), PROT_READ, MAP_SHARED, tFile, 0 );
+			::close( tFile );
+			if( tData != MAP_FAILED ) {
+				mData = static_cast<const uint8_t*>( tData );
+			}
+#endif
+			// Handle mapping error:
+			if( mData == NULL ) {
+				close();
+				throw std::runtime_error( "MappedFile could not map file: \'" + mPath.string() + "\'" );
+			}
+		}
+
+		/** @brief releases mapping and handles */
+		void close()
+		{
+#if defined( _WIN32 )
+			if( mData ) ::UnmapViewOfFile( mData );
+			if( mMapping ) ::CloseHandle( mMapping );
+			if( mFile != INVALID_HANDLE_VALUE ) ::CloseHandle( mFile );
+			mMapping = NULL;
+			mFile    = INVALID_HANDLE_VALUE;
+#else
+			if( mData ) ::munmap( const_cast<uint8_t*>( mData ), static_cast<size_t>( mSize ) );
+#endif
+			mData = NULL;
+			mSize = 0;
+		}
+
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+	public:
+
+		/** @brief destructor */
+		~MappedFile()
+		{
+			close();
+		}
+
+		/** @brief static creational method */
+		template <typename ... Args> static MappedFile::Ref create(Args&& ... args)
+		{
+			return MappedFile::Ref( new MappedFile( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns start of mapping (NULL for empty files) */
+		const uint8_t* getData() const
+		{
+			return mData;
+		}
+
+		/** @brief returns mapping size (in bytes) */
+		uint64_t getSize() const
+		{
+			return mSize;
+		}
+
+		/** @brief returns mapped path */
+		const ci::fs::path& getPath() const
+		{
+			return mPath;
+		}
+	};
+
+} } // namespace itp::multitrack
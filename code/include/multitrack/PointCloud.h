@@ -0,0 +1,294 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "cinder/Vector.h"
+
+#if defined( ITP_MULTITRACK_HEADLESS )
+	#include <SyntheticKinect.h>
+#else
+	#include "Kinect2.h"
+#endif
+
+namespace itp { namespace multitrack {
+
+	typedef std::shared_ptr<struct PointCloud> PointCloudRef;
+
+	/**
+	 * @brief fixed-capacity joint cloud stored as a structure of arrays
+	 *
+	 * Points are packed in [0, size()): x and y coordinates live in separate contiguous arrays,
+	 * alongside per-point tracking state, joint type and body slot. A cloud holds at most
+	 * kMaxBodies bodies of kJointCount joints and never allocates, so it can be refilled every frame.
+	 */
+	struct PointCloud
+	{
+		static const size_t kMaxBodies	= 6;						//!< bodies tracked by sensor
+		static const size_t kJointCount	= 25;						//!< joints per body
+		static const size_t kCapacity	= kMaxBodies * kJointCount;	//!< maximum point count
+
+		float		mX[ kCapacity ];		//!< point x coordinates
+		float		mY[ kCapacity ];		//!< point y coordinates
+		uint8_t		mState[ kCapacity ];	//!< point tracking state (TrackingState)
+		uint8_t		mJoint[ kCapacity ];	//!< point joint type (JointType)
+		uint8_t		mBody[ kCapacity ];		//!< point body slot, in [0, kMaxBodies)
+		uint64_t	mBodyId[ kMaxBodies ];	//!< tracking id of body in each slot (0 when empty)
+		size_t		mCount;					//!< point count
+
+		/** @brief default constructor */
+		PointCloud() :
+			mCount( 0 )
+		{
+			std::memset( mBodyId, 0, sizeof( mBodyId ) );
+		}
+
+		/** @brief constructs from the tracked bodies in a body frame (Kinect2 or synthetic device) */
+		template <typename BodyFrameT, typename DeviceRefT> PointCloud(const BodyFrameT& frame, const DeviceRefT& device, bool includeAll = true) :
+			mCount( 0 )
+		{
+			set( frame, device, includeAll );
+		}
+
+		/** @brief refills from the tracked bodies in a body frame (no allocation) */
+		template <typename BodyFrameT, typename DeviceRefT> void set(const BodyFrameT& frame, const DeviceRefT& device, bool includeAll = true)
+		{
+			clear();
+			for (const auto& body : frame.getBodies()) {
+				if (body.isTracked()) {
+					uint8_t tSlot = body.getIndex();
+					if (tSlot >= kMaxBodies) continue;
+					mBodyId[ tSlot ] = body.getId();
+					for (const auto& joint : body.getJointMap()) {
+						TrackingState tState = joint.second.getTrackingState();
+						if (includeAll || tState == TrackingState::TrackingState_Tracked) {
+							push_back( device->mapCameraToDepth( joint.second.getPosition() ), static_cast<uint8_t>( tState ), static_cast<uint8_t>( joint.first ), tSlot );
+						}
+					}
+				}
+			}
+		}
+
+		/** @brief removes all points and body ids */
+		void clear()
+		{
+			mCount = 0;
+			std::memset( mBodyId, 0, sizeof( mBodyId ) );
+		}
+
+		/** @brief appends a point; returns false when cloud is full */
+		bool push_back(const ci::vec2& iPoint, uint8_t iState = TrackingState::TrackingState_Tracked, uint8_t iJoint = 0, uint8_t iBody = 0)
+		{
+			if (mCount >= kCapacity) return false;
+			mX[ mCount ]		= iPoint.x;
+			mY[ mCount ]		= iPoint.y;
+			mState[ mCount ]	= iState;
+			mJoint[ mCount ]	= iJoint;
+			mBody[ mCount ]		= iBody;
+			mCount++;
+			return true;
+		}
+
+		/** @brief returns point at index */
+		ci::vec2 getPoint(size_t iIndex) const
+		{
+			return ci::vec2( mX[ iIndex ], mY[ iIndex ] );
+		}
+
+		/** @brief returns number of points belonging to a body slot */
+		size_t getBodyPointCount(uint8_t iBody) const
+		{
+			size_t tCount = 0;
+			for (size_t i = 0; i < mCount; i++) {
+				if (mBody[ i ] == iBody) tCount++;
+			}
+			return tCount;
+		}
+
+		/** @brief returns number of distinct bodies in cloud */
+		size_t getBodyCount() const
+		{
+			bool tSeen[ kMaxBodies ] = { false };
+			size_t tCount = 0;
+			for (size_t i = 0; i < mCount; i++) {
+				if (mBody[ i ] < kMaxBodies && !tSeen[ mBody[ i ] ]) {
+					tSeen[ mBody[ i ] ] = true;
+					tCount++;
+				}
+			}
+			return tCount;
+		}
+
+		/** @brief copies points into a caller-owned container of ci::vec2 (cleared first, reusing its storage) */
+		template <typename C> void copyPoints(C& oPoints) const
+		{
+			oPoints.clear();
+			for (size_t i = 0; i < mCount; i++) {
+				oPoints.push_back( ci::vec2( mX[ i ], mY[ i ] ) );
+			}
+		}
+
+		size_t	size() const	{ return mCount; }
+		bool	empty() const	{ return mCount == 0; }
+		bool	full() const	{ return mCount == kCapacity; }
+	};
+
+	typedef std::shared_ptr<const struct PointCloudView> PointCloudViewRef;
+
+	/**
+	 * @brief read-only point cloud backed by storage it does not own (e.g. a mapped track payload)
+	 *
+	 * Arrays hold size() points laid out as in PointCloud; they stay valid as long as the view holds its owner.
+	 */
+	struct PointCloudView
+	{
+		const float*				mX;			//!< point x coordinates
+		const float*				mY;			//!< point y coordinates
+		const uint8_t*				mState;		//!< point tracking state (TrackingState)
+		const uint8_t*				mJoint;		//!< point joint type (JointType)
+		const uint8_t*				mBody;		//!< point body slot, in [0, kMaxBodies)
+		const uint64_t*				mBodyId;	//!< tracking id of body in each slot (PointCloud::kMaxBodies entries)
+		size_t						mCount;		//!< point count
+		std::shared_ptr<const void>	mOwner;		//!< keeps storage alive
+
+		/** @brief default constructor (empty view) */
+		PointCloudView() :
+			mX( NULL ),
+			mY( NULL ),
+			mState( NULL ),
+			mJoint( NULL ),
+			mBody( NULL ),
+			mBodyId( NULL ),
+			mCount( 0 )
+		{ /* no-op */ }
+
+		/** @brief constructs view of a cloud, sharing its ownership */
+		explicit PointCloudView(const std::shared_ptr<const PointCloud>& iCloud) :
+			mX( iCloud->mX ),
+			mY( iCloud->mY ),
+			mState( iCloud->mState ),
+			mJoint( iCloud->mJoint ),
+			mBody( iCloud->mBody ),
+			mBodyId( iCloud->mBodyId ),
+			mCount( iCloud->mCount ),
+			mOwner( iCloud )
+		{ /* no-op */ }
+
+		/** @brief returns point at index */
+		ci::vec2 getPoint(size_t iIndex) const
+		{
+			return ci::vec2( mX[ iIndex ], mY[ iIndex ] );
+		}
+
+		/** @brief copies points into a caller-owned container of ci::vec2 (cleared first, reusing its storage) */
+		template <typename C> void copyPoints(C& oPoints) const
+		{
+			oPoints.clear();
+			for (size_t i = 0; i < mCount; i++) {
+				oPoints.push_back( ci::vec2( mX[ i ], mY[ i ] ) );
+			}
+		}
+
+		/** @brief copies view into a cloud (no allocation) */
+		void get(PointCloud& oCloud) const
+		{
+			std::memcpy( oCloud.mX, mX, mCount * sizeof( float ) );
+			std::memcpy( oCloud.mY, mY, mCount * sizeof( float ) );
+			std::memcpy( oCloud.mState, mState, mCount );
+			std::memcpy( oCloud.mJoint, mJoint, mCount );
+			std::memcpy( oCloud.mBody, mBody, mCount );
+			std::memcpy( oCloud.mBodyId, mBodyId, sizeof( oCloud.mBodyId ) );
+			oCloud.mCount = mCount;
+		}
+
+		size_t	size() const	{ return mCount; }
+		bool	empty() const	{ return mCount == 0; }
+	};
+
+	static const float kDefaultPointCloudScale = 32.0f; //!< default fixed-point steps per pixel of quantized clouds (range of +/-1023 pixels)
+
+	/**
+	 * @brief point cloud with coordinates quantized to 16-bit fixed point
+	 *
+	 * Values hold the x coordinates, then the y coordinates, then a tag per point, each as size() 16-bit values.
+	 * A coordinate is stored as round( c * scale ) in two's complement, so the error is at most half a step;
+	 * a tag packs the tracking state (bits 0-1), body slot (bits 2-4) and joint type (bits 5-9). Keeping all
+	 * per-point data in one array lets consecutive frames be delta coded as a single run of values.
+	 */
+	struct QuantizedPointCloud
+	{
+		static const uint16_t kStateBits	= 2;	//!< tag bits holding tracking state
+		static const uint16_t kBodyBits		= 3;	//!< tag bits holding body slot
+		static const uint16_t kJointBits	= 5;	//!< tag bits holding joint type
+
+		float					mScale;					//!< fixed-point steps per pixel
+		size_t					mCount;					//!< point count
+		uint64_t				mBodyId[ PointCloud::kMaxBodies ]; //!< tracking id of body in each slot
+		std::vector<uint16_t>	mValues;				//!< x, y and tag arrays
+
+		/** @brief default constructor */
+		QuantizedPointCloud() :
+			mScale( kDefaultPointCloudScale ),
+			mCount( 0 )
+		{
+			std::memset( mBodyId, 0, sizeof( mBodyId ) );
+		}
+
+		/** @brief quantizes a cloud at given scale; returns false (leaving contents unspecified) if a coordinate or tag does not fit */
+		bool set(const PointCloud& iCloud, float iScale)
+		{
+			mScale	= iScale;
+			mCount	= iCloud.size();
+			std::memcpy( mBodyId, iCloud.mBodyId, sizeof( mBodyId ) );
+			mValues.resize( mCount * 3 );
+			uint16_t* tX	= getX();
+			uint16_t* tY	= getY();
+			uint16_t* tTag	= getTags();
+			for( size_t i = 0; i < mCount; i++ ) {
+				if( ! quantize( iCloud.mX[ i ], iScale, tX[ i ] ) || ! quantize( iCloud.mY[ i ], iScale, tY[ i ] ) ) return false;
+				if( iCloud.mState[ i ] >> kStateBits || iCloud.mBody[ i ] >> kBodyBits || iCloud.mJoint[ i ] >> kJointBits ) return false;
+				tTag[ i ] = static_cast<uint16_t>( iCloud.mState[ i ] | ( iCloud.mBody[ i ] << kStateBits ) | ( iCloud.mJoint[ i ] << ( kStateBits + kBodyBits ) ) );
+			}
+			return true;
+		}
+
+		/** @brief expands into a cloud (no allocation) */
+		void get(PointCloud& oCloud) const
+		{
+			const uint16_t* tX		= getX();
+			const uint16_t* tY		= getY();
+			const uint16_t* tTag	= getTags();
+			const float		tStep	= 1.0f / mScale;
+			for( size_t i = 0; i < mCount; i++ ) {
+				oCloud.mX[ i ]		= static_cast<int16_t>( tX[ i ] ) * tStep;
+				oCloud.mY[ i ]		= static_cast<int16_t>( tY[ i ] ) * tStep;
+				oCloud.mState[ i ]	= static_cast<uint8_t>( tTag[ i ] & ( ( 1 << kStateBits ) - 1 ) );
+				oCloud.mBody[ i ]	= static_cast<uint8_t>( ( tTag[ i ] >> kStateBits ) & ( ( 1 << kBodyBits ) - 1 ) );
+				oCloud.mJoint[ i ]	= static_cast<uint8_t>( tTag[ i ] >> ( kStateBits + kBodyBits ) );
+			}
+			std::memcpy( oCloud.mBodyId, mBodyId, sizeof( mBodyId ) );
+			oCloud.mCount = mCount;
+		}
+
+		/** @brief quantizes a coordinate; returns false if it is not finite or out of range */
+		static bool quantize(float iValue, float iScale, uint16_t& oValue)
+		{
+			float tValue = std::floor( iValue * iScale + 0.5f );
+			if( !( tValue >= -32768.0f && tValue <= 32767.0f ) ) return false;
+			oValue = static_cast<uint16_t>( static_cast<int32_t>( tValue ) );
+			return true;
+		}
+
+		uint16_t*		getX()				{ return mValues.empty() ? NULL : &mValues[ 0 ]; }
+		uint16_t*		getY()				{ return getX() + mCount; }
+		uint16_t*		getTags()			{ return getX() + mCount * 2; }
+		const uint16_t*	getX() const		{ return mValues.empty() ? NULL : &mValues[ 0 ]; }
+		const uint16_t*	getY() const		{ return getX() + mCount; }
+		const uint16_t*	getTags() const		{ return getX() + mCount * 2; }
+		size_t			size() const		{ return mCount; }
+	};
+
+} } // namespace itp::multitrack
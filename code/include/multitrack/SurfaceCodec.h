@@ -0,0 +1,360 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Timer.h"
+#include "cinder/Utilities.h"
+
+#include <Simd.h>
+
+namespace itp { namespace multitrack {
+
+	/** @brief encodings for surface track frames */
+	enum SurfaceCodec
+	{
+		SURFACE_CODEC_PNG,	//!< PNG through ci::writeImage (zlib; slow to encode)
+		SURFACE_CODEC_QOI	//!< QOI ("Quite OK Image" format; lossless, single pass)
+	};
+
+	/**
+	 * @brief codec used to write surface frames
+	 *
+	 * Readers detect the encoding of each payload, so tracks written with either codec play back.
+	 * Define ITP_MULTITRACK_SURFACE_PNG to keep writing PNG frames.
+	 */
+	struct SurfaceCodecTraits
+	{
+#if defined( ITP_MULTITRACK_SURFACE_PNG )
+		static const SurfaceCodec kCodec = SURFACE_CODEC_PNG;
+#else
+		static const SurfaceCodec kCodec = SURFACE_CODEC_QOI;
+#endif
+
+		/** @brief returns file extension of given codec */
+		static std::string getFileExtension(SurfaceCodec iCodec = kCodec)
+		{
+			return ( iCodec == SURFACE_CODEC_QOI ) ? "qoi" : "png";
+		}
+	};
+
+	/*
+	 * QOI encoding (see qoiformat.org; big-endian header):
+	 *
+	 *   char     magic "qoif"
+	 *   uint32_t width
+	 *   uint32_t height
+	 *   uint8_t  channels (3 = RGB, 4 = RGBA)
+	 *   uint8_t  colorspace (0 = sRGB with linear alpha)
+	 *   chunks   (index, diff, luma, run, rgb or rgba operations)
+	 *   uint8_t  end marker { 0, 0, 0, 0, 0, 0, 0, 1 }
+	 */
+
+	static const uint8_t	kQoiOpIndex		= 0x00; //!< 00xxxxxx: pixel from recent-color index
+	static const uint8_t	kQoiOpDiff		= 0x40; //!< 01rrggbb: small difference to previous pixel
+	static const uint8_t	kQoiOpLuma		= 0x80; //!< 10gggggg rrrrbbbb: green-relative difference
+	static const uint8_t	kQoiOpRun		= 0xC0; //!< 11xxxxxx: repeat previous pixel 1 to 62 times
+	static const uint8_t	kQoiOpRgb		= 0xFE; //!< rgb follows
+	static const uint8_t	kQoiOpRgba		= 0xFF; //!< rgba follows
+	static const uint8_t	kQoiMask		= 0xC0; //!< two-bit operation mask
+	static const size_t		kQoiHeaderSize	= 14;
+	static const size_t		kQoiPaddingSize	= 8;
+	static const uint32_t	kQoiMaxPixels	= 400000000; //!< decoder limit, as in the reference implementation
+
+	/** @brief QOI payload header */
+	struct QoiHeader
+	{
+		uint32_t	mWidth;		//!< width (in pixels)
+		uint32_t	mHeight;	//!< height (in pixels)
+		uint8_t		mChannels;	//!< 3 or 4
+	};
+
+	/** @brief packs a pixel as r | g << 8 | b << 16 | a << 24 */
+	inline uint32_t qoi_pack(uint32_t iR, uint32_t iG, uint32_t iB, uint32_t iA)
+	{
+		return iR | ( iG << 8 ) | ( iB << 16 ) | ( iA << 24 );
+	}
+
+	/** @brief returns recent-color index slot of a packed pixel */
+	inline uint32_t qoi_hash(uint32_t iPixel)
+	{
+		return ( ( iPixel & 0xFF ) * 3 + ( ( iPixel >> 8 ) & 0xFF ) * 5 + ( ( iPixel >> 16 ) & 0xFF ) * 7 + ( iPixel >> 24 ) * 11 ) % 64;
+	}
+
+	/** @brief reads header of a QOI payload; returns false if payload is not QOI */
+	inline bool read_qoi_header(const uint8_t* inputData, size_t inputSize, QoiHeader& outputHeader)
+	{
+		if( ! inputData || inputSize < kQoiHeaderSize + kQoiPaddingSize || std::memcmp( inputData, "qoif", 4 ) != 0 ) {
+			return false;
+		}
+		outputHeader.mWidth		= ( uint32_t( inputData[ 4 ] ) << 24 ) | ( uint32_t( inputData[ 5 ] ) << 16 ) | ( uint32_t( inputData[ 6 ] ) << 8 ) | inputData[ 7 ];
+		outputHeader.mHeight	= ( uint32_t( inputData[ 8 ] ) << 24 ) | ( uint32_t( inputData[ 9 ] ) << 16 ) | ( uint32_t( inputData[ 10 ] ) << 8 ) | inputData[ 11 ];
+		outputHeader.mChannels	= inputData[ 12 ];
+		if( outputHeader.mWidth == 0 || outputHeader.mHeight == 0 || ( outputHeader.mChannels != 3 && outputHeader.mChannels != 4 )
+			|| outputHeader.mHeight >= kQoiMaxPixels / outputHeader.mWidth ) {
+			throw std::runtime_error( "Could not read QOI payload header" );
+		}
+		return true;
+	}
+
+	/** @brief encodes an 8-bit surface (any channel order) as QOI, replacing contents of output buffer */
+	inline void write_qoi_to_buffer(std::vector<uint8_t>& outputData, const ci::Surface8u& outputItem)
+	{
+		const int32_t	tWidth		= outputItem.getWidth();
+		const int32_t	tHeight		= outputItem.getHeight();
+		const int32_t	tPixelInc	= outputItem.getPixelInc();
+		const bool		tAlpha		= outputItem.hasAlpha();
+		const uint8_t	tOffR		= outputItem.getChannelOrder().getRedOffset();
+		const uint8_t	tOffG		= outputItem.getChannelOrder().getGreenOffset();
+		const uint8_t	tOffB		= outputItem.getChannelOrder().getBlueOffset();
+		const uint8_t	tOffA		= tAlpha ? outputItem.getChannelOrder().getAlphaOffset() : 0;
+		// Reserve worst case (every pixel as rgba operation):
+		outputData.resize( kQoiHeaderSize + size_t( tWidth ) * tHeight * ( tAlpha ? 5 : 4 ) + kQoiPaddingSize );
+		uint8_t* tDst = &outputData[ 0 ];
+		// Write header:
+		std::memcpy( tDst, "qoif", 4 );
+		for( int32_t i = 0; i < 4; i++ ) {
+			tDst[ 4 + i ] = uint8_t( uint32_t( tWidth ) >> ( 24 - 8 * i ) );
+			tDst[ 8 + i ] = uint8_t( uint32_t( tHeight ) >> ( 24 - 8 * i ) );
+		}
+		tDst[ 12 ]	= tAlpha ? 4 : 3;
+		tDst[ 13 ]	= 0;
+		tDst		+= kQoiHeaderSize;
+		// Write chunks:
+		uint32_t	tIndex[ 64 ]	= { 0 };
+		uint32_t	tPrev			= qoi_pack( 0, 0, 0, 255 );
+		uint32_t	tPrevRaw		= 0;
+		int32_t		tRun			= 0;
+		for( int32_t y = 0; y < tHeight; y++ ) {
+			const uint8_t* tRow = outputItem.getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < tWidth; ) {
+#if ITP_SIMD_SSE2
+				// Extend run over four identical pixels per step (stopping short of the run limit):
+				if( tRun > 0 && tPixelInc == 4 ) {
+					const __m128i tPrevV = _mm_set1_epi32( int32_t( tPrevRaw ) );
+					while( x + 4 <= tWidth && tRun + 4 < 62
+						&& _mm_movemask_epi8( _mm_cmpeq_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( tRow + x * 4 ) ), tPrevV ) ) == 0xFFFF ) {
+						tRun	+= 4;
+						x		+= 4;
+					}
+					if( x >= tWidth ) break;
+				}
+#endif
+				const uint8_t*	tSrc	= tRow + x * tPixelInc;
+				uint32_t		tPixel	= qoi_pack( tSrc[ tOffR ], tSrc[ tOffG ], tSrc[ tOffB ], tAlpha ? tSrc[ tOffA ] : 255 );
+				if( tPixelInc == 4 ) std::memcpy( &tPrevRaw, tSrc, 4 );
+				x++;
+				// Repeat previous pixel:
+				if( tPixel == tPrev ) {
+					if( ++tRun == 62 ) {
+						*tDst++	= kQoiOpRun | uint8_t( tRun - 1 );
+						tRun	= 0;
+					}
+					continue;
+				}
+				if( tRun > 0 ) {
+					*tDst++	= kQoiOpRun | uint8_t( tRun - 1 );
+					tRun	= 0;
+				}
+				// Reference recent color:
+				uint32_t tHash = qoi_hash( tPixel );
+				if( tIndex[ tHash ] == tPixel ) {
+					*tDst++ = kQoiOpIndex | uint8_t( tHash );
+				}
+				else {
+					tIndex[ tHash ] = tPixel;
+					// Encode difference to previous pixel, if alpha is unchanged:
+					if( ( tPixel >> 24 ) == ( tPrev >> 24 ) ) {
+						int8_t tDr	= int8_t( ( tPixel & 0xFF ) - ( tPrev & 0xFF ) );
+						int8_t tDg	= int8_t( ( ( tPixel >> 8 ) & 0xFF ) - ( ( tPrev >> 8 ) & 0xFF ) );
+						int8_t tDb	= int8_t( ( ( tPixel >> 16 ) & 0xFF ) - ( ( tPrev >> 16 ) & 0xFF ) );
+						int8_t tDrg	= int8_t( tDr - tDg );
+						int8_t tDbg	= int8_t( tDb - tDg );
+						if( tDr > -3 && tDr < 2 && tDg > -3 && tDg < 2 && tDb > -3 && tDb < 2 ) {
+							*tDst++ = kQoiOpDiff | uint8_t( ( tDr + 2 ) << 4 ) | uint8_t( ( tDg + 2 ) << 2 ) | uint8_t( tDb + 2 );
+						}
+						else if( tDrg > -9 && tDrg < 8 && tDg > -33 && tDg < 32 && tDbg > -9 && tDbg < 8 ) {
+							*tDst++ = kQoiOpLuma | uint8_t( tDg + 32 );
+							*tDst++ = uint8_t( ( tDrg + 8 ) << 4 ) | uint8_t( tDbg + 8 );
+						}
+						else {
+							*tDst++ = kQoiOpRgb;
+							*tDst++ = uint8_t( tPixel );
+							*tDst++ = uint8_t( tPixel >> 8 );
+							*tDst++ = uint8_t( tPixel >> 16 );
+						}
+					}
+					else {
+						*tDst++ = kQoiOpRgba;
+						*tDst++ = uint8_t( tPixel );
+						*tDst++ = uint8_t( tPixel >> 8 );
+						*tDst++ = uint8_t( tPixel >> 16 );
+						*tDst++ = uint8_t( tPixel >> 24 );
+					}
+				}
+				tPrev = tPixel;
+			}
+		}
+		if( tRun > 0 ) {
+			*tDst++ = kQoiOpRun | uint8_t( tRun - 1 );
+		}
+		// Write end marker:
+		std::memset( tDst, 0, kQoiPaddingSize - 1 );
+		tDst[ kQoiPaddingSize - 1 ] = 1;
+		tDst += kQoiPaddingSize;
+		outputData.resize( tDst - &outputData[ 0 ] );
+	}
+
+	/** @brief decodes a QOI payload into a surface of the header's size (any channel order; alpha is dropped if surface has none) */
+	inline void read_qoi_from_buffer(const uint8_t* inputData, size_t inputSize, const QoiHeader& iHeader, ci::Surface8u& outputItem)
+	{
+		if( outputItem.getWidth() != int32_t( iHeader.mWidth ) || outputItem.getHeight() != int32_t( iHeader.mHeight ) ) {
+			throw std::runtime_error( "Could not read QOI payload into surface of different size" );
+		}
+		const int32_t	tWidth		= outputItem.getWidth();
+		const int32_t	tHeight		= outputItem.getHeight();
+		const int32_t	tPixelInc	= outputItem.getPixelInc();
+		const bool		tAlpha		= outputItem.hasAlpha();
+		const uint8_t	tOffR		= outputItem.getChannelOrder().getRedOffset();
+		const uint8_t	tOffG		= outputItem.getChannelOrder().getGreenOffset();
+		const uint8_t	tOffB		= outputItem.getChannelOrder().getBlueOffset();
+		const uint8_t	tOffA		= tAlpha ? outputItem.getChannelOrder().getAlphaOffset() : 0;
+		const uint8_t*	tSrc		= inputData + kQoiHeaderSize;
+		const uint8_t*	tEnd		= inputData + inputSize - kQoiPaddingSize;
+		uint32_t		tIndex[ 64 ] = { 0 };
+		uint32_t		tPixel		= qoi_pack( 0, 0, 0, 255 );
+		uint8_t			tRaw[ 4 ]	= { 0, 0, 0, 255 };
+		int32_t			tRun		= 0;
+		for( int32_t y = 0; y < tHeight; y++ ) {
+			uint8_t* tRow = outputItem.getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < tWidth; ) {
+				// Decode next chunk:
+				if( tRun == 0 ) {
+					if( tSrc >= tEnd ) {
+						throw std::runtime_error( "Could not read truncated QOI payload" );
+					}
+					uint8_t tOp = *tSrc++;
+					if( tOp == kQoiOpRgb || tOp == kQoiOpRgba ) {
+						size_t tBytes = ( tOp == kQoiOpRgb ) ? 3 : 4;
+						if( size_t( tEnd - tSrc ) < tBytes ) {
+							throw std::runtime_error( "Could not read truncated QOI payload" );
+						}
+						tPixel = qoi_pack( tSrc[ 0 ], tSrc[ 1 ], tSrc[ 2 ], ( tOp == kQoiOpRgb ) ? ( tPixel >> 24 ) : tSrc[ 3 ] );
+						tSrc += tBytes;
+					}
+					else if( ( tOp & kQoiMask ) == kQoiOpIndex ) {
+						tPixel = tIndex[ tOp ];
+					}
+					else if( ( tOp & kQoiMask ) == kQoiOpDiff ) {
+						uint32_t tR = ( ( tPixel & 0xFF ) + ( ( tOp >> 4 ) & 3 ) - 2 ) & 0xFF;
+						uint32_t tG = ( ( ( tPixel >> 8 ) & 0xFF ) + ( ( tOp >> 2 ) & 3 ) - 2 ) & 0xFF;
+						uint32_t tB = ( ( ( tPixel >> 16 ) & 0xFF ) + ( tOp & 3 ) - 2 ) & 0xFF;
+						tPixel = qoi_pack( tR, tG, tB, tPixel >> 24 );
+					}
+					else if( ( tOp & kQoiMask ) == kQoiOpLuma ) {
+						if( tSrc >= tEnd ) {
+							throw std::runtime_error( "Could not read truncated QOI payload" );
+						}
+						uint8_t tNext	= *tSrc++;
+						int32_t tDg		= int32_t( tOp & 0x3F ) - 32;
+						uint32_t tR = ( ( tPixel & 0xFF ) + tDg - 8 + ( ( tNext >> 4 ) & 0x0F ) ) & 0xFF;
+						uint32_t tG = ( ( ( tPixel >> 8 ) & 0xFF ) + tDg ) & 0xFF;
+						uint32_t tB = ( ( ( tPixel >> 16 ) & 0xFF ) + tDg - 8 + ( tNext & 0x0F ) ) & 0xFF;
+						tPixel = qoi_pack( tR, tG, tB, tPixel >> 24 );
+					}
+					else {
+						tRun = ( tOp & 0x3F ) + 1;
+					}
+					if( tRun == 0 ) {
+						tIndex[ qoi_hash( tPixel ) ] = tPixel;
+						tRaw[ tOffR ] = uint8_t( tPixel );
+						tRaw[ tOffG ] = uint8_t( tPixel >> 8 );
+						tRaw[ tOffB ] = uint8_t( tPixel >> 16 );
+						if( tAlpha ) tRaw[ tOffA ] = uint8_t( tPixel >> 24 );
+						tRun = 1;
+					}
+				}
+				// Write pixel, or as much of run as fits into row:
+				int32_t tCount = std::min( tRun, tWidth - x );
+				uint8_t* tDst = tRow + x * tPixelInc;
+				if( tPixelInc == 4 ) {
+					uint32_t tWord;
+					std::memcpy( &tWord, tRaw, 4 );
+					std::fill( reinterpret_cast<uint32_t*>( tDst ), reinterpret_cast<uint32_t*>( tDst ) + tCount, tWord );
+				}
+				else {
+					for( int32_t i = 0; i < tCount; i++, tDst += tPixelInc ) {
+						std::memcpy( tDst, tRaw, tPixelInc );
+					}
+				}
+				tRun	-= tCount;
+				x		+= tCount;
+			}
+		}
+	}
+
+	/** @brief surface codec timings and sizes */
+	struct SurfaceCodecBenchmark
+	{
+		double	mPngRatio;			//!< raw size / PNG size
+		double	mPngEncodeMBps;		//!< PNG encode throughput (raw MB per second)
+		double	mPngDecodeMBps;		//!< PNG decode throughput (raw MB per second)
+		double	mQoiRatio;			//!< raw size / QOI size
+		double	mQoiEncodeMBps;		//!< QOI encode throughput (raw MB per second)
+		double	mQoiDecodeMBps;		//!< QOI decode throughput (raw MB per second)
+	};
+
+	/** @brief times PNG and QOI encoding and decoding of a surface (e.g. a recorded silhouette frame) */
+	inline SurfaceCodecBenchmark benchmark_surface_codecs(const ci::Surface8u& iSurface, size_t iIterations = 20)
+	{
+		SurfaceCodecBenchmark tResult;
+		ci::Timer tTimer;
+		iIterations = std::max<size_t>( iIterations, 1 );
+		const double tRawMB = double( iSurface.getWidth() ) * iSurface.getHeight() * iSurface.getPixelInc() / ( 1024.0 * 1024.0 );
+		const double tTotalMB = tRawMB * (double)iIterations;
+		// Time PNG:
+		ci::OStreamMemRef tStream;
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			tStream = ci::OStreamMem::create();
+			ci::writeImage( ci::DataTargetStream::createRef( tStream ), iSurface, ci::ImageTarget::Options(), "png" );
+		}
+		tTimer.stop();
+		tResult.mPngEncodeMBps = tTotalMB / std::max( tTimer.getSeconds(), 1e-9 );
+		std::vector<uint8_t> tPng( static_cast<const uint8_t*>( tStream->getBuffer() ), static_cast<const uint8_t*>( tStream->getBuffer() ) + tStream->tell() );
+		tResult.mPngRatio = tRawMB * 1024.0 * 1024.0 / (double)std::max<size_t>( tPng.size(), 1 );
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			ci::BufferRef tBuffer = ci::Buffer::create( tPng.empty() ? NULL : &tPng[ 0 ], tPng.size() );
+			ci::SurfaceRef tDecoded = ci::Surface::create( ci::loadImage( ci::DataSourceBuffer::create( tBuffer ), ci::ImageSource::Options(), "png" ) );
+		}
+		tTimer.stop();
+		tResult.mPngDecodeMBps = tTotalMB / std::max( tTimer.getSeconds(), 1e-9 );
+		// Time QOI:
+		std::vector<uint8_t> tQoi;
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			write_qoi_to_buffer( tQoi, iSurface );
+		}
+		tTimer.stop();
+		tResult.mQoiEncodeMBps	= tTotalMB / std::max( tTimer.getSeconds(), 1e-9 );
+		tResult.mQoiRatio		= tRawMB * 1024.0 * 1024.0 / (double)std::max<size_t>( tQoi.size(), 1 );
+		QoiHeader tHeader;
+		read_qoi_header( &tQoi[ 0 ], tQoi.size(), tHeader );
+		ci::Surface8u tDecoded( tHeader.mWidth, tHeader.mHeight, tHeader.mChannels == 4 );
+		tTimer.start();
+		for( size_t i = 0; i < iIterations; i++ ) {
+			read_qoi_from_buffer( &tQoi[ 0 ], tQoi.size(), tHeader, tDecoded );
+		}
+		tTimer.stop();
+		tResult.mQoiDecodeMBps = tTotalMB / std::max( tTimer.getSeconds(), 1e-9 );
+		return tResult;
+	}
+
+} } // namespace itp::multitrack
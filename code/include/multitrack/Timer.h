@@ -7,7 +7,11 @@
 #include <string>
 #include <memory>
 
-#include "cinder/gl/gl.h"
+#if ! defined( ITP_MULTITRACK_HEADLESS )
+	#include "cinder/gl/gl.h"
+#endif
+
+#include <multitrack/Clock.h>
 
 namespace itp { namespace multitrack {
 	
@@ -19,15 +23,19 @@ namespace itp { namespace multitrack {
 		
 	private:
 		
-		bool	mActive;	//!< activity flag
-		double	mStart;		//!< local start time (in seconds)
-		double	mPlayhead;	//!< playhead time (in seconds)
+		Clock::Ref	mClock;		//!< time source
+		bool		mActive;	//!< activity flag
+		double		mStart;		//!< local start time (in seconds)
+		double		mPlayhead;	//!< playhead time (in seconds)
+		SensorEpoch::Ref mSensorEpoch; //!< sensor timestamp anchor shared by push recorders
 		
-		/** @brief default constructor */
-		Timer() :
+		/** @brief default constructor (steady real-time clock if none is given) */
+		Timer(Clock::Ref iClock = Clock::Ref()) :
+		mClock( iClock ? iClock : SteadyClock::create() ),
 		mActive( false ),
 		mStart( 0.0 ),
-		mPlayhead( 0.0 )
+		mPlayhead( 0.0 ),
+		mSensorEpoch( SensorEpoch::create() )
 		{ /* no-op */ }
 		
 	public:
@@ -44,18 +52,51 @@ namespace itp { namespace multitrack {
 			return mPlayhead;
 		}
 		
+		/** @brief clock getter method */
+		const Clock::Ref& getClock() const
+		{
+			return mClock;
+		}
+
+		/** @brief returns sensor timestamp anchor shared by push recorders */
+		const SensorEpoch::Ref& getSensorEpoch() const
+		{
+			return mSensorEpoch;
+		}
+
+		/** @brief replaces clock, keeping current playhead */
+		void setClock(Clock::Ref iClock)
+		{
+			if( ! iClock ) return;
+			mClock = iClock;
+			mStart = mClock->getSeconds() - mPlayhead;
+		}
+
 		/** @brief timer update method */
 		void update()
 		{
 			if( ! mActive ) return;
-			mPlayhead = ci::app::getElapsedSeconds() - mStart;
+			mPlayhead = mClock->getSeconds() - mStart;
 		}
 		
-		/** @brief timer start method */
+		/** @brief timer start method (resumes from playhead, so a seek while stopped is kept; reset first to start over) */
 		void start()
 		{
 			mActive = true;
-			mStart  = ci::app::getElapsedSeconds();
+			mStart  = mClock->getSeconds() - mPlayhead;
+		}
+		
+		/** @brief moves playhead to given time (in seconds), keeping timer running if active */
+		void seek(double iPlayhead)
+		{
+			mPlayhead = iPlayhead;
+			mStart    = mClock->getSeconds() - iPlayhead;
+		}
+
+		/** @brief returns true if timer is running */
+		bool isActive() const
+		{
+			return mActive;
 		}
 		
 		/** @brief timer stop method */
@@ -64,7 +105,7 @@ namespace itp { namespace multitrack {
 			mActive = false;
 		}
 
-		/** @brief timer reset method */
+		/** @brief timer reset method (stops timer and moves playhead back to zero) */
 		void reset()
 		{
 			mActive   = false;
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <vector>
+
 #include <multitrack/Timer.h>
 
 namespace itp { namespace multitrack {
@@ -10,6 +14,9 @@ namespace itp { namespace multitrack {
 		
 		typedef std::shared_ptr<TrackBase> Ref;
 		
+		typedef std::function<void(void)>	DecodeJob;		//!< decodes one frame into a player's cache
+		typedef std::vector<DecodeJob>		DecodeJobVec;
+		
 	protected:
 		/** @brief default constructor */
 		TrackBase() { /* no-op */ }
@@ -45,6 +52,12 @@ namespace itp { namespace multitrack {
 		
 		/** @brief overloadable stop method */
 		virtual void stop() { /* no-op */ }
+		
+		/** @brief overloadable offline-mode method (when enabled, players decode synchronously instead of reading ahead) */
+		virtual void setOffline(bool) { /* no-op */ }
+		
+		/** @brief overloadable method collecting jobs that decode frames shown between two sequence times (in seconds) */
+		virtual void collectDecodeJobs(double, double, DecodeJobVec&) { /* no-op */ }
 	};
 	
 	/** @brief abstract base class for track types */
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <stdexcept>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+
+#include "cinder/Filesystem.h"
+
+#include <multitrack/MappedFile.h>
+
+namespace itp { namespace multitrack {
+
+	/** @brief on-disk storage layout of a track */
+	enum TrackFormat
+	{
+		FILE_SEQUENCE,	//!< one file per frame plus a text info file
+		CONTAINER,		//!< single binary container file with a trailing frame index
+		MAPPED			//!< container file played back through a read-only memory mapping
+	};
+
+	/*
+	 * Container layout (all fields little-endian, every chunk starts on a 16-byte boundary):
+	 *
+	 *   ContainerHeader
+	 *   { ContainerChunk, payload, zero padding } * frame count
+	 *   ContainerIndexEntry * frame count
+	 *   ContainerFooter
+	 *
+	 * The chunk headers duplicate the index entries, so a container left without an index
+	 * (e.g. after a crash) can still be recovered by walking the chunks from the front.
+	 */
+
+	static const char		kContainerMagic[8]		= { 'I', 'T', 'P', 'T', 'R', 'A', 'C', 'K' };
+	static const char		kContainerIndexMagic[8]	= { 'I', 'T', 'P', 'I', 'N', 'D', 'E', 'X' };
+	static const uint32_t	kContainerVersion		= 1;
+	static const uint32_t	kContainerChunkTag		= 0x4D415246; // "FRAM"
+	static const uint64_t	kContainerAlignment		= 16;
+
+	static const uint32_t	kContainerFrameKeyframe	= 0x1; //!< frame flag: payload decodes without preceding frames
+
+	/** @brief container file header */
+	struct ContainerHeader
+	{
+		char		mMagic[8];		//!< kContainerMagic
+		uint32_t	mVersion;		//!< kContainerVersion
+		uint32_t	mHeaderSize;	//!< sizeof( ContainerHeader )
+		char		mCodec[16];		//!< zero-padded payload codec name (e.g. file extension)
+	};
+
+	/** @brief per-frame chunk header, directly followed by the payload */
+	struct ContainerChunk
+	{
+		uint32_t	mTag;			//!< kContainerChunkTag
+		uint32_t	mFlags;			//!< codec-specific frame flags
+		uint64_t	mSize;			//!< payload size (in bytes)
+		double		mTime;			//!< frame time (in seconds)
+		uint64_t	mReserved;		//!< zero
+	};
+
+	/** @brief trailing frame index entry */
+	struct ContainerIndexEntry
+	{
+		double		mTime;			//!< frame time (in seconds)
+		uint64_t	mOffset;		//!< absolute payload offset (in bytes)
+		uint64_t	mSize;			//!< payload size (in bytes)
+		uint32_t	mFlags;			//!< codec-specific frame flags
+		uint32_t	mReserved;		//!< zero
+	};
+
+	/** @brief container file footer */
+	struct ContainerFooter
+	{
+		uint64_t	mIndexOffset;	//!< absolute offset of first index entry
+		uint64_t	mIndexCount;	//!< number of index entries
+		char		mMagic[8];		//!< kContainerIndexMagic
+	};
+
+	static_assert( sizeof( ContainerHeader ) == 32, "unexpected ContainerHeader size" );
+	static_assert( sizeof( ContainerChunk ) == 32, "unexpected ContainerChunk size" );
+	static_assert( sizeof( ContainerIndexEntry ) == 32, "unexpected ContainerIndexEntry size" );
+	static_assert( sizeof( ContainerFooter ) == 24, "unexpected ContainerFooter size" );
+
+	typedef std::vector<ContainerIndexEntry> ContainerIndex;
+
+	/** @brief returns indices of frames flagged as keyframes (sorted) */
+	inline std::vector<size_t> get_container_keyframes(const ContainerIndex& iIndex)
+	{
+		std::vector<size_t> tKeyframes;
+		for( size_t i = 0; i < iIndex.size(); i++ ) {
+			if( iIndex[ i ].mFlags & kContainerFrameKeyframe ) tKeyframes.push_back( i );
+		}
+		return tKeyframes;
+	}
+
+	/** @brief append-only container writer */
+	class ContainerWriter {
+	public:
+
+		typedef std::shared_ptr<ContainerWriter> Ref;
+
+	private:
+
+		std::ofstream	mFile;		//!< output file
+		ci::fs::path	mPath;		//!< output path
+		ContainerIndex	mIndex;		//!< index of appended frames
+		uint64_t		mOffset;	//!< current write offset (in bytes)
+
+		/** @brief default constructor */
+		ContainerWriter(const ci::fs::path& iPath, const std::string& iCodec) :
+			mPath( iPath ),
+			mOffset( 0 )
+		{
+			// Try to open file:
+			mFile.open( mPath.string(), std::ios::out | std::ios::binary | std::ios::trunc );
+			if( ! mFile.is_open() ) {
+				throw std::runtime_error( "ContainerWriter could not open file: \'" + mPath.string() + "\'" );
+			}
+			// Write header:
+			ContainerHeader tHeader;
+			std::memset( &tHeader, 0, sizeof( tHeader ) );
+			std::memcpy( tHeader.mMagic, kContainerMagic, sizeof( tHeader.mMagic ) );
+			tHeader.mVersion    = kContainerVersion;
+			tHeader.mHeaderSize = sizeof( ContainerHeader );
+			std::strncpy( tHeader.mCodec, iCodec.c_str(), sizeof( tHeader.mCodec ) - 1 );
+			write_bytes( &tHeader, sizeof( tHeader ) );
+		}
+
+		/** @brief writes raw bytes and advances offset */
+		void write_bytes(const void* iData, uint64_t iSize)
+		{
+			if( iSize == 0 ) return;
+			mFile.write( static_cast<const char*>( iData ), static_cast<std::streamsize>( iSize ) );
+			if( ! mFile.good() ) {
+				throw std::runtime_error( "ContainerWriter could not write file: \'" + mPath.string() + "\'" );
+			}
+			mOffset += iSize;
+		}
+
+		/** @brief pads output with zeros up to the next chunk boundary */
+		void write_padding()
+		{
+			static const char kZeros[kContainerAlignment] = { 0 };
+			uint64_t tRemainder = mOffset % kContainerAlignment;
+			if( tRemainder != 0 ) {
+				write_bytes( kZeros, kContainerAlignment - tRemainder );
+			}
+		}
+
+	public:
+
+		/** @brief destructor */
+		~ContainerWriter()
+		{
+			try { close(); } catch( ... ) { /* no-op */ }
+		}
+
+		/** @brief static creational method */
+		template <typename ... Args> static ContainerWriter::Ref create(Args&& ... args)
+		{
+			return ContainerWriter::Ref( new ContainerWriter( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns number of appended frames */
+		size_t size() const
+		{
+			return mIndex.size();
+		}
+
+		/** @brief appends a frame payload */
+		void append(double iTime, const void* iData, uint64_t iSize, uint32_t iFlags = 0)
+		{
+			if( ! mFile.is_open() ) {
+				throw std::runtime_error( "ContainerWriter could not append to closed file: \'" + mPath.string() + "\'" );
+			}
+			// Write chunk header:
+			ContainerChunk tChunk;
+			std::memset( &tChunk, 0, sizeof( tChunk ) );
+			tChunk.mTag   = kContainerChunkTag;
+			tChunk.mFlags = iFlags;
+			tChunk.mSize  = iSize;
+			tChunk.mTime  = iTime;
+			write_bytes( &tChunk, sizeof( tChunk ) );
+			// Add index entry:
+			ContainerIndexEntry tEntry;
+			std::memset( &tEntry, 0, sizeof( tEntry ) );
+			tEntry.mTime   = iTime;
+			tEntry.mOffset = mOffset;
+			tEntry.mSize   = iSize;
+			tEntry.mFlags  = iFlags;
+			mIndex.push_back( tEntry );
+			// Write payload:
+			write_bytes( iData, iSize );
+			write_padding();
+		}
+
+		/** @brief appends a frame payload */
+		void append(double iTime, const std::vector<uint8_t>& iData, uint32_t iFlags = 0)
+		{
+			append( iTime, iData.empty() ? NULL : &iData[ 0 ], iData.size(), iFlags );
+		}
+
+		/** @brief writes trailing index and closes file */
+		void close()
+		{
+			if( ! mFile.is_open() ) return;
+			// Write index:
+			ContainerFooter tFooter;
+			std::memset( &tFooter, 0, sizeof( tFooter ) );
+			tFooter.mIndexOffset = mOffset;
+			tFooter.mIndexCount  = mIndex.size();
+			std::memcpy( tFooter.mMagic, kContainerIndexMagic, sizeof( tFooter.mMagic ) );
+			if( ! mIndex.empty() ) {
+				write_bytes( &mIndex[ 0 ], mIndex.size() * sizeof( ContainerIndexEntry ) );
+			}
+			write_bytes( &tFooter, sizeof( tFooter ) );
+			// Close file:
+			mFile.close();
+		}
+	};
+
+	/** @brief random-access container reader */
+	class ContainerReader {
+	public:
+
+		typedef std::shared_ptr<ContainerReader> Ref;
+
+	private:
+
+		std::ifstream	mFile;		//!< input file
+		std::mutex		mMutex;		//!< guards file position
+		ci::fs::path	mPath;		//!< input path
+		ContainerHeader	mHeader;	//!< file header
+		ContainerIndex	mIndex;		//!< frame index
+		bool			mRecovered;	//!< true if index was rebuilt from chunk headers
+		MappedFile::Ref	mMapping;	//!< file mapping (mapped readers only)
+
+		/** @brief default constructor */
+		ContainerReader(const ci::fs::path& iPath, bool iMapped = false) :
+			mPath( iPath ),
+			mRecovered( false )
+		{
+			// Try to open file:
+			mFile.open( mPath.string(), std::ios::in | std::ios::binary );
+			if( ! mFile.is_open() ) {
+				throw std::runtime_error( "ContainerReader could not open file: \'" + mPath.string() + "\'" );
+			}
+			// Get file size:
+			mFile.seekg( 0, std::ios::end );
+			uint64_t tFileSize = static_cast<uint64_t>( mFile.tellg() );
+			mFile.seekg( 0, std::ios::beg );
+			// Read and validate header:
+			if( tFileSize < sizeof( ContainerHeader ) || ! read_bytes( &mHeader, sizeof( mHeader ) )
+				|| std::memcmp( mHeader.mMagic, kContainerMagic, sizeof( mHeader.mMagic ) ) != 0
+				|| mHeader.mVersion > kContainerVersion ) {
+				throw std::runtime_error( "ContainerReader could not read header: \'" + mPath.string() + "\'" );
+			}
+			// Read index, or recover it from chunk headers:
+			if( ! read_index( tFileSize ) ) {
+				recover_index( tFileSize );
+			}
+			// Map file, if requested:
+			if( iMapped ) {
+				mFile.close();
+				mMapping = MappedFile::create( mPath );
+				for( const auto& tEntry : mIndex ) {
+					if( tEntry.mOffset > mMapping->getSize() || tEntry.mSize > mMapping->getSize() - tEntry.mOffset ) {
+						throw std::runtime_error( "ContainerReader found frame outside of mapping: \'" + mPath.string() + "\'" );
+					}
+				}
+			}
+		}
+
+		/** @brief reads raw bytes from current position */
+		bool read_bytes(void* oData, uint64_t iSize)
+		{
+			mFile.read( static_cast<char*>( oData ), static_cast<std::streamsize>( iSize ) );
+			return mFile.good();
+		}
+
+		/** @brief reads trailing index; returns false if footer is missing or malformed, throws if an entry points outside of the frame data */
+		bool read_index(uint64_t iFileSize)
+		{
+			if( iFileSize < sizeof( ContainerHeader ) + sizeof( ContainerFooter ) ) return false;
+			// Read footer:
+			ContainerFooter tFooter;
+			mFile.seekg( static_cast<std::streamoff>( iFileSize - sizeof( ContainerFooter ) ), std::ios::beg );
+			if( ! read_bytes( &tFooter, sizeof( tFooter ) ) ) return false;
+			// Validate footer:
+			if( std::memcmp( tFooter.mMagic, kContainerIndexMagic, sizeof( tFooter.mMagic ) ) != 0 ) return false;
+			uint64_t tIndexEnd = iFileSize - sizeof( ContainerFooter );
+			if( tFooter.mIndexCount > tIndexEnd / sizeof( ContainerIndexEntry ) ) return false;
+			if( tFooter.mIndexOffset != tIndexEnd - tFooter.mIndexCount * sizeof( ContainerIndexEntry ) ) return false;
+			// Read entries:
+			mIndex.resize( static_cast<size_t>( tFooter.mIndexCount ) );
+			mFile.seekg( static_cast<std::streamoff>( tFooter.mIndexOffset ), std::ios::beg );
+			if( ! mIndex.empty() && ! read_bytes( &mIndex[ 0 ], mIndex.size() * sizeof( ContainerIndexEntry ) ) ) {
+				mIndex.clear();
+				return false;
+			}
+			// Validate entries (payloads lie between header and index; compared without overflow):
+			for( const auto& tEntry : mIndex ) {
+				if( tEntry.mOffset > tFooter.mIndexOffset || tEntry.mSize > tFooter.mIndexOffset - tEntry.mOffset ) {
+					mIndex.clear();
+					throw std::runtime_error( "ContainerReader found corrupt container index: \'" + mPath.string() + "\'" );
+				}
+			}
+			return true;
+		}
+
+		/** @brief rebuilds index by walking chunk headers (used for unterminated containers) */
+		void recover_index(uint64_t iFileSize)
+		{
+			mIndex.clear();
+			mFile.clear();
+			mRecovered = true;
+			uint64_t tOffset = mHeader.mHeaderSize;
+			while( tOffset + sizeof( ContainerChunk ) <= iFileSize ) {
+				// Read chunk header:
+				ContainerChunk tChunk;
+				mFile.seekg( static_cast<std::streamoff>( tOffset ), std::ios::beg );
+				if( ! read_bytes( &tChunk, sizeof( tChunk ) ) || tChunk.mTag != kContainerChunkTag ) break;
+				// Stop at truncated payload:
+				uint64_t tPayload = tOffset + sizeof( ContainerChunk );
+				if( tChunk.mSize > iFileSize - tPayload ) break;
+				// Add index entry:
+				ContainerIndexEntry tEntry;
+				std::memset( &tEntry, 0, sizeof( tEntry ) );
+				tEntry.mTime   = tChunk.mTime;
+				tEntry.mOffset = tPayload;
+				tEntry.mSize   = tChunk.mSize;
+				tEntry.mFlags  = tChunk.mFlags;
+				mIndex.push_back( tEntry );
+				// Advance to next chunk boundary:
+				tOffset = tPayload + tChunk.mSize;
+				tOffset = ( tOffset + kContainerAlignment - 1 ) / kContainerAlignment * kContainerAlignment;
+			}
+			mFile.clear();
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static ContainerReader::Ref create(Args&& ... args)
+		{
+			return ContainerReader::Ref( new ContainerReader( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns frame index */
+		const ContainerIndex& getIndex() const
+		{
+			return mIndex;
+		}
+
+		/** @brief returns payload codec name stored in header */
+		std::string getCodec() const
+		{
+			return std::string( mHeader.mCodec, strnlen( mHeader.mCodec, sizeof( mHeader.mCodec ) ) );
+		}
+
+		/** @brief returns true if index was rebuilt from chunk headers */
+		bool isRecovered() const
+		{
+			return mRecovered;
+		}
+
+		/** @brief returns number of frames */
+		size_t size() const
+		{
+			return mIndex.size();
+		}
+
+		/** @brief returns true if payloads are accessed through a memory mapping */
+		bool isMapped() const
+		{
+			return ( mMapping.get() != NULL );
+		}
+
+		/** @brief returns file mapping (mapped readers only) */
+		MappedFile::Ref getMapping() const
+		{
+			return mMapping;
+		}
+
+		/** @brief returns pointer to a frame payload inside the mapping (mapped readers only) */
+		const uint8_t* getPayload(size_t iFrame) const
+		{
+			if( iFrame >= mIndex.size() ) {
+				throw std::out_of_range( "ContainerReader frame out of range: \'" + mPath.string() + "\'" );
+			}
+			if( ! mMapping ) {
+				throw std::runtime_error( "ContainerReader is not mapped: \'" + mPath.string() + "\'" );
+			}
+			return mMapping->getData() + mIndex[ iFrame ].mOffset;
+		}
+
+		/** @brief reads a frame payload into output buffer (resized to fit) */
+		void read(size_t iFrame, std::vector<uint8_t>& oData)
+		{
+			if( iFrame >= mIndex.size() ) {
+				throw std::out_of_range( "ContainerReader frame out of range: \'" + mPath.string() + "\'" );
+			}
+			const ContainerIndexEntry& tEntry = mIndex[ iFrame ];
+			// Copy from mapping, if available:
+			if( mMapping ) {
+				const uint8_t* tData = mMapping->getData() + tEntry.mOffset;
+				oData.assign( tData, tData + tEntry.mSize );
+				return;
+			}
+			oData.resize( static_cast<size_t>( tEntry.mSize ) );
+			// Seek and read payload:
+			std::lock_guard<std::mutex> tLock( mMutex );
+			mFile.clear();
+			mFile.seekg( static_cast<std::streamoff>( tEntry.mOffset ), std::ios::beg );
+			if( ! oData.empty() && ! read_bytes( &oData[ 0 ], oData.size() ) ) {
+				throw std::runtime_error( "ContainerReader could not read frame: \'" + mPath.string() + "\'" );
+			}
+		}
+	};
+
+} } // namespace itp::multitrack
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sstream>
+
 #include <multitrack/Track.h>
 #include <multitrack/TypeTrack.h>
 
@@ -43,13 +45,31 @@ namespace itp { namespace multitrack {
 		{
 			// Draw tracks:
 			for( auto &tTrack : mTracks ) {
+#if ! defined( ITP_MULTITRACK_HEADLESS )
 				ci::gl::color( 1.0, 1.0, 1.0, 0.5 ); // TODO
+#endif
 				tTrack->draw();
 			}
+#if ! defined( ITP_MULTITRACK_HEADLESS )
 			// Draw info:
 			std::stringstream ss;
 			ss << "TIME: " << mTimer->getPlayhead();
 			ci::gl::drawString( ss.str(), ci::vec2( 25.0 ), ci::Color::white() );
+#endif
+		}
+		
+		void setOffline(bool iOffline)
+		{
+			for( auto &tTrack : mTracks ) {
+				tTrack->setOffline( iOffline );
+			}
+		}
+		
+		void collectDecodeJobs(double iBegin, double iEnd, DecodeJobVec& oJobs)
+		{
+			for( auto &tTrack : mTracks ) {
+				tTrack->collectDecodeJobs( iBegin, iEnd, oJobs );
+			}
 		}
 		
 		void removeTrack(Track::Ref iTrack)
@@ -70,10 +90,11 @@ namespace itp { namespace multitrack {
 		template <typename T> Track::Ref addTrackRecorder(const ci::fs::path& iDirectory,
 														  const std::string& iName,
 														  std::function<T(void)> iRecorderCallbackFn,
-														  std::function<void(const T&)> iPlayerCallbackFn)
+														  std::function<void(const T&)> iPlayerCallbackFn,
+														  TrackFormat iFormat = TrackFormat::FILE_SEQUENCE)
 		{
 			// Create typed track:
-			typename TrackT<T>::Ref tTrack = TrackT<T>::create( iDirectory, iName, getRef<TrackGroup>() );
+			typename TrackT<T>::Ref tTrack = TrackT<T>::create( iDirectory, iName, getRef<TrackGroup>(), iFormat );
 			// Add track to controller:
 			addTrack( tTrack );
 			// Start recorder:
@@ -1,104 +1,1546 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <cstddef>
+#include <cstring>
+
 #include "cinder/Surface.h"
+#include "cinder/Channel.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Utilities.h"
 
-#include "Kinect2.h"
-
+#include <multitrack/Clock.h>
 #include <multitrack/Track.h>
+#include <multitrack/PointCloud.h>
+#include <multitrack/BodyIndexRle.h>
+#include <multitrack/WriterQueue.h>
+#include <multitrack/ChannelDelta.h>
+#include <multitrack/CroppedSurface.h>
+#include <multitrack/TrackContainer.h>
+#include <multitrack/FrameCache.h>
+#include <multitrack/FramePool.h>
+#include <multitrack/FramePrefetcher.h>
+#include <multitrack/SurfaceCodec.h>
 
 namespace itp { namespace multitrack {
 
-	typedef std::shared_ptr<struct PointCloud> PointCloudRef;
+	template<typename T> inline std::string get_file_extension() { /* no-op */ }
+	template<typename T> inline T read_from_file(const ci::fs::path& inputPath) { /* no-op */ }
+	template<typename T> inline void write_to_file(const ci::fs::path& outputPath, const T& outputItem) { /* no-op */ }
+	template<typename T> inline T read_from_buffer(const uint8_t* inputData, size_t inputSize) { /* no-op */ }
+	template<typename T> inline void write_to_buffer(std::vector<uint8_t>& outputData, const T& outputItem) { /* no-op */ }
+	
+	/** @brief reads whole file into output buffer (resized to fit) */
+	inline void read_file_bytes(const ci::fs::path& inputPath, std::vector<uint8_t>& outputData)
+	{
+		// Try to open file:
+		std::ifstream tFile(inputPath.string(), std::ios::in | std::ios::binary);
+		if (!tFile.is_open()) {
+			throw std::runtime_error("Could not open file: '" + inputPath.string() + "'");
+		}
+		// Read contents:
+		tFile.seekg(0, std::ios::end);
+		outputData.resize(static_cast<size_t>(tFile.tellg()));
+		tFile.seekg(0, std::ios::beg);
+		if (!outputData.empty() && !tFile.read(reinterpret_cast<char*>(&outputData[0]), outputData.size())) {
+			throw std::runtime_error("Could not read file: '" + inputPath.string() + "'");
+		}
+	}
+
+	/** @brief writes buffer to file */
+	inline void write_file_bytes(const ci::fs::path& outputPath, const std::vector<uint8_t>& outputData)
+	{
+		// Try to open file:
+		std::ofstream tFile(outputPath.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!tFile.is_open()) {
+			throw std::runtime_error("Could not open file: '" + outputPath.string() + "'");
+		}
+		// Write contents:
+		if (!outputData.empty() && !tFile.write(reinterpret_cast<const char*>(&outputData[0]), outputData.size())) {
+			throw std::runtime_error("Could not write file: '" + outputPath.string() + "'");
+		}
+	}
+
+	/** @brief returns approximate in-memory size of a decoded frame (in bytes) */
+	template<typename T> inline size_t get_frame_bytes(const T& item)
+	{
+		return sizeof( T );
+	}
+
+	/** @brief decodes a payload into a frame taken from a pool (types without pooled decoding allocate as usual) */
+	template<typename T> inline T read_from_buffer_pooled(const uint8_t* inputData, size_t inputSize, FramePoolT<T>& ioPool)
+	{
+		return read_from_buffer<T>( inputData, inputSize );
+	}
+
+	/** @brief reads a frame file into a frame taken from a pool, using given buffer for the file contents */
+	template<typename T> inline T read_from_file_pooled(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<T>& ioPool)
+	{
+		return read_from_file<T>( inputPath );
+	}
+
+	/** @brief selects frame types whose mapped payloads are viewed in place, without copying (see view_from_buffer) */
+	template<typename T> struct FrameViewTraits
+	{
+		static const bool kEnabled = false; //!< true if view_from_buffer wraps the payload
+		typedef std::shared_ptr<const typename T::element_type> ConstRef; //!< read-only frame
+	};
+
+	/** @brief returns a read-only frame backed by (or decoded from) a mapped payload; iOwner keeps the mapping alive */
+	template<typename T> inline typename FrameViewTraits<T>::ConstRef view_from_buffer(const uint8_t* inputData, size_t inputSize, const std::shared_ptr<const void>& iOwner)
+	{
+		return read_from_buffer<T>( inputData, inputSize );
+	}
+	
+	template<> inline std::string get_file_extension<ci::SurfaceRef>()
+	{
+		return SurfaceCodecTraits::getFileExtension();
+	}
+
+	template<> inline size_t get_frame_bytes<ci::SurfaceRef>(const ci::SurfaceRef& item)
+	{
+		return sizeof( ci::Surface ) + ( item ? item->getRowBytes() * item->getHeight() : 0 );
+	}
+
+	template<> inline ci::SurfaceRef read_from_buffer<ci::SurfaceRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		// Decode QOI payload:
+		QoiHeader tHeader;
+		if( read_qoi_header( inputData, inputSize, tHeader ) ) {
+			ci::SurfaceRef tOutput = ci::Surface::create( tHeader.mWidth, tHeader.mHeight, tHeader.mChannels == 4 );
+			read_qoi_from_buffer( inputData, inputSize, tHeader, *tOutput );
+			return tOutput;
+		}
+		// Decode PNG payload:
+		ci::BufferRef tBuffer = ci::Buffer::create( const_cast<uint8_t*>( inputData ), inputSize );
+		return ci::Surface::create( ci::loadImage( ci::DataSourceBuffer::create( tBuffer ), ci::ImageSource::Options(), SurfaceCodecTraits::getFileExtension( SURFACE_CODEC_PNG ) ) );
+	}
+
+	template<> inline ci::SurfaceRef read_from_buffer_pooled<ci::SurfaceRef>(const uint8_t* inputData, size_t inputSize, FramePoolT<ci::SurfaceRef>& ioPool)
+	{
+		QoiHeader tHeader;
+		if( ! read_qoi_header( inputData, inputSize, tHeader ) ) {
+			return read_from_buffer<ci::SurfaceRef>( inputData, inputSize );
+		}
+		ci::SurfaceRef tOutput = acquire_surface( ioPool, ci::ivec2( tHeader.mWidth, tHeader.mHeight ), tHeader.mChannels == 4 );
+		read_qoi_from_buffer( inputData, inputSize, tHeader, *tOutput );
+		return tOutput;
+	}
+
+	template<> inline void write_to_buffer<ci::SurfaceRef>(std::vector<uint8_t>& outputData, const ci::SurfaceRef& outputItem)
+	{
+		if( SurfaceCodecTraits::kCodec == SURFACE_CODEC_QOI ) {
+			write_qoi_to_buffer( outputData, *outputItem );
+			return;
+		}
+		ci::OStreamMemRef tStream = ci::OStreamMem::create();
+		ci::writeImage( ci::DataTargetStream::createRef( tStream ), *outputItem, ci::ImageTarget::Options(), SurfaceCodecTraits::getFileExtension( SURFACE_CODEC_PNG ) );
+		const uint8_t* tData = static_cast<const uint8_t*>( tStream->getBuffer() );
+		outputData.assign( tData, tData + tStream->tell() );
+	}
+
+	template<> inline ci::SurfaceRef read_from_file<ci::SurfaceRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<ci::SurfaceRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline ci::SurfaceRef read_from_file_pooled<ci::SurfaceRef>(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<ci::SurfaceRef>& ioPool)
+	{
+		read_file_bytes(inputPath, ioBuffer);
+		return read_from_buffer_pooled<ci::SurfaceRef>(ioBuffer.empty() ? NULL : &ioBuffer[0], ioBuffer.size(), ioPool);
+	}
+	
+	template<> inline void write_to_file<ci::SurfaceRef>(const ci::fs::path& outputPath, const ci::SurfaceRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<ci::SurfaceRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	/** @brief cropped surface payload header (surface payload follows, unless frame is fully transparent) */
+	struct CroppedSurfacePayloadHeader
+	{
+		uint32_t	mFrameWidth;	//!< full frame width (in pixels)
+		uint32_t	mFrameHeight;	//!< full frame height (in pixels)
+		uint32_t	mOffsetX;		//!< bounds left edge (in pixels)
+		uint32_t	mOffsetY;		//!< bounds top edge (in pixels)
+	};
+
+	template<> inline std::string get_file_extension<CroppedSurfaceRef>()
+	{
+		return "crop";
+	}
+
+	template<> inline size_t get_frame_bytes<CroppedSurfaceRef>(const CroppedSurfaceRef& item)
+	{
+		return sizeof( CroppedSurface ) + ( item ? get_frame_bytes<ci::SurfaceRef>( item->mSurface ) : 0 );
+	}
+
+	template<> inline CroppedSurfaceRef read_from_buffer<CroppedSurfaceRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		if( inputSize < sizeof( CroppedSurfacePayloadHeader ) ) {
+			throw std::runtime_error( "Could not read cropped surface payload" );
+		}
+		CroppedSurfacePayloadHeader tHeader;
+		std::memcpy( &tHeader, inputData, sizeof( tHeader ) );
+		CroppedSurfaceRef tOutput = std::make_shared<CroppedSurface>();
+		tOutput->mFrameSize	= ci::ivec2( tHeader.mFrameWidth, tHeader.mFrameHeight );
+		tOutput->mOffset	= ci::ivec2( tHeader.mOffsetX, tHeader.mOffsetY );
+		if( inputSize > sizeof( tHeader ) ) {
+			tOutput->mSurface = read_from_buffer<ci::SurfaceRef>( inputData + sizeof( tHeader ), inputSize - sizeof( tHeader ) );
+			if( tOutput->mOffset.x + tOutput->mSurface->getWidth() > tOutput->mFrameSize.x || tOutput->mOffset.y + tOutput->mSurface->getHeight() > tOutput->mFrameSize.y ) {
+				throw std::runtime_error( "Could not read cropped surface payload with bounds outside frame" );
+			}
+		}
+		return tOutput;
+	}
+
+	template<> inline void write_to_buffer<CroppedSurfaceRef>(std::vector<uint8_t>& outputData, const CroppedSurfaceRef& outputItem)
+	{
+		CroppedSurfacePayloadHeader tHeader = { static_cast<uint32_t>( outputItem->mFrameSize.x ), static_cast<uint32_t>( outputItem->mFrameSize.y ),
+			static_cast<uint32_t>( outputItem->mOffset.x ), static_cast<uint32_t>( outputItem->mOffset.y ) };
+		std::vector<uint8_t> tSurfaceData;
+		if( outputItem->mSurface ) {
+			write_to_buffer<ci::SurfaceRef>( tSurfaceData, outputItem->mSurface );
+		}
+		outputData.resize( sizeof( tHeader ) + tSurfaceData.size() );
+		std::memcpy( &outputData[ 0 ], &tHeader, sizeof( tHeader ) );
+		if( ! tSurfaceData.empty() ) {
+			std::memcpy( &outputData[ sizeof( tHeader ) ], &tSurfaceData[ 0 ], tSurfaceData.size() );
+		}
+	}
+
+	template<> inline CroppedSurfaceRef read_from_file<CroppedSurfaceRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<CroppedSurfaceRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline void write_to_file<CroppedSurfaceRef>(const ci::fs::path& outputPath, const CroppedSurfaceRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<CroppedSurfaceRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	static const uint8_t kPointCloudBinaryVersion			= 2; //!< current binary point cloud encoding version
+	static const uint8_t kPointCloudBinaryVersionPacked		= 1; //!< binary point cloud encoding with interleaved x/y only
+	static const uint8_t kPointCloudBinaryVersionQuantized	= 3; //!< binary point cloud encoding with 16-bit fixed-point coordinates
+	static const uint8_t kPointCloudBinaryVersionDelta		= 4; //!< quantized point cloud delta against the previous frame (container tracks only)
+	static const uint8_t kPointCloudBinaryVersionImage		= 5; //!< in-memory image of PointCloud, viewed in place by mapped tracks
+
+	/*
+	 * Binary point cloud encoding (little-endian):
+	 *
+	 *   uint8_t  version (kPointCloudBinaryVersion)
+	 *   uint8_t  reserved[3]
+	 *   uint32_t point count
+	 *   uint64_t body id (PointCloud::kMaxBodies times)
+	 *   float    x (point count times)
+	 *   float    y (point count times)
+	 *   uint8_t  tracking state (point count times)
+	 *   uint8_t  joint type (point count times)
+	 *   uint8_t  body slot (point count times)
+	 *
+	 * Version 1 payloads hold the point count followed by interleaved x/y pairs.
+	 * Payloads that do not start with a known version byte are read as legacy "x y" text lines.
+	 *
+	 * Quantized payloads (see QuantizedPointCloud) start with a PointCloudQuantizedHeader; version 3 follows it
+	 * with the body ids and the x, y and tag arrays, version 4 with a channel delta (see ChannelDelta.h) of
+	 * those arrays against the previous frame, which must have the same point count, scale and body ids.
+	 *
+	 * Image payloads (version 5, written by mapped tracks) start with a PointCloudImageHeader holding the point
+	 * count and the payload offsets of the body id, x, y, tracking state, joint type and body slot arrays, which
+	 * follow in that order. Offsets keep the body ids 8-byte and the coordinates 4-byte aligned (payloads start
+	 * on a container chunk boundary), so a mapped frame can be viewed in place (see PointCloudView).
+	 */
+
+	/** @brief header of quantized point cloud payloads */
+	struct PointCloudQuantizedHeader
+	{
+		uint8_t		mVersion;		//!< kPointCloudBinaryVersionQuantized or kPointCloudBinaryVersionDelta
+		uint8_t		mReserved[ 3 ];	//!< zero
+		uint32_t	mCount;			//!< point count
+		float		mScale;			//!< fixed-point steps per pixel
+	};
+
+	/** @brief reads and validates header of a quantized point cloud payload */
+	inline PointCloudQuantizedHeader read_point_cloud_quantized_header(const uint8_t* inputData, size_t inputSize)
+	{
+		PointCloudQuantizedHeader tHeader;
+		if (inputSize < sizeof(tHeader)) {
+			throw std::runtime_error("Could not read quantized point cloud payload");
+		}
+		std::memcpy(&tHeader, inputData, sizeof(tHeader));
+		if (tHeader.mCount > PointCloud::kCapacity) {
+			throw std::runtime_error("Point cloud payload exceeds capacity");
+		}
+		if (!(tHeader.mScale > 0.0f && tHeader.mScale < std::numeric_limits<float>::infinity())) {
+			throw std::runtime_error("Quantized point cloud payload has invalid scale");
+		}
+		return tHeader;
+	}
+
+	/** @brief writes quantized point cloud as keyframe payload */
+	inline void write_point_cloud_quantized(std::vector<uint8_t>& outputData, const QuantizedPointCloud& outputCloud)
+	{
+		PointCloudQuantizedHeader tHeader = { kPointCloudBinaryVersionQuantized, { 0, 0, 0 }, static_cast<uint32_t>(outputCloud.size()), outputCloud.mScale };
+		size_t tValueBytes = outputCloud.mValues.size() * sizeof(uint16_t);
+		outputData.resize(sizeof(tHeader) + sizeof(outputCloud.mBodyId) + tValueBytes);
+		std::memcpy(&outputData[0], &tHeader, sizeof(tHeader));
+		std::memcpy(&outputData[sizeof(tHeader)], outputCloud.mBodyId, sizeof(outputCloud.mBodyId));
+		if (tValueBytes > 0) {
+			std::memcpy(&outputData[sizeof(tHeader) + sizeof(outputCloud.mBodyId)], &outputCloud.mValues[0], tValueBytes);
+		}
+	}
+
+	/** @brief reads quantized point cloud from keyframe payload */
+	inline void read_point_cloud_quantized(const uint8_t* inputData, size_t inputSize, QuantizedPointCloud& outputCloud)
+	{
+		PointCloudQuantizedHeader tHeader = read_point_cloud_quantized_header(inputData, inputSize);
+		size_t tValueBytes = size_t(tHeader.mCount) * 3 * sizeof(uint16_t);
+		if (tHeader.mVersion != kPointCloudBinaryVersionQuantized || inputSize < sizeof(tHeader) + sizeof(outputCloud.mBodyId) + tValueBytes) {
+			throw std::runtime_error("Could not read quantized point cloud payload");
+		}
+		outputCloud.mScale = tHeader.mScale;
+		outputCloud.mCount = tHeader.mCount;
+		std::memcpy(outputCloud.mBodyId, inputData + sizeof(tHeader), sizeof(outputCloud.mBodyId));
+		outputCloud.mValues.resize(size_t(tHeader.mCount) * 3);
+		if (tValueBytes > 0) {
+			std::memcpy(&outputCloud.mValues[0], inputData + sizeof(tHeader) + sizeof(outputCloud.mBodyId), tValueBytes);
+		}
+	}
+
+	/** @brief writes delta between quantized point clouds of same point count, scale and body ids */
+	inline void write_point_cloud_delta(std::vector<uint8_t>& outputData, const QuantizedPointCloud& iCurr, const QuantizedPointCloud& iPrev)
+	{
+		PointCloudQuantizedHeader tHeader = { kPointCloudBinaryVersionDelta, { 0, 0, 0 }, static_cast<uint32_t>(iCurr.size()), iCurr.mScale };
+		outputData.resize(sizeof(tHeader));
+		std::memcpy(&outputData[0], &tHeader, sizeof(tHeader));
+		if (!iCurr.mValues.empty()) {
+			write_channel_delta<uint16_t>(outputData, &iCurr.mValues[0], &iPrev.mValues[0], iCurr.mValues.size());
+		}
+	}
+
+	/** @brief applies delta payload to previous quantized point cloud in place */
+	inline void read_point_cloud_delta(const uint8_t* inputData, size_t inputSize, QuantizedPointCloud& ioCloud)
+	{
+		PointCloudQuantizedHeader tHeader = read_point_cloud_quantized_header(inputData, inputSize);
+		if (tHeader.mVersion != kPointCloudBinaryVersionDelta || tHeader.mCount != ioCloud.size() || tHeader.mScale != ioCloud.mScale) {
+			throw std::runtime_error("Could not read point cloud delta payload without matching preceding frame");
+		}
+		if (!ioCloud.mValues.empty()) {
+			read_channel_delta<uint16_t>(inputData + sizeof(tHeader), inputSize - sizeof(tHeader), &ioCloud.mValues[0], ioCloud.mValues.size());
+		}
+	}
+
+	/** @brief header of point cloud image payloads (offsets are in bytes, from start of payload) */
+	struct PointCloudImageHeader
+	{
+		uint8_t		mVersion;		//!< kPointCloudBinaryVersionImage
+		uint8_t		mReserved[ 3 ];	//!< zero
+		uint32_t	mCount;			//!< point count
+		uint32_t	mBodyIdOffset;	//!< offset of body ids (uint64_t, PointCloud::kMaxBodies times)
+		uint32_t	mXOffset;		//!< offset of x coordinates (float, point count times)
+		uint32_t	mYOffset;		//!< offset of y coordinates (float, point count times)
+		uint32_t	mStateOffset;	//!< offset of tracking states (uint8_t, point count times)
+		uint32_t	mJointOffset;	//!< offset of joint types (uint8_t, point count times)
+		uint32_t	mBodyOffset;	//!< offset of body slots (uint8_t, point count times)
+	};
+
+	static_assert( sizeof( PointCloudImageHeader ) == 32, "unexpected PointCloudImageHeader size" );
+
+	/** @brief reads and validates header of a point cloud image payload */
+	inline PointCloudImageHeader read_point_cloud_image_header(const uint8_t* inputData, size_t inputSize)
+	{
+		PointCloudImageHeader tHeader;
+		if (inputSize < sizeof(tHeader)) {
+			throw std::runtime_error("Could not read point cloud image payload");
+		}
+		std::memcpy(&tHeader, inputData, sizeof(tHeader));
+		if (tHeader.mVersion != kPointCloudBinaryVersionImage) {
+			throw std::runtime_error("Could not read point cloud image payload");
+		}
+		if (tHeader.mCount > PointCloud::kCapacity) {
+			throw std::runtime_error("Point cloud payload exceeds capacity");
+		}
+		// Check that every array lies within payload:
+		const uint32_t	tOffsets[ 6 ]	= { tHeader.mBodyIdOffset, tHeader.mXOffset, tHeader.mYOffset, tHeader.mStateOffset, tHeader.mJointOffset, tHeader.mBodyOffset };
+		const size_t	tSizes[ 6 ]		= { PointCloud::kMaxBodies * sizeof(uint64_t), tHeader.mCount * sizeof(float), tHeader.mCount * sizeof(float), tHeader.mCount, tHeader.mCount, tHeader.mCount };
+		for (size_t i = 0; i < 6; i++) {
+			if (tOffsets[ i ] < sizeof(tHeader) || tOffsets[ i ] > inputSize || tSizes[ i ] > inputSize - tOffsets[ i ]) {
+				throw std::runtime_error("Could not read point cloud image payload with array outside payload");
+			}
+		}
+		return tHeader;
+	}
+
+	/** @brief writes point cloud as image payload */
+	inline void write_point_cloud_image(std::vector<uint8_t>& outputData, const PointCloud& outputCloud)
+	{
+		uint32_t tCount = static_cast<uint32_t>(outputCloud.size());
+		PointCloudImageHeader tHeader;
+		std::memset(&tHeader, 0, sizeof(tHeader));
+		tHeader.mVersion		= kPointCloudBinaryVersionImage;
+		tHeader.mCount			= tCount;
+		tHeader.mBodyIdOffset	= sizeof(tHeader);
+		tHeader.mXOffset		= tHeader.mBodyIdOffset + static_cast<uint32_t>(sizeof(outputCloud.mBodyId));
+		tHeader.mYOffset		= tHeader.mXOffset + tCount * static_cast<uint32_t>(sizeof(float));
+		tHeader.mStateOffset	= tHeader.mYOffset + tCount * static_cast<uint32_t>(sizeof(float));
+		tHeader.mJointOffset	= tHeader.mStateOffset + tCount;
+		tHeader.mBodyOffset		= tHeader.mJointOffset + tCount;
+		outputData.resize(tHeader.mBodyOffset + tCount);
+		// Write header and arrays:
+		uint8_t* tDst = &outputData[0];
+		std::memcpy(tDst, &tHeader, sizeof(tHeader));
+		std::memcpy(tDst + tHeader.mBodyIdOffset, outputCloud.mBodyId, sizeof(outputCloud.mBodyId));
+		std::memcpy(tDst + tHeader.mXOffset, outputCloud.mX, tCount * sizeof(float));
+		std::memcpy(tDst + tHeader.mYOffset, outputCloud.mY, tCount * sizeof(float));
+		std::memcpy(tDst + tHeader.mStateOffset, outputCloud.mState, tCount);
+		std::memcpy(tDst + tHeader.mJointOffset, outputCloud.mJoint, tCount);
+		std::memcpy(tDst + tHeader.mBodyOffset, outputCloud.mBody, tCount);
+	}
+
+	/** @brief reads point cloud from image payload */
+	inline void read_point_cloud_image(const uint8_t* inputData, size_t inputSize, PointCloud& outputCloud)
+	{
+		PointCloudImageHeader tHeader = read_point_cloud_image_header(inputData, inputSize);
+		std::memcpy(outputCloud.mBodyId, inputData + tHeader.mBodyIdOffset, sizeof(outputCloud.mBodyId));
+		std::memcpy(outputCloud.mX, inputData + tHeader.mXOffset, tHeader.mCount * sizeof(float));
+		std::memcpy(outputCloud.mY, inputData + tHeader.mYOffset, tHeader.mCount * sizeof(float));
+		std::memcpy(outputCloud.mState, inputData + tHeader.mStateOffset, tHeader.mCount);
+		std::memcpy(outputCloud.mJoint, inputData + tHeader.mJointOffset, tHeader.mCount);
+		std::memcpy(outputCloud.mBody, inputData + tHeader.mBodyOffset, tHeader.mCount);
+		outputCloud.mCount = tHeader.mCount;
+	}
+
+	/** @brief appends a point read from a legacy encoding (joints assumed in body order, fully tracked) */
+	inline void push_legacy_point(PointCloud& cloud, const ci::vec2& point)
+	{
+		uint8_t tJoint = static_cast<uint8_t>(cloud.size() % PointCloud::kJointCount);
+		uint8_t tBody  = static_cast<uint8_t>(cloud.size() / PointCloud::kJointCount);
+		if (!cloud.push_back(point, TrackingState::TrackingState_Tracked, tJoint, tBody)) {
+			throw std::runtime_error("Point cloud payload exceeds capacity");
+		}
+	}
+
+	/** @brief writes point cloud as legacy/export text ("x y" per line) */
+	inline void write_point_cloud_text(std::ostream& output, const PointCloud& cloud)
+	{
+		for (size_t i = 0; i < cloud.size(); i++) {
+			output << cloud.mX[i] << ' ' << cloud.mY[i] << '\n';
+		}
+	}
+
+	/** @brief reads point cloud from legacy/export text ("x y" per line) */
+	inline PointCloudRef read_point_cloud_text(const char* inputData, size_t inputSize)
+	{
+		PointCloudRef tOutput = std::make_shared<PointCloud>();
+		const char* tCurr = inputData;
+		const char* tEnd  = inputData + inputSize;
+		while (tCurr < tEnd) {
+			// Find end of line:
+			const char* tLineEnd = std::find(tCurr, tEnd, '\n');
+			std::string tLine(tCurr, tLineEnd);
+			tCurr = (tLineEnd < tEnd) ? (tLineEnd + 1) : tEnd;
+			if (!tLine.empty() && tLine.back() == '\r') tLine.pop_back();
+			if (tLine.empty()) continue;
+			// Find delimiter:
+			std::size_t tFind = tLine.find_first_of(' ');
+			if (tFind == std::string::npos) {
+				throw std::runtime_error("Could not read point cloud text");
+			}
+			push_legacy_point(*tOutput, ci::vec2(atof(tLine.substr(0, tFind).c_str()), atof(tLine.substr(tFind + 1).c_str())));
+		}
+		return tOutput;
+	}
+
+	/** @brief exports point cloud as text file ("x y" per line) */
+	inline void export_point_cloud_text(const ci::fs::path& outputPath, const PointCloud& cloud)
+	{
+		std::ofstream tFile(outputPath.string());
+		if (!tFile.is_open()) {
+			throw std::runtime_error("Could not open file: \'" + outputPath.string() + "\'");
+		}
+		write_point_cloud_text(tFile, cloud);
+	}
+
+	template<> inline std::string get_file_extension<PointCloudRef>()
+	{
+		return "pcb";
+	}
+
+	template<> inline size_t get_frame_bytes<PointCloudRef>(const PointCloudRef& item)
+	{
+		return sizeof( PointCloud );
+	}
+
+	/** @brief decodes a binary point cloud payload into given cloud; returns false for legacy text payloads */
+	inline bool read_point_cloud_binary(const uint8_t* inputData, size_t inputSize, PointCloud& outputCloud)
+	{
+		// Detect legacy text:
+		if (inputSize == 0 || (inputData[0] != kPointCloudBinaryVersion && inputData[0] != kPointCloudBinaryVersionPacked && inputData[0] != kPointCloudBinaryVersionQuantized && inputData[0] != kPointCloudBinaryVersionDelta && inputData[0] != kPointCloudBinaryVersionImage)) {
+			return false;
+		}
+		// Read image:
+		if (inputData[0] == kPointCloudBinaryVersionImage) {
+			read_point_cloud_image(inputData, inputSize, outputCloud);
+			return true;
+		}
+		// Read quantized keyframe (deltas need the preceding frames, see PointCloudDeltaDecoder):
+		if (inputData[0] == kPointCloudBinaryVersionDelta) {
+			throw std::runtime_error("Could not read point cloud delta payload without preceding frame");
+		}
+		if (inputData[0] == kPointCloudBinaryVersionQuantized) {
+			QuantizedPointCloud tQuantized;
+			read_point_cloud_quantized(inputData, inputSize, tQuantized);
+			tQuantized.get(outputCloud);
+			return true;
+		}
+		// Read header:
+		uint32_t tCount = 0;
+		if (inputSize < 8) {
+			throw std::runtime_error("Could not read point cloud payload");
+		}
+		std::memcpy(&tCount, inputData + 4, sizeof(tCount));
+		if (tCount > PointCloud::kCapacity) {
+			throw std::runtime_error("Point cloud payload exceeds capacity");
+		}
+		outputCloud.clear();
+		const uint8_t* tSrc = inputData + 8;
+		// Read interleaved points:
+		if (inputData[0] == kPointCloudBinaryVersionPacked) {
+			if (inputSize < 8 + size_t(tCount) * 2 * sizeof(float)) {
+				throw std::runtime_error("Could not read point cloud payload");
+			}
+			for (uint32_t i = 0; i < tCount; i++, tSrc += 2 * sizeof(float)) {
+				ci::vec2 tPoint;
+				std::memcpy(&tPoint.x, tSrc, sizeof(float));
+				std::memcpy(&tPoint.y, tSrc + sizeof(float), sizeof(float));
+				push_legacy_point(outputCloud, tPoint);
+			}
+			return true;
+		}
+		// Read arrays:
+		if (inputSize < 8 + sizeof(outputCloud.mBodyId) + size_t(tCount) * (2 * sizeof(float) + 3)) {
+			throw std::runtime_error("Could not read point cloud payload");
+		}
+		std::memcpy(outputCloud.mBodyId, tSrc, sizeof(outputCloud.mBodyId));	tSrc += sizeof(outputCloud.mBodyId);
+		std::memcpy(outputCloud.mX, tSrc, tCount * sizeof(float));				tSrc += tCount * sizeof(float);
+		std::memcpy(outputCloud.mY, tSrc, tCount * sizeof(float));				tSrc += tCount * sizeof(float);
+		std::memcpy(outputCloud.mState, tSrc, tCount);							tSrc += tCount;
+		std::memcpy(outputCloud.mJoint, tSrc, tCount);							tSrc += tCount;
+		std::memcpy(outputCloud.mBody, tSrc, tCount);
+		outputCloud.mCount = tCount;
+		return true;
+	}
+
+	template<> inline PointCloudRef read_from_buffer<PointCloudRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		PointCloudRef tOutput = std::make_shared<PointCloud>();
+		if (!read_point_cloud_binary(inputData, inputSize, *tOutput)) {
+			return read_point_cloud_text(reinterpret_cast<const char*>(inputData), inputSize);
+		}
+		return tOutput;
+	}
+
+	template<> inline PointCloudRef read_from_buffer_pooled<PointCloudRef>(const uint8_t* inputData, size_t inputSize, FramePoolT<PointCloudRef>& ioPool)
+	{
+		PointCloudRef tOutput = ioPool.acquire();
+		if (!read_point_cloud_binary(inputData, inputSize, *tOutput)) {
+			return read_point_cloud_text(reinterpret_cast<const char*>(inputData), inputSize);
+		}
+		return tOutput;
+	}
+
+	template<> inline void write_to_buffer<PointCloudRef>(std::vector<uint8_t>& outputData, const PointCloudRef& outputItem)
+	{
+		uint32_t tCount = static_cast<uint32_t>(outputItem->size());
+		outputData.assign(8 + sizeof(outputItem->mBodyId) + size_t(tCount) * (2 * sizeof(float) + 3), 0);
+		// Write header:
+		outputData[0] = kPointCloudBinaryVersion;
+		std::memcpy(&outputData[4], &tCount, sizeof(tCount));
+		// Write arrays:
+		uint8_t* tDst = &outputData[8];
+		std::memcpy(tDst, outputItem->mBodyId, sizeof(outputItem->mBodyId));	tDst += sizeof(outputItem->mBodyId);
+		std::memcpy(tDst, outputItem->mX, tCount * sizeof(float));				tDst += tCount * sizeof(float);
+		std::memcpy(tDst, outputItem->mY, tCount * sizeof(float));				tDst += tCount * sizeof(float);
+		std::memcpy(tDst, outputItem->mState, tCount);							tDst += tCount;
+		std::memcpy(tDst, outputItem->mJoint, tCount);							tDst += tCount;
+		std::memcpy(tDst, outputItem->mBody, tCount);
+	}
+
+	template<> struct FrameViewTraits<PointCloudRef>
+	{
+		static const bool kEnabled = true;
+		typedef PointCloudViewRef ConstRef;
+	};
+
+	template<> inline PointCloudViewRef view_from_buffer<PointCloudRef>(const uint8_t* inputData, size_t inputSize, const std::shared_ptr<const void>& iOwner)
+	{
+		// Decode payloads other than images (e.g. a container recorded unmapped):
+		if (inputSize == 0 || inputData[0] != kPointCloudBinaryVersionImage) {
+			return std::make_shared<PointCloudView>(read_from_buffer<PointCloudRef>(inputData, inputSize));
+		}
+		PointCloudImageHeader tHeader = read_point_cloud_image_header(inputData, inputSize);
+		if (reinterpret_cast<uintptr_t>(inputData + tHeader.mBodyIdOffset) % std::alignment_of<uint64_t>::value != 0
+			|| reinterpret_cast<uintptr_t>(inputData + tHeader.mXOffset) % std::alignment_of<float>::value != 0
+			|| reinterpret_cast<uintptr_t>(inputData + tHeader.mYOffset) % std::alignment_of<float>::value != 0) {
+			throw std::runtime_error("Point cloud image payload is not aligned");
+		}
+		// Point into mapping (view shares its ownership):
+		std::shared_ptr<PointCloudView> tView = std::make_shared<PointCloudView>();
+		tView->mBodyId	= reinterpret_cast<const uint64_t*>(inputData + tHeader.mBodyIdOffset);
+		tView->mX		= reinterpret_cast<const float*>(inputData + tHeader.mXOffset);
+		tView->mY		= reinterpret_cast<const float*>(inputData + tHeader.mYOffset);
+		tView->mState	= inputData + tHeader.mStateOffset;
+		tView->mJoint	= inputData + tHeader.mJointOffset;
+		tView->mBody	= inputData + tHeader.mBodyOffset;
+		tView->mCount	= tHeader.mCount;
+		tView->mOwner	= iOwner;
+		return tView;
+	}
+
+	template<> inline PointCloudRef read_from_file<PointCloudRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<PointCloudRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline PointCloudRef read_from_file_pooled<PointCloudRef>(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<PointCloudRef>& ioPool)
+	{
+		read_file_bytes(inputPath, ioBuffer);
+		return read_from_buffer_pooled<PointCloudRef>(ioBuffer.empty() ? NULL : &ioBuffer[0], ioBuffer.size(), ioPool);
+	}
+
+	template<> inline void write_to_file<PointCloudRef>(const ci::fs::path& outputPath, const PointCloudRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<PointCloudRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	static const uint32_t kChannelEncodingRaw	= 0; //!< channel payload holds tightly packed rows
+	static const uint32_t kChannelEncodingDelta	= 1; //!< channel payload holds a delta against the previous frame (see ChannelDelta.h)
+
+	/** @brief channel payload header (rows or delta follow, as given by encoding) */
+	struct ChannelPayloadHeader
+	{
+		uint32_t	mWidth;			//!< channel width (in pixels)
+		uint32_t	mHeight;		//!< channel height (in pixels)
+		uint32_t	mPixelBytes;	//!< bytes per pixel
+		uint32_t	mEncoding;		//!< kChannelEncodingRaw or kChannelEncodingDelta
+	};
+
+	/** @brief copies channel rows into tightly packed output pixels */
+	template<typename V> inline void pack_channel_rows(const ci::ChannelT<V>& inputChannel, V* outputPixels)
+	{
+		const size_t tWidth = inputChannel.getWidth();
+		for( int32_t y = 0; y < inputChannel.getHeight(); y++, outputPixels += tWidth ) {
+			const V* tSrc = inputChannel.getData( ci::ivec2( 0, y ) );
+			if( inputChannel.getIncrement() == 1 ) {
+				std::memcpy( outputPixels, tSrc, tWidth * sizeof( V ) );
+			}
+			else {
+				for( size_t x = 0; x < tWidth; x++ ) {
+					outputPixels[ x ] = tSrc[ x * inputChannel.getIncrement() ];
+				}
+			}
+		}
+	}
+
+	template<typename V> inline void write_channel_to_buffer(std::vector<uint8_t>& outputData, const ci::ChannelT<V>& outputItem)
+	{
+		// Write header:
+		ChannelPayloadHeader tHeader = { static_cast<uint32_t>( outputItem.getWidth() ), static_cast<uint32_t>( outputItem.getHeight() ), sizeof( V ), kChannelEncodingRaw };
+		size_t tRowBytes = tHeader.mWidth * sizeof( V );
+		outputData.resize( sizeof( tHeader ) + tRowBytes * tHeader.mHeight );
+		std::memcpy( &outputData[ 0 ], &tHeader, sizeof( tHeader ) );
+		// Write rows:
+		if( tRowBytes * tHeader.mHeight != 0 ) {
+			pack_channel_rows<V>( outputItem, reinterpret_cast<V*>( &outputData[ sizeof( tHeader ) ] ) );
+		}
+	}
+
+	template<typename V> inline const ChannelPayloadHeader& read_channel_header(const uint8_t* inputData, size_t inputSize)
+	{
+		const ChannelPayloadHeader* tHeader = reinterpret_cast<const ChannelPayloadHeader*>( inputData );
+		if( inputSize < sizeof( ChannelPayloadHeader ) || tHeader->mPixelBytes != sizeof( V ) || tHeader->mEncoding != kChannelEncodingRaw
+			|| inputSize < sizeof( ChannelPayloadHeader ) + size_t( tHeader->mWidth ) * tHeader->mHeight * sizeof( V ) ) {
+			throw std::runtime_error( "Could not read channel payload" );
+		}
+		return *tHeader;
+	}
+
+	template<typename V> inline void read_channel_rows(const uint8_t* inputData, const ChannelPayloadHeader& iHeader, ci::ChannelT<V>& outputChannel)
+	{
+		const uint8_t* tSrc = inputData + sizeof( ChannelPayloadHeader );
+		size_t tRowBytes = iHeader.mWidth * sizeof( V );
+		for( uint32_t y = 0; y < iHeader.mHeight; y++, tSrc += tRowBytes ) {
+			std::memcpy( outputChannel.getData( ci::ivec2( 0, y ) ), tSrc, tRowBytes );
+		}
+	}
+
+	template<typename V> inline std::shared_ptr<ci::ChannelT<V>> read_channel_from_buffer(const uint8_t* inputData, size_t inputSize)
+	{
+		const ChannelPayloadHeader& tHeader = read_channel_header<V>( inputData, inputSize );
+		std::shared_ptr<ci::ChannelT<V>> tOutput = ci::ChannelT<V>::create( tHeader.mWidth, tHeader.mHeight );
+		read_channel_rows<V>( inputData, tHeader, *tOutput );
+		return tOutput;
+	}
+
+	template<typename V> inline std::shared_ptr<ci::ChannelT<V>> read_channel_from_buffer_pooled(const uint8_t* inputData, size_t inputSize, FramePoolT<std::shared_ptr<ci::ChannelT<V>>>& ioPool)
+	{
+		const ChannelPayloadHeader& tHeader = read_channel_header<V>( inputData, inputSize );
+		std::shared_ptr<ci::ChannelT<V>> tOutput = acquire_channel<V>( ioPool, ci::ivec2( tHeader.mWidth, tHeader.mHeight ) );
+		read_channel_rows<V>( inputData, tHeader, *tOutput );
+		return tOutput;
+	}
+
+	/** @brief returns read-only channel wrapping the rows of a raw channel payload without copying; iOwner keeps the mapping alive */
+	template<typename V> inline std::shared_ptr<const ci::ChannelT<V>> view_channel_from_buffer(const uint8_t* inputData, size_t inputSize, const std::shared_ptr<const void>& iOwner)
+	{
+		const ChannelPayloadHeader& tHeader = read_channel_header<V>( inputData, inputSize );
+		const uint8_t* tPixels = inputData + sizeof( ChannelPayloadHeader );
+		if( reinterpret_cast<uintptr_t>( tPixels ) % std::alignment_of<V>::value != 0 ) {
+			throw std::runtime_error( "Channel payload is not aligned" );
+		}
+		// Channel only takes mutable pixels, but is handed out const (mapping is read-only; deleter keeps it alive):
+		return std::shared_ptr<const ci::ChannelT<V>>(
+			new ci::ChannelT<V>( tHeader.mWidth, tHeader.mHeight, tHeader.mWidth * sizeof( V ), 1, reinterpret_cast<V*>( const_cast<uint8_t*>( tPixels ) ) ),
+			[iOwner] ( const ci::ChannelT<V>* iChannel ) { delete iChannel; } );
+	}
+
+	template<> inline std::string get_file_extension<ci::Channel16uRef>()
+	{
+		return "r16";
+	}
+
+	template<> inline size_t get_frame_bytes<ci::Channel16uRef>(const ci::Channel16uRef& item)
+	{
+		return sizeof( ci::Channel16u ) + ( item ? item->getRowBytes() * item->getHeight() : 0 );
+	}
+
+	template<> inline ci::Channel16uRef read_from_buffer<ci::Channel16uRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		return read_channel_from_buffer<uint16_t>( inputData, inputSize );
+	}
+
+	template<> inline ci::Channel16uRef read_from_buffer_pooled<ci::Channel16uRef>(const uint8_t* inputData, size_t inputSize, FramePoolT<ci::Channel16uRef>& ioPool)
+	{
+		return read_channel_from_buffer_pooled<uint16_t>( inputData, inputSize, ioPool );
+	}
+
+	template<> inline void write_to_buffer<ci::Channel16uRef>(std::vector<uint8_t>& outputData, const ci::Channel16uRef& outputItem)
+	{
+		write_channel_to_buffer<uint16_t>( outputData, *outputItem );
+	}
+
+	template<> struct FrameViewTraits<ci::Channel16uRef>
+	{
+		static const bool kEnabled = true;
+		typedef std::shared_ptr<const ci::Channel16u> ConstRef;
+	};
+
+	template<> inline std::shared_ptr<const ci::Channel16u> view_from_buffer<ci::Channel16uRef>(const uint8_t* inputData, size_t inputSize, const std::shared_ptr<const void>& iOwner)
+	{
+		return view_channel_from_buffer<uint16_t>( inputData, inputSize, iOwner );
+	}
+
+	template<> inline ci::Channel16uRef read_from_file<ci::Channel16uRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<ci::Channel16uRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline ci::Channel16uRef read_from_file_pooled<ci::Channel16uRef>(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<ci::Channel16uRef>& ioPool)
+	{
+		read_file_bytes(inputPath, ioBuffer);
+		return read_from_buffer_pooled<ci::Channel16uRef>(ioBuffer.empty() ? NULL : &ioBuffer[0], ioBuffer.size(), ioPool);
+	}
+
+	template<> inline void write_to_file<ci::Channel16uRef>(const ci::fs::path& outputPath, const ci::Channel16uRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<ci::Channel16uRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	template<> inline std::string get_file_extension<ci::Channel8uRef>()
+	{
+		return "r8";
+	}
+
+	template<> inline size_t get_frame_bytes<ci::Channel8uRef>(const ci::Channel8uRef& item)
+	{
+		return sizeof( ci::Channel8u ) + ( item ? item->getRowBytes() * item->getHeight() : 0 );
+	}
+
+	template<> inline ci::Channel8uRef read_from_buffer<ci::Channel8uRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		return read_channel_from_buffer<uint8_t>( inputData, inputSize );
+	}
+
+	template<> inline ci::Channel8uRef read_from_buffer_pooled<ci::Channel8uRef>(const uint8_t* inputData, size_t inputSize, FramePoolT<ci::Channel8uRef>& ioPool)
+	{
+		return read_channel_from_buffer_pooled<uint8_t>( inputData, inputSize, ioPool );
+	}
+
+	template<> inline void write_to_buffer<ci::Channel8uRef>(std::vector<uint8_t>& outputData, const ci::Channel8uRef& outputItem)
+	{
+		write_channel_to_buffer<uint8_t>( outputData, *outputItem );
+	}
+
+	template<> struct FrameViewTraits<ci::Channel8uRef>
+	{
+		static const bool kEnabled = true;
+		typedef std::shared_ptr<const ci::Channel8u> ConstRef;
+	};
+
+	template<> inline std::shared_ptr<const ci::Channel8u> view_from_buffer<ci::Channel8uRef>(const uint8_t* inputData, size_t inputSize, const std::shared_ptr<const void>& iOwner)
+	{
+		return view_channel_from_buffer<uint8_t>( inputData, inputSize, iOwner );
+	}
+
+	template<> inline ci::Channel8uRef read_from_file<ci::Channel8uRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<ci::Channel8uRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline ci::Channel8uRef read_from_file_pooled<ci::Channel8uRef>(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<ci::Channel8uRef>& ioPool)
+	{
+		read_file_bytes(inputPath, ioBuffer);
+		return read_from_buffer_pooled<ci::Channel8uRef>(ioBuffer.empty() ? NULL : &ioBuffer[0], ioBuffer.size(), ioPool);
+	}
+
+	template<> inline void write_to_file<ci::Channel8uRef>(const ci::fs::path& outputPath, const ci::Channel8uRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<ci::Channel8uRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	/*
+	 * Body-index run payload (little-endian):
+	 *
+	 *   BodyIndexRlePayloadHeader
+	 *   uint16_t run count (height times, one per row)
+	 *   { uint16_t begin, uint16_t length, uint8_t value } (run count times)
+	 */
+
+	/** @brief body-index run payload header */
+	struct BodyIndexRlePayloadHeader
+	{
+		uint32_t	mWidth;		//!< frame width (in pixels)
+		uint32_t	mHeight;	//!< frame height (in pixels)
+		uint32_t	mRunCount;	//!< total number of runs
+		uint32_t	mReserved;	//!< zero
+	};
+
+	static const size_t kBodyIndexRleRunBytes = 5; //!< encoded size of one run (in bytes)
+
+	/** @brief decodes body-index run payload into given frame, reusing its storage */
+	inline void read_body_index_rle(const uint8_t* inputData, size_t inputSize, BodyIndexRle& outputItem)
+	{
+		BodyIndexRlePayloadHeader tHeader;
+		if( inputSize < sizeof( tHeader ) ) {
+			throw std::runtime_error( "Could not read body-index run payload" );
+		}
+		std::memcpy( &tHeader, inputData, sizeof( tHeader ) );
+		if( tHeader.mWidth > 0xFFFF || inputSize != sizeof( tHeader ) + size_t( tHeader.mHeight ) * 2 + size_t( tHeader.mRunCount ) * kBodyIndexRleRunBytes ) {
+			throw std::runtime_error( "Could not read body-index run payload" );
+		}
+		outputItem.mWidth	= static_cast<int32_t>( tHeader.mWidth );
+		outputItem.mHeight	= static_cast<int32_t>( tHeader.mHeight );
+		outputItem.mRowStarts.resize( size_t( tHeader.mHeight ) + 1 );
+		outputItem.mRuns.resize( tHeader.mRunCount );
+		// Read row run counts:
+		const uint8_t*	tCounts		= inputData + sizeof( tHeader );
+		uint32_t		tRunIndex	= 0;
+		for( uint32_t y = 0; y < tHeader.mHeight; y++ ) {
+			uint16_t tCount;
+			std::memcpy( &tCount, tCounts + y * 2, 2 );
+			outputItem.mRowStarts[ y ] = tRunIndex;
+			tRunIndex += tCount;
+		}
+		outputItem.mRowStarts[ tHeader.mHeight ] = tRunIndex;
+		if( tRunIndex != tHeader.mRunCount ) {
+			throw std::runtime_error( "Could not read body-index run payload" );
+		}
+		// Read runs:
+		const uint8_t* tRuns = tCounts + size_t( tHeader.mHeight ) * 2;
+		for( uint32_t i = 0; i < tHeader.mRunCount; i++, tRuns += kBodyIndexRleRunBytes ) {
+			BodyIndexRle::Run& tRun = outputItem.mRuns[ i ];
+			std::memcpy( &tRun.mBegin, tRuns, 2 );
+			std::memcpy( &tRun.mLength, tRuns + 2, 2 );
+			tRun.mValue = tRuns[ 4 ];
+			if( uint32_t( tRun.mBegin ) + tRun.mLength > tHeader.mWidth ) {
+				throw std::runtime_error( "Could not read body-index run payload with run outside frame" );
+			}
+		}
+	}
+
+	template<> inline std::string get_file_extension<BodyIndexRleRef>()
+	{
+		return "bir";
+	}
+
+	template<> inline size_t get_frame_bytes<BodyIndexRleRef>(const BodyIndexRleRef& item)
+	{
+		return sizeof( BodyIndexRle ) + ( item ? item->mRowStarts.capacity() * sizeof( uint32_t ) + item->mRuns.capacity() * sizeof( BodyIndexRle::Run ) : 0 );
+	}
+
+	template<> inline BodyIndexRleRef read_from_buffer<BodyIndexRleRef>(const uint8_t* inputData, size_t inputSize)
+	{
+		BodyIndexRleRef tOutput = std::make_shared<BodyIndexRle>();
+		read_body_index_rle( inputData, inputSize, *tOutput );
+		return tOutput;
+	}
+
+	template<> inline BodyIndexRleRef read_from_buffer_pooled<BodyIndexRleRef>(const uint8_t* inputData, size_t inputSize, FramePoolT<BodyIndexRleRef>& ioPool)
+	{
+		BodyIndexRleRef tOutput = ioPool.acquire();
+		read_body_index_rle( inputData, inputSize, *tOutput );
+		return tOutput;
+	}
+
+	template<> inline void write_to_buffer<BodyIndexRleRef>(std::vector<uint8_t>& outputData, const BodyIndexRleRef& outputItem)
+	{
+		// Write header:
+		BodyIndexRlePayloadHeader tHeader = { static_cast<uint32_t>( outputItem->mWidth ), static_cast<uint32_t>( outputItem->mHeight ), static_cast<uint32_t>( outputItem->mRuns.size() ), 0 };
+		outputData.resize( sizeof( tHeader ) + size_t( tHeader.mHeight ) * 2 + size_t( tHeader.mRunCount ) * kBodyIndexRleRunBytes );
+		std::memcpy( &outputData[ 0 ], &tHeader, sizeof( tHeader ) );
+		// Write row run counts:
+		uint8_t* tDst = &outputData[ sizeof( tHeader ) ];
+		for( int32_t y = 0; y < outputItem->mHeight; y++, tDst += 2 ) {
+			uint16_t tCount = static_cast<uint16_t>( outputItem->getRowRunCount( y ) );
+			std::memcpy( tDst, &tCount, 2 );
+		}
+		// Write runs:
+		for( const auto& tRun : outputItem->mRuns ) {
+			std::memcpy( tDst, &tRun.mBegin, 2 );
+			std::memcpy( tDst + 2, &tRun.mLength, 2 );
+			tDst[ 4 ] = tRun.mValue;
+			tDst += kBodyIndexRleRunBytes;
+		}
+	}
+
+	template<> inline BodyIndexRleRef read_from_file<BodyIndexRleRef>(const ci::fs::path& inputPath)
+	{
+		std::vector<uint8_t> tData;
+		read_file_bytes(inputPath, tData);
+		return read_from_buffer<BodyIndexRleRef>(tData.empty() ? NULL : &tData[0], tData.size());
+	}
+
+	template<> inline BodyIndexRleRef read_from_file_pooled<BodyIndexRleRef>(const ci::fs::path& inputPath, std::vector<uint8_t>& ioBuffer, FramePoolT<BodyIndexRleRef>& ioPool)
+	{
+		read_file_bytes(inputPath, ioBuffer);
+		return read_from_buffer_pooled<BodyIndexRleRef>(ioBuffer.empty() ? NULL : &ioBuffer[0], ioBuffer.size(), ioPool);
+	}
+
+	template<> inline void write_to_file<BodyIndexRleRef>(const ci::fs::path& outputPath, const BodyIndexRleRef& outputItem)
+	{
+		std::vector<uint8_t> tData;
+		write_to_buffer<BodyIndexRleRef>(tData, outputItem);
+		write_file_bytes(outputPath, tData);
+	}
+
+	static const size_t kDefaultKeyframeInterval = 30; //!< default number of frames per keyframe in temporally coded container tracks
+
+	/** @brief container codec settings of a track */
+	struct FrameCodecSettings
+	{
+		size_t mKeyframeInterval; //!< number of frames per keyframe (temporally coded types only; one writes raw keyframes only, which mapped tracks view in place)
+
+		/** @brief default constructor */
+		FrameCodecSettings() :
+			mKeyframeInterval( kDefaultKeyframeInterval )
+		{ /* no-op */ }
+	};
+
+	/** @brief container codec settings of a point cloud track */
+	struct PointCloudCodecSettings : public FrameCodecSettings
+	{
+		bool	mQuantize;	//!< true to store 16-bit fixed-point coordinates, delta coded between keyframes (false stores floats)
+		float	mScale;		//!< fixed-point steps per pixel (quantization error is at most half a step)
+
+		/** @brief default constructor */
+		PointCloudCodecSettings() :
+			mQuantize( false ),
+			mScale( kDefaultPointCloudScale )
+		{ /* no-op */ }
+	};
+
+	/** @brief encodes each frame of a container track on its own */
+	template<typename T> class StandaloneFrameEncoderT {
+	public:
+
+		typedef std::shared_ptr<StandaloneFrameEncoderT> Ref;
+
+	private:
+
+		/** @brief default constructor (frames are always keyframes) */
+		StandaloneFrameEncoderT(const FrameCodecSettings& = FrameCodecSettings(), TrackFormat = TrackFormat::CONTAINER)
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename StandaloneFrameEncoderT::Ref create(Args&& ... args)
+		{
+			return typename StandaloneFrameEncoderT::Ref( new StandaloneFrameEncoderT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief encodes frame into output buffer; returns container frame flags */
+		uint32_t encode(std::vector<uint8_t>& outputData, const T& outputItem)
+		{
+			write_to_buffer<T>( outputData, outputItem );
+			return kContainerFrameKeyframe;
+		}
+	};
+
+	/** @brief decodes each frame of a container track on its own */
+	template<typename T> class StandaloneFrameDecoderT {
+	public:
+
+		typedef std::shared_ptr<StandaloneFrameDecoderT> Ref;
+
+	private:
+
+		ContainerReader::Ref mContainer; //!< source container
+
+		/** @brief default constructor */
+		StandaloneFrameDecoderT(ContainerReader::Ref iContainer) :
+			mContainer( iContainer )
+		{ /* no-op */ }
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename StandaloneFrameDecoderT::Ref create(Args&& ... args)
+		{
+			return typename StandaloneFrameDecoderT::Ref( new StandaloneFrameDecoderT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns decoder for another consumer (standalone decoders hold no state) */
+		typename StandaloneFrameDecoderT::Ref fork() const
+		{
+			return create( mContainer );
+		}
+
+		/** @brief returns true if frames depend on preceding frames (never; mapped frames may be viewed in place) */
+		bool isTemporal() const
+		{
+			return false;
+		}
+
+		/** @brief returns index of frame decoding starts from (always the frame itself) */
+		size_t getKeyframe(size_t iFrame) const
+		{
+			return iFrame;
+		}
+
+		/** @brief decodes frame at index, using given buffer for its payload */
+		T decode(size_t iFrame, std::vector<uint8_t>& ioBuffer, FramePoolT<T>& ioPool)
+		{
+			mContainer->read( iFrame, ioBuffer );
+			return read_from_buffer_pooled<T>( ioBuffer.empty() ? NULL : &ioBuffer[ 0 ], ioBuffer.size(), ioPool );
+		}
+	};
+
+	/**
+	 * @brief encodes channel frames of a container track as keyframes plus deltas against the previous frame
+	 *
+	 * Every mKeyframeInterval-th frame is a raw keyframe (as written by write_channel_to_buffer); so is any
+	 * frame whose size changed, or whose delta would not be smaller than the raw frame. Frames must be
+	 * encoded in recording order.
+	 */
+	template<typename V> class ChannelDeltaEncoderT {
+	public:
+
+		typedef std::shared_ptr<ChannelDeltaEncoderT>	Ref;
+		typedef std::shared_ptr<ci::ChannelT<V>>		ChannelRef;
+
+	private:
+
+		size_t				mKeyframeInterval;	//!< number of frames per keyframe
+		size_t				mSinceKeyframe;		//!< number of frames encoded since last keyframe
+		ci::ivec2			mSize;				//!< size of previous frame
+		std::vector<V>		mPrev;				//!< previous frame (tightly packed; empty before first frame)
+		std::vector<V>		mCurr;				//!< current frame (tightly packed)
+
+		/** @brief default constructor */
+		ChannelDeltaEncoderT(const FrameCodecSettings& iSettings = FrameCodecSettings(), TrackFormat = TrackFormat::CONTAINER) :
+			mKeyframeInterval( iSettings.mKeyframeInterval > 0 ? iSettings.mKeyframeInterval : 1 ),
+			mSinceKeyframe( 0 ),
+			mSize( 0 )
+		{ /* no-op */ }
+
+		/** @brief writes current frame as keyframe */
+		uint32_t encode_keyframe(std::vector<uint8_t>& outputData)
+		{
+			ChannelPayloadHeader tHeader = { static_cast<uint32_t>( mSize.x ), static_cast<uint32_t>( mSize.y ), sizeof( V ), kChannelEncodingRaw };
+			outputData.resize( sizeof( tHeader ) + mCurr.size() * sizeof( V ) );
+			std::memcpy( &outputData[ 0 ], &tHeader, sizeof( tHeader ) );
+			if( ! mCurr.empty() ) {
+				std::memcpy( &outputData[ sizeof( tHeader ) ], &mCurr[ 0 ], mCurr.size() * sizeof( V ) );
+			}
+			mSinceKeyframe = 0;
+			return kContainerFrameKeyframe;
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename ChannelDeltaEncoderT::Ref create(Args&& ... args)
+		{
+			return typename ChannelDeltaEncoderT::Ref( new ChannelDeltaEncoderT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief encodes frame into output buffer; returns container frame flags */
+		uint32_t encode(std::vector<uint8_t>& outputData, const ChannelRef& outputItem)
+		{
+			// Pack frame:
+			bool tResized = ( outputItem->getSize() != mSize );
+			mSize = outputItem->getSize();
+			mCurr.resize( size_t( mSize.x ) * mSize.y );
+			if( ! mCurr.empty() ) {
+				pack_channel_rows<V>( *outputItem, &mCurr[ 0 ] );
+			}
+			uint32_t tFlags = 0;
+			// Write keyframe on first frame, size change or interval:
+			if( mPrev.empty() || tResized || mCurr.empty() || mSinceKeyframe + 1 >= mKeyframeInterval ) {
+				tFlags = encode_keyframe( outputData );
+			}
+			// Write delta, unless it is no smaller than keyframe:
+			else {
+				ChannelPayloadHeader tHeader = { static_cast<uint32_t>( mSize.x ), static_cast<uint32_t>( mSize.y ), sizeof( V ), kChannelEncodingDelta };
+				outputData.resize( sizeof( tHeader ) );
+				std::memcpy( &outputData[ 0 ], &tHeader, sizeof( tHeader ) );
+				write_channel_delta<V>( outputData, &mCurr[ 0 ], &mPrev[ 0 ], mCurr.size() );
+				if( outputData.size() >= sizeof( tHeader ) + mCurr.size() * sizeof( V ) ) {
+					tFlags = encode_keyframe( outputData );
+				}
+				else {
+					mSinceKeyframe++;
+				}
+			}
+			// Keep frame as reference for next delta:
+			mPrev.swap( mCurr );
+			return tFlags;
+		}
+	};
+
+	/**
+	 * @brief decodes channel frames written by ChannelDeltaEncoderT
+	 *
+	 * A frame is rebuilt from the nearest keyframe at or before it, unless the previously decoded frame
+	 * lies in between, in which case decoding continues from there (so forward playback applies one delta
+	 * per frame). Containers without keyframe flags hold raw frames only. Each decoder holds one reconstruction
+	 * buffer, so concurrent consumers (playback, read-ahead, offline jobs) decode through their own fork().
+	 */
+	template<typename V> class ChannelDeltaDecoderT {
+	public:
+
+		typedef std::shared_ptr<ChannelDeltaDecoderT>	Ref;
+		typedef std::shared_ptr<ci::ChannelT<V>>		ChannelRef;
+
+	private:
+
+		ContainerReader::Ref	mContainer;	//!< source container
+		std::shared_ptr<const std::vector<size_t>>	mKeyframes;	//!< indices of keyframes (sorted; shared with forks)
+		std::mutex				mMutex;		//!< serializes decoding
+		ci::ivec2				mSize;		//!< size of decoded frame
+		std::vector<V>			mFrame;		//!< decoded frame (tightly packed)
+		size_t					mIndex;		//!< index of decoded frame
+		bool					mHasFrame;	//!< true if decoded frame is valid
+
+		/** @brief default constructor */
+		ChannelDeltaDecoderT(ContainerReader::Ref iContainer) :
+			mContainer( iContainer ),
+			mKeyframes( new std::vector<size_t>( get_container_keyframes( iContainer->getIndex() ) ) ),
+			mSize( 0 ),
+			mIndex( 0 ),
+			mHasFrame( false )
+		{ /* no-op */ }
+
+		/** @brief fork constructor (shares keyframe index) */
+		ChannelDeltaDecoderT(ContainerReader::Ref iContainer, const std::shared_ptr<const std::vector<size_t>>& iKeyframes) :
+			mContainer( iContainer ),
+			mKeyframes( iKeyframes ),
+			mSize( 0 ),
+			mIndex( 0 ),
+			mHasFrame( false )
+		{ /* no-op */ }
+
+		/** @brief applies frame at index to decoded frame (expects lock to be held) */
+		void apply_frame(size_t iFrame, std::vector<uint8_t>& ioBuffer)
+		{
+			// Get payload from mapping, or read it into buffer:
+			const uint8_t*	tData;
+			size_t			tSize;
+			if( mContainer->isMapped() ) {
+				tData = mContainer->getPayload( iFrame );
+				tSize = static_cast<size_t>( mContainer->getIndex()[ iFrame ].mSize );
+			}
+			else {
+				mContainer->read( iFrame, ioBuffer );
+				tData = ioBuffer.empty() ? NULL : &ioBuffer[ 0 ];
+				tSize = ioBuffer.size();
+			}
+			if( tSize < sizeof( ChannelPayloadHeader ) ) {
+				throw std::runtime_error( "Could not read channel payload" );
+			}
+			ChannelPayloadHeader tHeader;
+			std::memcpy( &tHeader, tData, sizeof( tHeader ) );
+			ci::ivec2 tFrameSize( tHeader.mWidth, tHeader.mHeight );
+			// Replace frame with keyframe:
+			if( tHeader.mEncoding == kChannelEncodingRaw ) {
+				read_channel_header<V>( tData, tSize );
+				mSize = tFrameSize;
+				mFrame.resize( size_t( mSize.x ) * mSize.y );
+				if( ! mFrame.empty() ) {
+					std::memcpy( &mFrame[ 0 ], tData + sizeof( tHeader ), mFrame.size() * sizeof( V ) );
+				}
+			}
+			// Apply delta to previous frame:
+			else if( tHeader.mEncoding == kChannelEncodingDelta && tHeader.mPixelBytes == sizeof( V ) && mHasFrame && tFrameSize == mSize && ! mFrame.empty() ) {
+				read_channel_delta<V>( tData + sizeof( tHeader ), tSize - sizeof( tHeader ), &mFrame[ 0 ], mFrame.size() );
+			}
+			else {
+				throw std::runtime_error( "Could not read channel delta payload without preceding frame" );
+			}
+			mHasFrame = true;
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static typename ChannelDeltaDecoderT::Ref create(Args&& ... args)
+		{
+			return typename ChannelDeltaDecoderT::Ref( new ChannelDeltaDecoderT( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns decoder for another consumer, sharing container and keyframe index but with its own reconstruction state */
+		typename ChannelDeltaDecoderT::Ref fork() const
+		{
+			return typename ChannelDeltaDecoderT::Ref( new ChannelDeltaDecoderT( mContainer, mKeyframes ) );
+		}
+
+		/** @brief returns true if any frame is a delta (mapped tracks of raw keyframes only are viewed in place) */
+		bool isTemporal() const
+		{
+			return mKeyframes->size() < mContainer->size();
+		}
+
+		/** @brief returns index of nearest keyframe at or before frame (the frame itself if there is none) */
+		size_t getKeyframe(size_t iFrame) const
+		{
+			std::vector<size_t>::const_iterator tKeyframe = std::upper_bound( mKeyframes->begin(), mKeyframes->end(), iFrame );
+			return ( tKeyframe != mKeyframes->begin() ) ? *( tKeyframe - 1 ) : iFrame;
+		}
+
+		/** @brief decodes frame at index, using given buffer for payloads */
+		ChannelRef decode(size_t iFrame, std::vector<uint8_t>& ioBuffer, FramePoolT<ChannelRef>& ioPool)
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			// Find nearest keyframe at or before frame:
+			size_t tStart = getKeyframe( iFrame );
+			// Continue from decoded frame, if it lies between keyframe and frame:
+			if( mHasFrame && mIndex >= tStart && mIndex <= iFrame ) {
+				tStart = mIndex + 1;
+			}
+			else {
+				mHasFrame = false;
+			}
+			// Apply frames:
+			try {
+				for( size_t i = tStart; i <= iFrame; i++ ) {
+					apply_frame( i, ioBuffer );
+				}
+			}
+			catch( ... ) {
+				mHasFrame = false;
+				throw;
+			}
+			mIndex = iFrame;
+			// Copy decoded frame into pooled channel:
+			ChannelRef tOutput = acquire_channel<V>( ioPool, mSize );
+			for( int32_t y = 0; y < mSize.y; y++ ) {
+				std::memcpy( tOutput->getData( ci::ivec2( 0, y ) ), &mFrame[ size_t( y ) * mSize.x ], mSize.x * sizeof( V ) );
+			}
+			return tOutput;
+		}
+	};
+
+	/**
+	 * @brief encodes point cloud frames of a container track, quantized as keyframes plus deltas if enabled
+	 *
+	 * With PointCloudCodecSettings::mQuantize set, every mKeyframeInterval-th frame is a quantized keyframe;
+	 * so is any frame whose point count or body ids changed, or whose delta would not be smaller than the
+	 * keyframe. Frames that do not fit the fixed-point range, and all frames when quantization is disabled,
+	 * are written as float payloads (which also act as keyframes); mapped tracks write these as images, which
+	 * playback views in place. Frames must be encoded in recording order.
+	 */
+	class PointCloudDeltaEncoder {
+	public:
+
+		typedef std::shared_ptr<PointCloudDeltaEncoder> Ref;
+
+	private:
+
+		PointCloudCodecSettings	mSettings;		//!< codec settings
+		bool					mImage;			//!< true to write float frames as images (mapped tracks)
+		size_t					mSinceKeyframe;	//!< number of frames encoded since last keyframe
+		bool					mHasPrev;		//!< true if previous frame was quantized
+		QuantizedPointCloud		mPrev;			//!< previous frame
+		QuantizedPointCloud		mCurr;			//!< current frame
+
+		/** @brief default constructor */
+		PointCloudDeltaEncoder(const PointCloudCodecSettings& iSettings = PointCloudCodecSettings(), TrackFormat iFormat = TrackFormat::CONTAINER) :
+			mSettings( iSettings ),
+			mImage( iFormat == TrackFormat::MAPPED ),
+			mSinceKeyframe( 0 ),
+			mHasPrev( false )
+		{
+			if( mSettings.mKeyframeInterval == 0 ) mSettings.mKeyframeInterval = 1;
+			// Store floats if scale is not positive and finite:
+			if( !( mSettings.mScale > 0.0f && mSettings.mScale < std::numeric_limits<float>::infinity() ) ) {
+				mSettings.mQuantize = false;
+			}
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static PointCloudDeltaEncoder::Ref create(Args&& ... args)
+		{
+			return PointCloudDeltaEncoder::Ref( new PointCloudDeltaEncoder( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief encodes frame into output buffer; returns container frame flags */
+		uint32_t encode(std::vector<uint8_t>& outputData, const PointCloudRef& outputItem)
+		{
+			// Write float keyframe if quantization is disabled or frame does not fit (as image on mapped tracks, so it can be viewed in place):
+			if( ! mSettings.mQuantize || ! mCurr.set( *outputItem, mSettings.mScale ) ) {
+				if( mImage ) {
+					write_point_cloud_image( outputData, *outputItem );
+				}
+				else {
+					write_to_buffer<PointCloudRef>( outputData, outputItem );
+				}
+				mHasPrev = false;
+				return kContainerFrameKeyframe;
+			}
+			uint32_t tFlags = 0;
+			// Write delta, unless a keyframe is due or delta is no smaller than keyframe:
+			if( mHasPrev && mSinceKeyframe + 1 < mSettings.mKeyframeInterval && mCurr.size() == mPrev.size() && std::memcmp( mCurr.mBodyId, mPrev.mBodyId, sizeof( mCurr.mBodyId ) ) == 0 ) {
+				write_point_cloud_delta( outputData, mCurr, mPrev );
+				if( outputData.size() < sizeof( PointCloudQuantizedHeader ) + sizeof( mCurr.mBodyId ) + mCurr.mValues.size() * sizeof( uint16_t ) ) {
+					mSinceKeyframe++;
+				}
+				else {
+					tFlags = kContainerFrameKeyframe;
+				}
+			}
+			else {
+				tFlags = kContainerFrameKeyframe;
+			}
+			// Write quantized keyframe:
+			if( tFlags & kContainerFrameKeyframe ) {
+				write_point_cloud_quantized( outputData, mCurr );
+				mSinceKeyframe = 0;
+			}
+			// Keep frame as reference for next delta:
+			std::swap( mPrev, mCurr );
+			mHasPrev = true;
+			return tFlags;
+		}
+	};
+
+	/**
+	 * @brief decodes point cloud frames written by PointCloudDeltaEncoder
+	 *
+	 * Follows ChannelDeltaDecoderT: a frame is rebuilt from the nearest keyframe at or before it, or from
+	 * the previously decoded frame if that lies in between. Concurrent consumers decode through their own fork().
+	 */
+	class PointCloudDeltaDecoder {
+	public:
+
+		typedef std::shared_ptr<PointCloudDeltaDecoder> Ref;
+
+	private:
+
+		ContainerReader::Ref	mContainer;	//!< source container
+		std::shared_ptr<const std::vector<size_t>>	mKeyframes;	//!< indices of keyframes (sorted; shared with forks)
+		std::mutex				mMutex;		//!< serializes decoding
+		QuantizedPointCloud		mQuantized;	//!< decoded frame, if quantized
+		PointCloud				mCloud;		//!< decoded frame
+		size_t					mIndex;		//!< index of decoded frame
+		bool					mHasFrame;	//!< true if decoded frame is valid
+		bool					mHasQuantized; //!< true if decoded frame is quantized (so a delta may follow)
+
+		/** @brief default constructor */
+		PointCloudDeltaDecoder(ContainerReader::Ref iContainer) :
+			mContainer( iContainer ),
+			mKeyframes( new std::vector<size_t>( get_container_keyframes( iContainer->getIndex() ) ) ),
+			mIndex( 0 ),
+			mHasFrame( false ),
+			mHasQuantized( false )
+		{ /* no-op */ }
+
+		/** @brief fork constructor (shares keyframe index) */
+		PointCloudDeltaDecoder(ContainerReader::Ref iContainer, const std::shared_ptr<const std::vector<size_t>>& iKeyframes) :
+			mContainer( iContainer ),
+			mKeyframes( iKeyframes ),
+			mIndex( 0 ),
+			mHasFrame( false ),
+			mHasQuantized( false )
+		{ /* no-op */ }
+
+		/** @brief applies frame at index to decoded frame (expects lock to be held) */
+		void apply_frame(size_t iFrame, std::vector<uint8_t>& ioBuffer)
+		{
+			// Get payload from mapping, or read it into buffer:
+			const uint8_t*	tData;
+			size_t			tSize;
+			if( mContainer->isMapped() ) {
+				tData = mContainer->getPayload( iFrame );
+				tSize = static_cast<size_t>( mContainer->getIndex()[ iFrame ].mSize );
+			}
+			else {
+				mContainer->read( iFrame, ioBuffer );
+				tData = ioBuffer.empty() ? NULL : &ioBuffer[ 0 ];
+				tSize = ioBuffer.size();
+			}
+			// Apply delta to previous frame:
+			if( tSize > 0 && tData[ 0 ] == kPointCloudBinaryVersionDelta ) {
+				if( ! mHasFrame || ! mHasQuantized ) {
+					throw std::runtime_error( "Could not read point cloud delta payload without preceding frame" );
+				}
+				read_point_cloud_delta( tData, tSize, mQuantized );
+				mQuantized.get( mCloud );
+			}
+			// Replace frame with quantized keyframe:
+			else if( tSize > 0 && tData[ 0 ] == kPointCloudBinaryVersionQuantized ) {
+				read_point_cloud_quantized( tData, tSize, mQuantized );
+				mQuantized.get( mCloud );
+				mHasQuantized = true;
+			}
+			// Replace frame with float or legacy frame:
+			else {
+				mHasQuantized = false;
+				if( ! read_point_cloud_binary( tData, tSize, mCloud ) ) {
+					mCloud = *read_point_cloud_text( reinterpret_cast<const char*>( tData ), tSize );
+				}
+			}
+			mHasFrame = true;
+		}
+
+	public:
+
+		/** @brief static creational method */
+		template <typename ... Args> static PointCloudDeltaDecoder::Ref create(Args&& ... args)
+		{
+			return PointCloudDeltaDecoder::Ref( new PointCloudDeltaDecoder( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns decoder for another consumer, sharing container and keyframe index but with its own reconstruction state */
+		PointCloudDeltaDecoder::Ref fork() const
+		{
+			return PointCloudDeltaDecoder::Ref( new PointCloudDeltaDecoder( mContainer, mKeyframes ) );
+		}
 
-	struct PointCloud
-	{
-		std::deque<ci::vec2> mPoints;
+		/** @brief returns true if any frame is a delta (mapped tracks without deltas are viewed in place) */
+		bool isTemporal() const
+		{
+			return mKeyframes->size() < mContainer->size();
+		}
 
-		PointCloud()
+		/** @brief returns index of nearest keyframe at or before frame (the frame itself if there is none) */
+		size_t getKeyframe(size_t iFrame) const
 		{
-			/* no-op */
+			std::vector<size_t>::const_iterator tKeyframe = std::upper_bound( mKeyframes->begin(), mKeyframes->end(), iFrame );
+			return ( tKeyframe != mKeyframes->begin() ) ? *( tKeyframe - 1 ) : iFrame;
 		}
 
-		PointCloud(const Kinect2::BodyFrame& frame, const Kinect2::DeviceRef& device, bool includeAll = true)
+		/** @brief decodes frame at index, using given buffer for payloads */
+		PointCloudRef decode(size_t iFrame, std::vector<uint8_t>& ioBuffer, FramePoolT<PointCloudRef>& ioPool)
 		{
-			for (const Kinect2::Body& body : frame.getBodies()) {
-				if (body.isTracked()) {
-					for (const auto& joint : body.getJointMap()) {
-						if (includeAll || joint.second.getTrackingState() == TrackingState::TrackingState_Tracked) {
-							mPoints.push_back(device->mapCameraToDepth(joint.second.getPosition()));
-						}
-					}
+			std::lock_guard<std::mutex> tLock( mMutex );
+			// Find nearest keyframe at or before frame:
+			size_t tStart = getKeyframe( iFrame );
+			// Continue from decoded frame, if it lies between keyframe and frame:
+			if( mHasFrame && mIndex >= tStart && mIndex <= iFrame ) {
+				tStart = mIndex + 1;
+			}
+			else {
+				mHasFrame = false;
+			}
+			// Apply frames:
+			try {
+				for( size_t i = tStart; i <= iFrame; i++ ) {
+					apply_frame( i, ioBuffer );
 				}
 			}
+			catch( ... ) {
+				mHasFrame = false;
+				throw;
+			}
+			mIndex = iFrame;
+			// Copy decoded frame into pooled cloud:
+			PointCloudRef tOutput = ioPool.acquire();
+			*tOutput = mCloud;
+			return tOutput;
 		}
 	};
-	
-	template<typename T> inline std::string get_file_extension() { /* no-op */ }
-	template<typename T> inline T read_from_file(const ci::fs::path& inputPath) { /* no-op */ }
-	template<typename T> inline void write_to_file(const ci::fs::path& outputPath, const T& outputItem) { /* no-op */ }
-	
-	template<> inline std::string get_file_extension<ci::SurfaceRef>()
-	{
-		return "png";
-	}
 
-	template<> inline ci::SurfaceRef read_from_file<ci::SurfaceRef>(const ci::fs::path& inputPath)
-	{
-		return ci::Surface::create( ci::loadImage( inputPath ) );
-	}
-	
-	template<> inline void write_to_file<ci::SurfaceRef>(const ci::fs::path& outputPath, const ci::SurfaceRef& outputItem)
+	/**
+	 * @brief selects how container tracks of a frame type are encoded and decoded
+	 *
+	 * Depth and body-index channels are delta coded against the previous frame, with a raw keyframe every
+	 * TrackT::getKeyframeInterval() frames; seeking decodes from the nearest keyframe, located through the
+	 * keyframe flags of the container index. Point clouds are delta coded the same way once quantization is
+	 * enabled in the track's PointCloudCodecSettings. File sequences always hold standalone frames.
+	 */
+	template<typename T> struct FrameCodecTraits
 	{
-		ci::writeImage( outputPath, *outputItem );
-	}
+		typedef StandaloneFrameEncoderT<T>	Encoder;
+		typedef StandaloneFrameDecoderT<T>	Decoder;
+		typedef FrameCodecSettings			Settings;
+	};
 
-	template<> inline std::string get_file_extension<PointCloudRef>()
+	template<> struct FrameCodecTraits<ci::Channel16uRef>
 	{
-		return "txt";
-	}
+		typedef ChannelDeltaEncoderT<uint16_t>	Encoder;
+		typedef ChannelDeltaDecoderT<uint16_t>	Decoder;
+		typedef FrameCodecSettings				Settings;
+	};
 
-	template<> inline PointCloudRef read_from_file<PointCloudRef>(const ci::fs::path& inputPath)
+	template<> struct FrameCodecTraits<ci::Channel8uRef>
 	{
-		// Try to open file:
-		std::ifstream tFile(inputPath.string());
-		// Handle info file:
-		if (tFile.is_open()) {
-			// Initialize output:
-			PointCloudRef tOutput = std::make_shared<PointCloud>();
-			// Iterate over each line in info file:
-			std::string tTemp;
-			while (std::getline(tFile, tTemp)) {
-				// Find delimiter:
-				std::size_t tFind = tTemp.find_first_of(' ');
-				// Handle frame:
-				if (tFind != std::string::npos) {
-					tOutput->mPoints.push_back(ci::vec2(atof(tTemp.substr(0, tFind).c_str()), atof(tTemp.substr(tFind + 1).c_str())));
-				}
-				// Handle error:
-				else {
-					throw std::runtime_error("Could not read file: \'" + inputPath.string() + "\'");
-				}
-			} 
-			// Close info file:
-			tFile.close();
-			// Return point cloud:
-			return tOutput;
-		}
-		// Handle file-open error:
-		throw std::runtime_error("Could not open file: \'" + inputPath.string() + "\'");
-	}
+		typedef ChannelDeltaEncoderT<uint8_t>	Encoder;
+		typedef ChannelDeltaDecoderT<uint8_t>	Decoder;
+		typedef FrameCodecSettings				Settings;
+	};
 
-	template<> inline void write_to_file<PointCloudRef>(const ci::fs::path& outputPath, const PointCloudRef& outputItem)
+	template<> struct FrameCodecTraits<PointCloudRef>
 	{
-		std::ofstream tFile;
-		tFile.open(outputPath.string());
-		for (const auto& pt : outputItem->mPoints) {
-			tFile << pt.x << ' ' << pt.y << std::endl;
-		}
-		tFile.close();
-	}
+		typedef PointCloudDeltaEncoder		Encoder;
+		typedef PointCloudDeltaDecoder		Decoder;
+		typedef PointCloudCodecSettings		Settings;
+	};
 
 	/** @brief templated track type */
 	template <typename T> class TrackT : public Track {
@@ -109,6 +1551,8 @@ namespace itp { namespace multitrack {
 
 		typedef std::function<T(void)>				RecorderCallback;
 		typedef std::function<void(const T&)>		PlayerCallback;
+		typedef typename FrameViewTraits<T>::ConstRef	ConstFrame;
+		typedef std::function<void(const ConstFrame&)>	ViewCallback;
 
 		/** @brief track player */
 		class Player : public TrackBase {
@@ -122,6 +1566,10 @@ namespace itp { namespace multitrack {
 			typedef FrameInfoVec::iterator			FrameInfoIter;
 			typedef FrameInfoVec::const_iterator	FrameInfoConstIter;
 
+			typedef FrameCacheT<T>					FrameCache;
+			typedef FramePrefetcherT<T>				FramePrefetcher;
+			typedef typename FrameCodecTraits<T>::Decoder	FrameDecoder;
+
 		private:
 
 			typename TrackT::Ref	mTrack;
@@ -130,6 +1578,21 @@ namespace itp { namespace multitrack {
 			PlayerCallback			mPlayerCallback;
 			double					mKeyTimeCurr;
 			double					mKeyTimeNext;
+			ContainerReader::Ref	mContainer;		//!< container reader (container formats only)
+			typename FrameDecoder::Ref	mDecoder;	//!< container frame decoder for draw thread (container formats only)
+			std::vector<uint8_t>	mReadBuffer;	//!< reusable payload buffer
+			typename FrameCache::Ref	mCache;		//!< decoded-frame cache
+			T						mLastFrame;		//!< last frame handed to player callback
+			ConstFrame				mLastView;		//!< view of frame last handed to view callback
+			size_t					mViewIndex;		//!< index of frame viewed in mLastView
+			size_t					mLastIndex;		//!< index of frame at iterator during previous update
+			int						mDirection;		//!< playback direction (+1 forward, -1 reverse)
+			uint64_t				mUnderrunCount;	//!< draws that held the previous frame because read-ahead fell behind
+			bool					mOffline;		//!< offline flag (frames are decoded synchronously and never held)
+			bool					mActive;		//!< activity flag (read-ahead only runs between start and stop)
+			std::map<size_t, T>		mOfflineFrames;	//!< frames decoded by offline jobs for current render batch (outside of cache budget)
+			std::mutex				mOfflineMutex;	//!< guards offline frames against decode jobs
+			typename FramePrefetcher::Ref	mPrefetcher; //!< read-ahead decoder (declared last, so it stops first)
 			
 			Player(typename TrackT::Ref iTrack, PlayerCallback iPlayerCallback) :
 				mTrack( iTrack ),
@@ -137,13 +1600,179 @@ namespace itp { namespace multitrack {
 				mInfoVec( FrameInfoVec() ),
 				mInfoIterator( mInfoVec.end() ),
 				mKeyTimeCurr( 0.0 ),
-				mKeyTimeNext( 0.0 )
+				mKeyTimeNext( 0.0 ),
+				mCache( FrameCache::create( iTrack->getCacheBudget() ) ),
+				mViewIndex( 0 ),
+				mLastIndex( 0 ),
+				mDirection( 1 ),
+				mUnderrunCount( 0 ),
+				mOffline( iTrack->isOffline() ),
+				mActive( false )
 			{
 				/* no-op */
 			}
 
+			/** @brief returns decoded frame at iterator, from prefetcher or cache when possible */
+			T get_frame(FrameInfoConstIter iFrame)
+			{
+				size_t tIndex = static_cast<size_t>( iFrame - mInfoVec.cbegin() );
+				T tItem;
+				// Take frame decoded by offline jobs:
+				if( mOffline ) {
+					std::lock_guard<std::mutex> tLock( mOfflineMutex );
+					typename std::map<size_t, T>::const_iterator tFind = mOfflineFrames.find( tIndex );
+					if( tFind != mOfflineFrames.end() ) {
+						return ( mLastFrame = tFind->second );
+					}
+				}
+				// Take ready frame from prefetcher, or hold last frame on underrun:
+				if( mPrefetcher ) {
+					if( mPrefetcher->acquire( tIndex, tItem ) ) {
+						return ( mLastFrame = tItem );
+					}
+					if( mLastFrame ) {
+						mUnderrunCount++;
+						return mLastFrame;
+					}
+				}
+				// Try cache:
+				else if( mCache->get( tIndex, tItem ) ) {
+					return ( mLastFrame = tItem );
+				}
+				// Decode and cache:
+				tItem = read_frame( tIndex, mReadBuffer, mDecoder );
+				mCache->put( tIndex, tItem, get_frame_bytes<T>( tItem ) );
+				return ( mLastFrame = tItem );
+			}
+
+			/** @brief reads and decodes frame at index, using given buffer for container payloads and given decoder (one per consumer thread) */
+			T read_frame(size_t tIndex, std::vector<uint8_t>& ioBuffer, const typename FrameDecoder::Ref& iDecoder)
+			{
+				// Handle file sequence:
+				if( ! mContainer ) {
+					return read_from_file_pooled<T>( mTrack->getDirectory() / mInfoVec[ tIndex ].second, ioBuffer, *mTrack->getPool() );
+				}
+				// Handle container (delta frames are decoded from the nearest keyframe):
+				return iDecoder->decode( tIndex, ioBuffer, *mTrack->getPool() );
+			}
+
+			/** @brief starts read-ahead decoder, unless disabled or not needed */
+			void start_prefetcher()
+			{
+				stop_prefetcher();
+				if( mOffline || mTrack->getPrefetchDepth() == 0 || mInfoVec.empty() || has_views() ) return;
+				// Worker decodes into its own payload buffer, through its own decoder:
+				std::shared_ptr<std::vector<uint8_t>> tBuffer = std::make_shared<std::vector<uint8_t>>();
+				typename FrameDecoder::Ref tDecoder = mDecoder ? mDecoder->fork() : typename FrameDecoder::Ref();
+				mPrefetcher = FramePrefetcher::create(
+					mCache,
+					[this, tBuffer, tDecoder] ( size_t iIndex ) { return read_frame( iIndex, *tBuffer, tDecoder ); },
+					[] ( const T& iItem ) { return get_frame_bytes<T>( iItem ); },
+					mInfoVec.size(),
+					mTrack->getPrefetchDepth() );
+			}
+
+			/** @brief stops read-ahead decoder */
+			void stop_prefetcher()
+			{
+				if( mPrefetcher ) {
+					mPrefetcher->stop();
+					mPrefetcher.reset();
+				}
+			}
+
+			/** @brief returns read-only view of frame at iterator (only the view of the frame shown is held) */
+			ConstFrame get_view(FrameInfoConstIter iFrame)
+			{
+				size_t tIndex = static_cast<size_t>( iFrame - mInfoVec.cbegin() );
+				if( ! mLastView || mViewIndex != tIndex ) {
+					mLastView = view_from_buffer<T>( mContainer->getPayload( tIndex ), static_cast<size_t>( mContainer->getIndex()[ tIndex ].mSize ), mContainer->getMapping() );
+					mViewIndex = tIndex;
+				}
+				return mLastView;
+			}
+
+			/** @brief returns true if frames are handed to the view callback in place of decoded frames (mapped, standalone frames of viewable types only) */
+			bool has_views() const
+			{
+				return FrameViewTraits<T>::kEnabled && mTrack->getViewCallback() && mContainer && mContainer->isMapped() && ! mDecoder->isTemporal();
+			}
+
+			/** @brief loads frame info from text info file */
+			void load_info_file()
+			{
+				// Try to open info file:
+				std::ifstream tInfoFile( mTrack->getInfoPath().string() );
+				// Handle info file:
+				if( tInfoFile.is_open() ) {
+					std::string tTemp;
+					// Iterate over each line in info file:
+					while( std::getline( tInfoFile, tTemp ) ) {
+						// Find delimiter:
+						std::size_t tFind = tTemp.find_first_of( ' ' );
+						// Handle frame:
+						if( tFind != std::string::npos ) {
+							mInfoVec.push_back( FrameInfo( atof( tTemp.substr( 0, tFind ).c_str() ), tTemp.substr( tFind + 1 ) ) );
+						}
+						// Handle error:
+						else {
+							throw std::runtime_error( "Player could not read file: \'" + mTrack->getInfoPath().string() + "\'" );
+						}
+					}
+					// Close info file:
+					tInfoFile.close();
+				}
+				// Handle file-open error:
+				else {
+					throw std::runtime_error( "Player could not open file: \'" + mTrack->getInfoPath().string() + "\'" );
+				}
+			}
+
+			/** @brief loads frame info from container index */
+			void load_container(bool iMapped)
+			{
+				mContainer = ContainerReader::create( mTrack->getContainerPath(), iMapped );
+				mDecoder = FrameDecoder::create( mContainer );
+				const ContainerIndex& tIndex = mContainer->getIndex();
+				mInfoVec.reserve( tIndex.size() );
+				for( const auto& tEntry : tIndex ) {
+					mInfoVec.push_back( FrameInfo( tEntry.mTime, std::string() ) );
+				}
+			}
+
+			/** @brief moves iterator to last frame at or before local playhead (in seconds) */
+			void seek(double iLocalPlayhead)
+			{
+				FrameInfoIter tNext;
+				// Fast path for regular playback (next frame):
+				if( mInfoIterator != mInfoVec.end() && iLocalPlayhead >= mKeyTimeNext && ( mInfoIterator + 1 ) != mInfoVec.end()
+					&& ( ( mInfoIterator + 2 ) == mInfoVec.end() || iLocalPlayhead < ( mInfoIterator + 2 )->first ) ) {
+					tNext = mInfoIterator + 2;
+				}
+				// Binary search over sorted frame times:
+				else {
+					tNext = std::upper_bound( mInfoVec.begin(), mInfoVec.end(), iLocalPlayhead,
+						[] ( double iTime, const FrameInfo& iFrame ) { return iTime < iFrame.first; } );
+				}
+				// Playhead is before first frame:
+				if( tNext == mInfoVec.begin() ) {
+					mInfoIterator = mInfoVec.end();
+					return;
+				}
+				// Set iterator and its time span:
+				mInfoIterator = tNext - 1;
+				mKeyTimeCurr  = mInfoIterator->first;
+				mKeyTimeNext  = ( tNext == mInfoVec.end() ) ? std::numeric_limits<double>::max() : tNext->first;
+			}
+
 		public:
 
+			/** @brief destructor */
+			~Player()
+			{
+				stop_prefetcher();
+			}
+
 			/** @brief static creational method */
 			template <typename ... Args> static typename Player::Ref create(Args&& ... args)
 			{
@@ -164,57 +1793,178 @@ namespace itp { namespace multitrack {
 				// Handle playhead out-of-range:
 				if( tLocalPlayhead < 0.0 || tLocalPlayhead > tDuration ) {
 					mInfoIterator = mInfoVec.end();
+					mLastFrame = T();
+					mLastView = ConstFrame();
+					// Prepare first frames while waiting for track to start:
+					if( mPrefetcher && tLocalPlayhead < 0.0 ) mPrefetcher->request( 0, 1 );
 					return;
 				}
-				// Activate, if necessary:
-				if( mInfoIterator == mInfoVec.end() ) {
-					mInfoIterator = mInfoVec.begin();
-					mKeyTimeCurr  = mInfoVec.front().first;
-					mKeyTimeNext  = ( ( mInfoVec.size() > 1 ) ? ( mInfoIterator + 1 )->first : mKeyTimeCurr );
+				// Update iterator, unless playhead is still within current frame:
+				if( mInfoIterator == mInfoVec.end() || tLocalPlayhead < mKeyTimeCurr || tLocalPlayhead >= mKeyTimeNext ) {
+					seek( tLocalPlayhead );
 				}
-				// Update iterator:
-				while( tLocalPlayhead >= mKeyTimeNext && mInfoIterator != mInfoVec.end() ) {
-					mKeyTimeCurr = mInfoIterator->first;
-					mKeyTimeNext = ( ( ++mInfoIterator == mInfoVec.end() ) ? mKeyTimeCurr : mInfoIterator->first );
+				// Schedule read-ahead from current frame:
+				if( mInfoIterator != mInfoVec.end() ) {
+					size_t tIndex = static_cast<size_t>( mInfoIterator - mInfoVec.begin() );
+					if( tIndex != mLastIndex ) {
+						mDirection = ( tIndex < mLastIndex ) ? -1 : 1;
+						mLastIndex = tIndex;
+					}
+					if( mPrefetcher ) mPrefetcher->request( tIndex, mDirection );
 				}
 			}
 
 			void draw()
 			{
-				if( !mPlayerCallback || mInfoIterator == mInfoVec.end() ) return;
-				mPlayerCallback( read_from_file<T>( mTrack->getDirectory() / mInfoIterator->second ) );
+				if( mInfoIterator == mInfoVec.end() ) return;
+				// Hand mapped frames to view callback as read-only views (player callback receives decoded frames):
+				if( has_views() ) {
+					mTrack->getViewCallback()( get_view( mInfoIterator ) );
+					return;
+				}
+				if( !mPlayerCallback ) return;
+				mPlayerCallback( get_frame( mInfoIterator ) );
 			}
 			
+			/** @brief switches between read-ahead playback and offline (synchronous, frame-exact) decoding */
+			void setOffline(bool iOffline)
+			{
+				if( iOffline == mOffline ) return;
+				mOffline = iOffline;
+				if( mOffline ) {
+					stop_prefetcher();
+				}
+				else {
+					clear_offline_frames();
+					if( mActive ) start_prefetcher();
+				}
+			}
+
+			/** @brief releases frames decoded by offline jobs */
+			void clear_offline_frames()
+			{
+				std::lock_guard<std::mutex> tLock( mOfflineMutex );
+				mOfflineFrames.clear();
+			}
+
+			/**
+			 * @brief collects jobs decoding frames shown between two sequence times (in seconds)
+			 *
+			 * Decoded frames are held for the batch outside of the cache budget; frames of earlier batches are
+			 * released. Frames sharing a keyframe are decoded in order by one job, through its own decoder.
+			 */
+			void collectDecodeJobs(double iBegin, double iEnd, DecodeJobVec& oJobs)
+			{
+				if( mInfoVec.empty() || has_views() ) {
+					clear_offline_frames();
+					return;
+				}
+				// Convert to local time:
+				double tBegin = iBegin - mTrack->getOffset();
+				double tEnd   = iEnd - mTrack->getOffset();
+				if( tEnd < mInfoVec.front().first || tBegin > mInfoVec.back().first ) {
+					clear_offline_frames();
+					return;
+				}
+				// Find frames shown at begin and after end:
+				auto tCompare = [] ( double iTime, const FrameInfo& iFrame ) { return iTime < iFrame.first; };
+				FrameInfoIter tFirst = std::upper_bound( mInfoVec.begin(), mInfoVec.end(), tBegin, tCompare );
+				FrameInfoIter tLast  = std::upper_bound( mInfoVec.begin(), mInfoVec.end(), tEnd, tCompare );
+				if( tFirst != mInfoVec.begin() ) --tFirst;
+				size_t tFirstIndex = static_cast<size_t>( tFirst - mInfoVec.begin() );
+				size_t tLastIndex  = static_cast<size_t>( tLast - mInfoVec.begin() );
+				// Release frames outside of batch:
+				{
+					std::lock_guard<std::mutex> tLock( mOfflineMutex );
+					mOfflineFrames.erase( mOfflineFrames.begin(), mOfflineFrames.lower_bound( tFirstIndex ) );
+					mOfflineFrames.erase( mOfflineFrames.lower_bound( tLastIndex ), mOfflineFrames.end() );
+				}
+				// Group frames still needed by keyframe:
+				std::vector<std::vector<size_t>> tGroups;
+				size_t tGroupKeyframe = 0;
+				for( size_t tIndex = tFirstIndex; tIndex < tLastIndex; tIndex++ ) {
+					{
+						std::lock_guard<std::mutex> tLock( mOfflineMutex );
+						if( mOfflineFrames.find( tIndex ) != mOfflineFrames.end() ) continue;
+					}
+					T tItem;
+					if( mCache->peek( tIndex, tItem ) ) {
+						std::lock_guard<std::mutex> tLock( mOfflineMutex );
+						mOfflineFrames[ tIndex ] = tItem;
+						continue;
+					}
+					size_t tKeyframe = mDecoder ? mDecoder->getKeyframe( tIndex ) : tIndex;
+					if( tGroups.empty() || tKeyframe != tGroupKeyframe ) {
+						tGroups.push_back( std::vector<size_t>() );
+						tGroupKeyframe = tKeyframe;
+					}
+					tGroups.back().push_back( tIndex );
+				}
+				// Queue one job per group (each job decodes into its own payload buffer):
+				for( const auto& tGroup : tGroups ) {
+					typename FrameDecoder::Ref tDecoder = mDecoder ? mDecoder->fork() : typename FrameDecoder::Ref();
+					oJobs.push_back( [this, tGroup, tDecoder] () {
+						std::vector<uint8_t> tBuffer;
+						for( size_t tIndex : tGroup ) {
+							T tItem = read_frame( tIndex, tBuffer, tDecoder );
+							std::lock_guard<std::mutex> tLock( mOfflineMutex );
+							mOfflineFrames[ tIndex ] = tItem;
+						}
+					} );
+				}
+			}
+
+			/** @brief returns decoded-frame cache */
+			typename FrameCache::Ref getCache() const
+			{
+				return mCache;
+			}
+
+			/** @brief returns read-ahead decoder, or NULL if prefetching is disabled */
+			typename FramePrefetcher::Ref getPrefetcher() const
+			{
+				return mPrefetcher;
+			}
+
+			/** @brief returns number of draws since start that held the previous frame because read-ahead had not decoded the due one */
+			uint64_t getUnderrunCount() const
+			{
+				return mUnderrunCount;
+			}
+
 			void start()
 			{
+				// Stop read-ahead before touching frame info:
+				stop_prefetcher();
 				// Clear info container:
 				mInfoVec.clear();
-				mInfoIterator = mInfoVec.end();
-				// Try to open info file:
-				std::ifstream tInfoFile( mTrack->getInfoPath().string() );
-				// Handle info file:
-				if( tInfoFile.is_open() ) {
-					std::string tTemp;
-					// Iterate over each line in info file:
-					while( std::getline( tInfoFile, tTemp ) ) {
-						// Find delimiter:
-						std::size_t tFind = tTemp.find_first_of( ' ' );
-						// Handle frame:
-						if( tFind != std::string::npos ) {
-							mInfoVec.push_back( FrameInfo( atof( tTemp.substr( 0, tFind ).c_str() ), tTemp.substr( tFind + 1 ) ) );
-						}
-						// Handle error:
-						else {
-							throw std::runtime_error( "Player could not read file: \'" + mTrack->getInfoPath().string() + "\'" );
-						}
-					}
-					// Close info file:
-					tInfoFile.close();
+				mCache->clear();
+				clear_offline_frames();
+				mDecoder.reset();
+				mContainer.reset();
+				// Load frame info:
+				if( mTrack->getFormat() != TrackFormat::FILE_SEQUENCE ) {
+					load_container( mTrack->getFormat() == TrackFormat::MAPPED );
 				}
-				// Handle file-open error:
 				else {
-					throw std::runtime_error( "Player could not open file: \'" + mTrack->getInfoPath().string() + "\'" );
+					load_info_file();
 				}
+				// Reset iterator (invalidated by insertion):
+				mInfoIterator = mInfoVec.end();
+				mLastFrame    = T();
+				mLastView     = ConstFrame();
+				mLastIndex    = 0;
+				mDirection    = 1;
+				mUnderrunCount = 0;
+				// Start read-ahead:
+				mActive = true;
+				start_prefetcher();
+			}
+
+			void stop()
+			{
+				mActive = false;
+				stop_prefetcher();
 			}
 		};
 
@@ -235,7 +1985,15 @@ namespace itp { namespace multitrack {
 			double					mStart;  //!< local start time (in seconds)
 			bool					mActive;
 			size_t					mFrameCount;
-			std::ofstream			mInfoFile;
+			size_t					mDuplicateCount; //!< number of pushed frames skipped as not newer
+			bool					mHasTimeStamp;	//!< true once first sensor frame was pushed
+			long long				mLastTimeStamp;	//!< latest pushed sensor timestamp (in ticks)
+			std::mutex				mMutex;			//!< guards buffer and frame state against pushes from device threads
+			std::mutex				mQueueMutex;	//!< keeps frames queued in recording order (held while writer queue is full, taken before mMutex)
+			std::shared_ptr<std::ofstream> mInfoFile; //!< info file (file sequence only; shared with queued writer jobs, closed by stop once writer is joined)
+			WriterQueue::Ref		mWriter; //!< background frame writer
+			ContainerWriter::Ref	mContainer; //!< container writer (container formats only)
+			typename FrameCodecTraits<T>::Encoder::Ref mEncoder; //!< container frame encoder (container formats only; created with first frame, used on writer thread)
 
 			Recorder(typename TrackT::Ref iTrack, RecorderCallback iRecorderCallback, PlayerCallback iPlayerCallback) :
 				mTrack(iTrack),
@@ -243,7 +2001,11 @@ namespace itp { namespace multitrack {
 				mPlayerCallback(iPlayerCallback),
 				mStart(0.0),
 				mActive(false),
-				mFrameCount(0)
+				mFrameCount(0),
+				mDuplicateCount(0),
+				mHasTimeStamp(false),
+				mLastTimeStamp(0LL),
+				mWriter(WriterQueue::create())
 			{ 
 				/* no-op */
 			}
@@ -252,7 +2014,10 @@ namespace itp { namespace multitrack {
 			
 			~Recorder()
 			{
+				// Finish pending writes before closing info file:
+				try { mWriter->stop(); } catch (...) { /* no-op */ }
 				stop_info_file();
+				try { stop_container(); } catch (...) { /* no-op */ }
 			}
 
 			/** @brief static creational method */
@@ -271,75 +2036,206 @@ namespace itp { namespace multitrack {
 				return mPlayerCallback;
 			}
 
+			/** @brief returns background frame writer */
+			WriterQueue::Ref getWriter() const
+			{
+				return mWriter;
+			}
+
+			/** @brief returns number of pushed frames skipped because their sensor timestamp was not newer (poll mode records every polled frame) */
+			size_t getDuplicateCount()
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				return mDuplicateCount;
+			}
+
+			/** @brief sets buffer and returns job writing frame at given recording time (expects lock to be held; job is queued after releasing it) */
+			WriterQueue::Job record_frame(const T& iItem, double iTime)
+			{
+				// Set buffer:
+				mBuffer = iItem;
+				T tItem = mBuffer;
+				WriterQueue::Job tJob;
+				// Encode and append frame on background container writer:
+				if( mContainer ) {
+					if( ! mEncoder ) {
+						mEncoder = FrameCodecTraits<T>::Encoder::create( mTrack->getCodecSettings(), mTrack->getFormat() );
+					}
+					ContainerWriter::Ref tContainer = mContainer;
+					typename FrameCodecTraits<T>::Encoder::Ref tEncoder = mEncoder;
+					tJob = [tContainer, tEncoder, tItem, iTime] () {
+						std::vector<uint8_t> tData;
+						uint32_t tFlags = tEncoder->encode( tData, tItem );
+						tContainer->append( iTime, tData, tFlags );
+					};
+				}
+				// Write frame on background file writer (contents first, then info entry):
+				else {
+					std::string		tFilename	= ("frame_" + std::to_string(mFrameCount) + "." + get_file_extension<T>());
+					ci::fs::path	tPath		= mTrack->getDirectory() / tFilename;
+					std::shared_ptr<std::ofstream> tInfoFile = mInfoFile;
+					tJob = [tPath, tItem, iTime, tFilename, tInfoFile] () {
+						write_to_file<T>( tPath, tItem );
+						(*tInfoFile) << iTime << ' ' << tFilename << std::endl;
+					};
+				}
+				// Increment frame count:
+				mFrameCount++;
+				return tJob;
+			}
+
+			/** @brief polls recorder callback and records its frame, even if it is the one polled last (poll mode only; push-mode recorders have no callback) */
 			void update()
 			{
 				if (!mActive || !mRecorderCallback) return;
 				// Get current time:
-				double tNow = ci::app::getElapsedSeconds() - mStart;
+				double tNow = mTrack->getTimer()->getClock()->getSeconds() - mStart;
 				// Get current frame:
 				T tCurr = mRecorderCallback();
 				// Check frame validity:
-				if( tCurr ) {
-					// Set buffer:
-					mBuffer = tCurr;
-					// Compose frame filename:
-					std::string tFilename = ("frame_" + std::to_string(mFrameCount) + "." + get_file_extension<T>());
-					// Write frame to info file:
-					mInfoFile << tNow << ' ' << tFilename << std::endl;
-					// Write frame contents to file:
-					write_to_file<T>( mTrack->getDirectory() / tFilename, mBuffer );
-					// Increment frame count:
-					mFrameCount++;
+				if( ! tCurr ) return;
+				std::lock_guard<std::mutex> tQueueLock( mQueueMutex );
+				WriterQueue::Job tJob;
+				{
+					std::lock_guard<std::mutex> tLock( mMutex );
+					tJob = record_frame( tCurr, tNow );
+				}
+				// Queue frame outside of frame lock (may block while writer queue is full):
+				mWriter->push( tJob );
+			}
+
+			/**
+			 * @brief records a frame delivered by a device event handler, stamped with its sensor timestamp (100ns ticks)
+			 *
+			 * Sensor time is anchored to clock time by the first frame pushed to any track sharing the timer (see
+			 * Timer::getSensorEpoch), so tracks fed from one sensor clock stay aligned with each other; every frame
+			 * keeps its sensor spacing, with exactly one entry per sensor frame regardless of the app frame rate.
+			 * Frames whose timestamp is not newer than the latest pushed one are skipped. Returns true if the frame
+			 * was recorded. While the writer queue is full, only the calling thread blocks.
+			 */
+			bool push(const T& iItem, long long iTimeStamp)
+			{
+				if( ! iItem ) return false;
+				// Sample clock before locking (clock may be shared with render thread):
+				double tClockNow = mTrack->getTimer()->getClock()->getSeconds();
+				std::lock_guard<std::mutex> tQueueLock( mQueueMutex );
+				WriterQueue::Job tJob;
+				{
+					std::lock_guard<std::mutex> tLock( mMutex );
+					if( ! mActive ) return false;
+					// Skip repeated or out-of-order sensor frames:
+					if( mHasTimeStamp && iTimeStamp <= mLastTimeStamp ) {
+						mDuplicateCount++;
+						return false;
+					}
+					mHasTimeStamp	= true;
+					mLastTimeStamp	= iTimeStamp;
+					// Convert sensor time to recording time through shared epoch:
+					tJob = record_frame( iItem, mTrack->getTimer()->getSensorEpoch()->toSeconds( iTimeStamp, tClockNow ) - mStart );
 				}
+				// Queue frame outside of frame lock, so a slow disk stalls only this device thread, not update or draw:
+				mWriter->push( tJob );
+				return true;
+			}
+
+			/** @brief returns true if push would record a frame with given sensor timestamp (recording, and timestamp newer than the latest pushed one) */
+			bool accepts(long long iTimeStamp)
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				return mActive && ( ! mHasTimeStamp || iTimeStamp > mLastTimeStamp );
 			}
 
 			void draw()
 			{
 				if( !mActive || !mPlayerCallback ) return;
-				mPlayerCallback( mBuffer );
+				T tBuffer;
+				{
+					std::lock_guard<std::mutex> tLock( mMutex );
+					tBuffer = mBuffer;
+				}
+				mPlayerCallback( tBuffer );
 			}
 
 			void start()
 			{
-				// Check if directory already exists:
-				if (ci::fs::exists(mTrack->getDirectory())) {
-					// If path exists but is not a directory, throw:
-					if (!fs::is_directory(mTrack->getDirectory())) {
-						throw std::runtime_error("Could not open \'" + mTrack->getDirectory().string() + "\' as a directory");
-					}
+				// Start container file:
+				if (mTrack->getFormat() != TrackFormat::FILE_SEQUENCE) {
+					stop_info_file();
+					mContainer = ContainerWriter::create(mTrack->getContainerPath(), get_file_extension<T>());
+					mEncoder.reset();
 				}
-				// Create directory:
-				else if (!boost::filesystem::create_directory(mTrack->getDirectory())) {
-					throw std::runtime_error("Could not create \'" + mTrack->getDirectory().string() + "\' as a directory");
+				// Start frame directory and info file:
+				else {
+					// Check if directory already exists:
+					if (ci::fs::exists(mTrack->getDirectory())) {
+						// If path exists but is not a directory, throw:
+						if (!fs::is_directory(mTrack->getDirectory())) {
+							throw std::runtime_error("Could not open \'" + mTrack->getDirectory().string() + "\' as a directory");
+						}
+					}
+					// Create directory:
+					else if (!boost::filesystem::create_directory(mTrack->getDirectory())) {
+						throw std::runtime_error("Could not create \'" + mTrack->getDirectory().string() + "\' as a directory");
+					}
+					// Start info file:
+					start_info_file();
 				}
-				// Start info file:
-				start_info_file();
+				// Start background writer:
+				mWriter->start();
 				// Start recording:
+				std::lock_guard<std::mutex> tLock( mMutex );
 				mActive = true;
 				mFrameCount = 0;
+				mDuplicateCount = 0;
+				mHasTimeStamp = false;
 				mTrack->setLocalOffsetToCurrent();
-				mStart = ci::app::getElapsedSeconds();
+				mStart = mTrack->getTimer()->getClock()->getSeconds();
 			}
 
 			void stop()
 			{
+				{
+					std::lock_guard<std::mutex> tLock( mMutex );
+					mActive = false;
+				}
+				// Wait for frames still being queued by device threads:
+				{
+					std::lock_guard<std::mutex> tQueueLock( mQueueMutex );
+				}
+				// Join writer before closing info file, so no queued job writes to it (files are closed even if a write failed):
+				std::exception_ptr tError;
+				try { mWriter->stop(); } catch (...) { tError = std::current_exception(); }
 				stop_info_file();
-				mActive = false;
+				try { stop_container(); } catch (...) { if( ! tError ) tError = std::current_exception(); }
+				// Report first failure:
+				if( tError ) std::rethrow_exception( tError );
 			}
 			
 			void start_info_file()
 			{
 				stop_info_file();
-				mInfoFile.open( mTrack->getInfoPath().string() );
+				mInfoFile = std::make_shared<std::ofstream>( mTrack->getInfoPath().string() );
 				
-				if( ! mInfoFile.is_open() )
+				if( ! mInfoFile->is_open() )
 					throw std::runtime_error( "Recorder could not open file: \'" + mTrack->getInfoPath().string() + "\'" );
+				// Write frame times so they read back exactly:
+				mInfoFile->precision( std::numeric_limits<double>::max_digits10 );
 			}
 			
 			void stop_info_file()
 			{
-				if( mInfoFile.is_open() ) {
-					mInfoFile.close();
+				if( mInfoFile ) {
+					mInfoFile->close();
+					mInfoFile.reset();
+				}
+			}
+
+			void stop_container()
+			{
+				if( mContainer ) {
+					mContainer->close();
+					mContainer.reset();
+					mEncoder.reset();
 				}
 			}
 		};
@@ -347,16 +2243,24 @@ namespace itp { namespace multitrack {
 	private:
 
 		TrackBase::Ref	mMediator;	//!< shared_ptr to track mediator
+		mutable std::mutex mMediatorMutex; //!< guards mediator against device threads pushing frames while it is replaced
 		ci::fs::path	mDirectory;	//!< track's base directory
 		std::string		mName;		//!< track's base filename
+		TrackFormat		mFormat;	//!< track's storage format
+		size_t			mCacheBudget; //!< player's decoded-frame cache budget (in bytes)
+		size_t			mPrefetchDepth; //!< player's read-ahead depth (in frames)
+		typename FrameCodecTraits<T>::Settings mCodecSettings; //!< recorder's container codec settings
+		typename FramePoolT<T>::Ref mPool; //!< recycled payloads for decoded frames
+		bool			mOffline;	//!< offline flag, applied to new players
+		ViewCallback	mViewCallback; //!< player's callback for read-only views of mapped frames
 		
 		/** @brief default constructor */
-		TrackT(const ci::fs::path& iDirectory, const std::string& iName, Timer::Ref iTimer)
-		: Track( iTimer ), mDirectory( iDirectory ), mName( iName ) { /* no-op */ }
+		TrackT(const ci::fs::path& iDirectory, const std::string& iName, Timer::Ref iTimer, TrackFormat iFormat = TrackFormat::FILE_SEQUENCE)
+		: Track( iTimer ), mDirectory( iDirectory ), mName( iName ), mFormat( iFormat ), mCacheBudget( FrameCacheT<T>::kDefaultBudget ), mPrefetchDepth( FramePrefetcherT<T>::kDefaultDepth ), mPool( FramePoolT<T>::create() ), mOffline( false ) { /* no-op */ }
 		
 		/** @brief parented constructor */
-		TrackT(const ci::fs::path& iDirectory, const std::string& iName, Track::Ref iParent)
-		: Track( iParent ), mDirectory( iDirectory ), mName( iName ) { /* no-op */ }
+		TrackT(const ci::fs::path& iDirectory, const std::string& iName, Track::Ref iParent, TrackFormat iFormat = TrackFormat::FILE_SEQUENCE)
+		: Track( iParent ), mDirectory( iDirectory ), mName( iName ), mFormat( iFormat ), mCacheBudget( FrameCacheT<T>::kDefaultBudget ), mPrefetchDepth( FramePrefetcherT<T>::kDefaultDepth ), mPool( FramePoolT<T>::create() ), mOffline( false ) { /* no-op */ }
 		
 	public:
 		
@@ -368,35 +2272,142 @@ namespace itp { namespace multitrack {
 		
 		ci::fs::path getInfoPath()  const { return mDirectory / ( mName + "_info.txt" ); }
 		ci::fs::path getDirectory() const { return mDirectory / mName; }
+		ci::fs::path getContainerPath() const { return mDirectory / ( mName + "_track.bin" ); }
+		TrackFormat  getFormat()    const { return mFormat; }
+		size_t       getCacheBudget() const { return mCacheBudget; }
+		size_t       getPrefetchDepth() const { return mPrefetchDepth; }
+		size_t       getKeyframeInterval() const { return mCodecSettings.mKeyframeInterval; }
+		bool         isOffline() const { return mOffline; }
+		
+		/** @brief returns pool recycling decoded frames once the cache and player callback release them (also usable by recorder callbacks) */
+		const typename FramePoolT<T>::Ref& getPool() const { return mPool; }
+		
+		/** @brief sets player's read-ahead depth (in frames; zero decodes synchronously in draw); applies on next play */
+		void setPrefetchDepth(size_t iFrames)
+		{
+			mPrefetchDepth = iFrames;
+		}
+		
+		/** @brief sets recorder's keyframe interval for delta-coded container types (in frames; one writes raw keyframes only, so mapped depth and body-index tracks play through the view callback without copying); applies from next recording's first frame */
+		void setKeyframeInterval(size_t iFrames)
+		{
+			mCodecSettings.mKeyframeInterval = ( iFrames > 0 ) ? iFrames : 1;
+		}
+		
+		/** @brief returns recorder's container codec settings */
+		const typename FrameCodecTraits<T>::Settings& getCodecSettings() const { return mCodecSettings; }
+		
+		/** @brief sets recorder's container codec settings (e.g. point cloud quantization); applies from next recording's first frame */
+		void setCodecSettings(const typename FrameCodecTraits<T>::Settings& iSettings)
+		{
+			mCodecSettings = iSettings;
+			if( mCodecSettings.mKeyframeInterval == 0 ) mCodecSettings.mKeyframeInterval = 1;
+		}
+		
+		/** @brief returns player's read-ahead decoder, or NULL when not in play mode or prefetching is disabled */
+		typename FramePrefetcherT<T>::Ref getPrefetcher() const
+		{
+			typename Player::Ref tPlayer = std::dynamic_pointer_cast<Player>( get_mediator() );
+			return ( tPlayer ? tPlayer->getPrefetcher() : typename FramePrefetcherT<T>::Ref() );
+		}
+		
+		/** @brief returns number of draws that held the previous frame because read-ahead fell behind (since playback started; zero when not in play mode) */
+		uint64_t getUnderrunCount() const
+		{
+			typename Player::Ref tPlayer = std::dynamic_pointer_cast<Player>( get_mediator() );
+			return ( tPlayer ? tPlayer->getUnderrunCount() : 0 );
+		}
+		
+		/** @brief sets player's decoded-frame cache budget (in bytes; zero disables caching, prefetched frames are held outside of it) */
+		void setCacheBudget(size_t iBytes)
+		{
+			mCacheBudget = iBytes;
+			typename Player::Ref tPlayer = std::dynamic_pointer_cast<Player>( get_mediator() );
+			if( tPlayer ) tPlayer->getCache()->setBudget( iBytes );
+		}
+		
+		/** @brief returns player's decoded-frame cache, or NULL when not in play mode */
+		typename FrameCacheT<T>::Ref getCache() const
+		{
+			typename Player::Ref tPlayer = std::dynamic_pointer_cast<Player>( get_mediator() );
+			return ( tPlayer ? tPlayer->getCache() : typename FrameCacheT<T>::Ref() );
+		}
+		
+		/** @brief returns player's callback for read-only views of mapped frames */
+		const ViewCallback& getViewCallback() const { return mViewCallback; }
+		
+		/** @brief sets callback receiving read-only views of mapped frames in place of the player callback (mapped tracks of viewable types without delta frames; set before entering play mode) */
+		void setViewCallback(ViewCallback iViewCallback)
+		{
+			mViewCallback = iViewCallback;
+		}
 		
-		void update() { if( mMediator ) mMediator->update(); }
-		void draw() { if( mMediator ) mMediator->draw(); }
-		void start() { if( mMediator ) mMediator->start(); }
-		void stop() { if( mMediator ) mMediator->stop(); }
+		void update() { TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->update(); }
+		void draw() { TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->draw(); }
+		void setOffline(bool iOffline) { mOffline = iOffline; TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->setOffline( iOffline ); }
+		void collectDecodeJobs(double iBegin, double iEnd, DecodeJobVec& oJobs) { TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->collectDecodeJobs( iBegin, iEnd, oJobs ); }
+		void start() { TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->start(); }
+		void stop() { TrackBase::Ref tMediator = get_mediator(); if( tMediator ) tMediator->stop(); }
 		
 		void gotoIdleMode()
 		{
-			if( mMediator ) mMediator->stop();
-			mMediator.reset();
+			TrackBase::Ref tMediator = get_mediator();
+			if( tMediator ) tMediator->stop();
+			set_mediator( TrackBase::Ref() );
 		}
 		
 		void gotoPlayMode()
 		{
+			TrackBase::Ref tMediator = get_mediator();
 			// Stop mediator:
-			if (mMediator) mMediator->stop();
+			if (tMediator) tMediator->stop();
 			// Cast mediator to recorder:
-			typename Recorder::Ref tRecorderCast = std::dynamic_pointer_cast<Recorder>(mMediator);
+			typename Recorder::Ref tRecorderCast = std::dynamic_pointer_cast<Recorder>(tMediator);
 			// Return on cast error:
 			if (!tRecorderCast) { return; }
-			mMediator = Player::create(getRef<TrackT>(), tRecorderCast->getPlayerCallbackFn());
-			mMediator->start();
+			tMediator = Player::create(getRef<TrackT>(), tRecorderCast->getPlayerCallbackFn());
+			set_mediator( tMediator );
+			tMediator->start();
+		}
+		
+		/** @brief records a frame pushed from a device event handler with its sensor timestamp; returns false unless recording and frame is new */
+		bool push(const T& iItem, long long iTimeStamp)
+		{
+			typename Recorder::Ref tRecorder = std::dynamic_pointer_cast<Recorder>( get_mediator() );
+			return ( tRecorder ? tRecorder->push( iItem, iTimeStamp ) : false );
+		}
+		
+		/** @brief returns true if push would record a frame with given sensor timestamp */
+		bool accepts(long long iTimeStamp)
+		{
+			typename Recorder::Ref tRecorder = std::dynamic_pointer_cast<Recorder>( get_mediator() );
+			return ( tRecorder ? tRecorder->accepts( iTimeStamp ) : false );
 		}
 		
+		/** @brief enters record mode; an empty recorder callback selects push mode (frames arrive through push) */
 		void gotoRecordMode(RecorderCallback iRecorderCallback, PlayerCallback iPlayerCallback)
 		{
-			if( mMediator ) mMediator->stop();
-			mMediator = Recorder::create(getRef<TrackT>(), iRecorderCallback, iPlayerCallback);
-			mMediator->start();
+			TrackBase::Ref tMediator = get_mediator();
+			if( tMediator ) tMediator->stop();
+			tMediator = Recorder::create(getRef<TrackT>(), iRecorderCallback, iPlayerCallback);
+			set_mediator( tMediator );
+			tMediator->start();
+		}
+
+	private:
+
+		/** @brief returns snapshot of mediator (device threads keep using it even if it is replaced meanwhile) */
+		TrackBase::Ref get_mediator() const
+		{
+			std::lock_guard<std::mutex> tLock( mMediatorMutex );
+			return mMediator;
+		}
+
+		/** @brief replaces mediator */
+		void set_mediator(const TrackBase::Ref& iMediator)
+		{
+			std::lock_guard<std::mutex> tLock( mMediatorMutex );
+			mMediator = iMediator;
 		}
 	};
 
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <stdexcept>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace itp { namespace multitrack {
+
+	/** @brief bounded job queue serviced by a dedicated writer thread */
+	class WriterQueue {
+	public:
+
+		typedef std::shared_ptr<WriterQueue>		Ref;
+		typedef std::shared_ptr<const WriterQueue>	ConstRef;
+
+		typedef std::function<void(void)>			Job;
+		typedef std::deque<Job>						JobDeque;
+
+		static const size_t kDefaultCapacity = 32; //!< default maximum number of queued jobs
+
+	private:
+
+		std::thread					mThread;		//!< writer thread
+		std::mutex					mMutex;			//!< guards all members below
+		std::condition_variable		mCondPush;		//!< signalled when a job is queued or the queue is stopped
+		std::condition_variable		mCondPop;		//!< signalled when a job is completed
+		JobDeque					mJobs;			//!< pending jobs
+		size_t						mCapacity;		//!< maximum number of pending jobs
+		size_t						mBusy;			//!< number of jobs currently being executed
+		size_t						mStallCount;	//!< number of pushes that blocked on a full queue
+		bool						mRunning;		//!< activity flag
+		std::exception_ptr			mError;			//!< first error thrown by a job
+
+		/** @brief default constructor */
+		WriterQueue(size_t iCapacity = kDefaultCapacity) :
+			mCapacity( iCapacity > 0 ? iCapacity : 1 ),
+			mBusy( 0 ),
+			mStallCount( 0 ),
+			mRunning( false )
+		{ /* no-op */ }
+
+		/** @brief writer thread loop */
+		void run()
+		{
+			std::unique_lock<std::mutex> tLock( mMutex );
+			while( true ) {
+				// Wait for work:
+				mCondPush.wait( tLock, [this] { return ! mJobs.empty() || ! mRunning; } );
+				// Exit once stopped and drained:
+				if( mJobs.empty() ) return;
+				// Pop job:
+				Job tJob = mJobs.front();
+				mJobs.pop_front();
+				mBusy++;
+				// Execute job outside of lock:
+				tLock.unlock();
+				std::exception_ptr tError;
+				try {
+					tJob();
+				}
+				catch( ... ) {
+					tError = std::current_exception();
+				}
+				tLock.lock();
+				// Keep first error for the render thread:
+				if( tError && ! mError ) mError = tError;
+				mBusy--;
+				mCondPop.notify_all();
+			}
+		}
+
+		/** @brief rethrows and clears the first job error, if any (expects lock to be held) */
+		void rethrow_error()
+		{
+			if( mError ) {
+				std::exception_ptr tError = mError;
+				mError = std::exception_ptr();
+				std::rethrow_exception( tError );
+			}
+		}
+
+	public:
+
+		/** @brief destructor */
+		~WriterQueue()
+		{
+			try { stop(); } catch( ... ) { /* no-op */ }
+		}
+
+		/** @brief static creational method */
+		template <typename ... Args> static WriterQueue::Ref create(Args&& ... args)
+		{
+			return WriterQueue::Ref( new WriterQueue( std::forward<Args>( args )... ) );
+		}
+
+		/** @brief returns maximum number of pending jobs */
+		size_t getCapacity() const
+		{
+			return mCapacity;
+		}
+
+		/** @brief returns number of pushes that blocked on a full queue */
+		size_t getStallCount()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mStallCount;
+		}
+
+		/** @brief returns number of pending jobs */
+		size_t size()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			return mJobs.size() + mBusy;
+		}
+
+		/** @brief starts writer thread */
+		void start()
+		{
+			std::lock_guard<std::mutex> tLock( mMutex );
+			if( mRunning ) return;
+			mRunning = true;
+			mError   = std::exception_ptr();
+			mThread  = std::thread( &WriterQueue::run, this );
+		}
+
+		/** @brief queues a job, blocking while the queue is full; rethrows any earlier job error */
+		void push(Job iJob)
+		{
+			std::unique_lock<std::mutex> tLock( mMutex );
+			// Handle inactive queue:
+			if( ! mRunning ) {
+				throw std::runtime_error( "WriterQueue is not running" );
+			}
+			// Report earlier failures to caller:
+			rethrow_error();
+			// Wait for room:
+			if( mJobs.size() >= mCapacity ) {
+				mStallCount++;
+				mCondPop.wait( tLock, [this] { return mJobs.size() < mCapacity; } );
+			}
+			// Queue job:
+			mJobs.push_back( iJob );
+			mCondPush.notify_one();
+		}
+
+		/** @brief blocks until all queued jobs have completed; rethrows any job error */
+		void drain()
+		{
+			std::unique_lock<std::mutex> tLock( mMutex );
+			mCondPop.wait( tLock, [this] { return mJobs.empty() && mBusy == 0; } );
+			rethrow_error();
+		}
+
+		/** @brief drains queued jobs and joins writer thread; rethrows any job error */
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> tLock( mMutex );
+				if( ! mRunning ) return;
+				mRunning = false;
+				mCondPush.notify_all();
+			}
+			// Writer thread exits once remaining jobs are done:
+			if( mThread.joinable() ) {
+				mThread.join();
+			}
+			std::lock_guard<std::mutex> tLock( mMutex );
+			rethrow_error();
+		}
+	};
+
+} } // namespace itp::multitrack
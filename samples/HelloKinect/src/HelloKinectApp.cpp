@@ -5,7 +5,11 @@
 
 #include "Kinect2.h"
 
+#include <FrameHandoff.h>
+#include <FrameSynchronizer.h>
+#include <KinectProcessingDepth.h>
 #include <KinectProcessingGlsl.h>
+#include <KinectProcessingLookup.h>
 
 #define RAW_FRAME_WIDTH  1920
 #define RAW_FRAME_HEIGHT 1080
@@ -35,8 +39,14 @@ class HelloKinectApp : public App {
 	ci::Channel8uRef			mChannelBody;
 	ci::Surface8uRef			mSurfaceColor;
 	ci::Channel16uRef			mChannelDepth;
+	ci::Channel8uRef			mChannelDepth8;
+	itp::KinectFrameHandoff::Ref	mKinectFrames;
+	itp::KinectFrameSynchronizer::Ref	mFrameSync;
 
 	ci::Surface32fRef			mSurfaceLookup;
+	itp::DepthToColorTable::Ref	mDepthToColorTable;
+	itp::DepthToColorLookup::Ref	mDepthToColorLookup;
+	itp::DepthConverter::Ref	mDepthConverter;
 
 	ci::gl::TextureRef			mTextureBody;
 	ci::gl::TextureRef			mTextureColor;
@@ -69,7 +79,25 @@ void HelloKinectApp::setup()
 		ci::app::console() << "Unknown GLSL Error" << std::endl;
 		quit();
 	}
-	// Initialize Kinect and register callbacks:
+	// Setup depth-to-color table (only pixels whose depth moved more than 8mm are re-evaluated):
+	mDepthToColorTable = itp::DepthToColorTable::create();
+	mDepthToColorTable->setChangeThreshold(8);
+	// Setup depth display converter (depth texture is only refreshed when a new depth frame arrives):
+	mDepthConverter = itp::DepthConverter::create();
+	// Initialize Kinect and register callbacks (stream frames are handed to update() through a lock-free triple buffer):
+	mKinectFrames = itp::KinectFrameHandoff::create();
+	// Match stream frames by sensor timestamp, so each frame set comes from a single sensor tick:
+	mFrameSync = itp::KinectFrameSynchronizer::create();
+	mFrameSync->setStreamEnabled(itp::KinectFrameSynchronizer::BODY, false);
+	mFrameSync->setMatchFn([&](const itp::KinectMatchedFrames& iFrames)
+	{
+		itp::KinectFrameSet& tFrames = mKinectFrames->getWriteBuffer();
+		tFrames.mColor = iFrames.mColor;
+		tFrames.mDepth = iFrames.mDepth;
+		tFrames.mBody = iFrames.mBody;
+		tFrames.mTimeStamp = iFrames.mTimeStamp;
+		mKinectFrames->publish();
+	});
 	mDevice = Kinect2::Device::create();
 	mDevice->start();
 	mDevice->connectBodyEventHandler([&](const Kinect2::BodyFrame& frame)
@@ -78,16 +106,15 @@ void HelloKinectApp::setup()
 	});
 	mDevice->connectBodyIndexEventHandler([&](const Kinect2::BodyIndexFrame& frame)
 	{
-		mChannelBody = frame.getChannel();
+		mFrameSync->pushBodyIndex(frame.getChannel(), frame.getTimeStamp());
 	});
 	mDevice->connectColorEventHandler([&](const Kinect2::ColorFrame& frame)
 	{
-		mSurfaceColor = frame.getSurface();
+		mFrameSync->pushColor(frame.getSurface(), frame.getTimeStamp());
 	});
 	mDevice->connectDepthEventHandler([&](const Kinect2::DepthFrame& frame)
 	{
-		mChannelDepth = frame.getChannel();
-		mTimeStamp = frame.getTimeStamp();
+		mFrameSync->pushDepth(frame.getChannel(), frame.getTimeStamp());
 	});
 	// Setup FBO:
 	ci::gl::Fbo::Format tSilhouetteFboFormat;
@@ -100,28 +127,34 @@ void HelloKinectApp::mouseDown( MouseEvent event )
 
 void HelloKinectApp::update()
 {
+	// Take latest frame set published by Kinect event handlers:
+	if (mKinectFrames->acquire()) {
+		const itp::KinectFrameSet& tFrames = mKinectFrames->getReadBuffer();
+		mSurfaceColor = tFrames.mColor;
+		mChannelDepth = tFrames.mDepth;
+		mChannelBody = tFrames.mBody;
+		mTimeStamp = tFrames.mTimeStamp;
+	}
 	// Check whether depth-to-color mapping update is needed:
 	if ((mTimeStamp != mTimeStampPrev) && mSurfaceColor && mChannelDepth) {
 		// Update timestamp:
 		mTimeStampPrev = mTimeStamp;
-		// Initialize lookup surface:
-		mSurfaceLookup = ci::Surface32f::create(mChannelDepth->getWidth(), mChannelDepth->getHeight(), false, ci::SurfaceChannelOrder::RGB);
-		// Get depth-to-color mapping points:
-		std::vector<ci::ivec2> tMappingPoints = mDevice->mapDepthToColor(mChannelDepth);
-		// Get color frame dimension:
-		ci::vec2 tColorFrameDim(Kinect2::ColorFrame().getSize());
-		// Prepare iterators:
-		ci::Surface32f::Iter iter = mSurfaceLookup->getIter();
-		std::vector<ci::ivec2>::iterator v = tMappingPoints.begin();
-		// Create lookup mapping:
-		while (iter.line()) {
-			while (iter.pixel()) {
-				iter.r() = (float)v->x / tColorFrameDim.x;
-				iter.g() = 1.0f - (float)v->y / tColorFrameDim.y;
-				iter.b() = 0.0f;
-				++v;
+		// Calibrate depth-to-color table once (falls back to full per-frame mapping if the fit is off by more than a color pixel):
+		if (!mDepthToColorTable->isCalibrated()) {
+			mDepthToColorTable->calibrate(mDevice, mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+			if (mDepthToColorTable->getFitError() > 1.0f) {
+				ci::app::console() << "Depth-to-color fit error " << mDepthToColorTable->getFitError() << "px, using full mapping" << std::endl;
+				mDepthToColorLookup = itp::DepthToColorLookup::create();
 			}
 		}
+		// Evaluate lookup surface from depth values, or map every depth pixel (buffers are reused across frames):
+		if (mDepthToColorLookup) {
+			mSurfaceLookup = mDepthToColorLookup->update(mDevice->mapDepthToColor(mChannelDepth), mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+		}
+		else {
+			mDepthToColorTable->update(mChannelDepth);
+			mSurfaceLookup = mDepthToColorTable->getSurface();
+		}
 	}
 }
 
@@ -155,11 +188,13 @@ void HelloKinectApp::renderSilhouette(bool iDrawSkeletons)
 		// Bind color texture:
 		mTextureColor->bind(0);
 		// Generate depth texture:
-		if (mTextureDepth) {
-			mTextureDepth->update(*(Kinect2::channel16To8(mChannelDepth).get()));
-		}
-		else {
-			mTextureDepth = ci::gl::Texture::create(*(Kinect2::channel16To8(mChannelDepth).get()));
+		if (mDepthConverter->update(mChannelDepth, mTimeStamp, mChannelDepth8) || !mTextureDepth) {
+			if (mTextureDepth) {
+				mTextureDepth->update(*(mChannelDepth8.get()));
+			}
+			else {
+				mTextureDepth = ci::gl::Texture::create(*(mChannelDepth8.get()));
+			}
 		}
 		// Bind depth texture:
 		mTextureDepth->bind(1);
@@ -7,8 +7,14 @@
 
 #include "Kinect2.h"
 
+#include <FrameHandoff.h>
+#include <FrameReadback.h>
+#include <FrameSynchronizer.h>
+#include <KinectProcessingDepth.h>
 #include <KinectProcessingGlsl.h>
+#include <KinectProcessingLookup.h>
 #include <multitrack/Controller.h>
+#include <multitrack/FrameSetRecorder.h>
 
 #define RAW_FRAME_WIDTH  1920
 #define RAW_FRAME_HEIGHT 1080
@@ -41,8 +47,16 @@ class HelloKinectMultitrackApp : public App {
 	ci::Channel8uRef					mChannelBody;
 	ci::Surface8uRef					mSurfaceColor;
 	ci::Channel16uRef					mChannelDepth;
+	ci::Channel8uRef					mChannelDepth8;
+	ci::Channel8uRef					mChannelDepthPlayback;
+	ci::Channel8uRef					mChannelBodyPlayback;
+	itp::KinectFrameHandoff::Ref		mKinectFrames;
+	itp::KinectFrameSynchronizer::Ref	mFrameSync;
 
 	ci::Surface32fRef					mSurfaceLookup;
+	itp::DepthToColorTable::Ref			mDepthToColorTable;
+	itp::DepthToColorLookup::Ref		mDepthToColorLookup;
+	itp::DepthConverter::Ref			mDepthConverter;
 
 	ci::gl::TextureRef					mTextureBody;
 	ci::gl::TextureRef					mTextureColor;
@@ -51,7 +65,15 @@ class HelloKinectMultitrackApp : public App {
 
 	ci::gl::FboRef						mSilhouetteFbo;
 
+	itp::multitrack::FramePoolT<ci::SurfaceRef>::Ref	mSurfacePool;
+	itp::multitrack::FramePoolT<itp::multitrack::PointCloudRef>::Ref	mBodyPool;
+
+	itp::FrameReadback::Ref				mSilhouetteReadback;
+	itp::multitrack::TrackT<itp::multitrack::CroppedSurfaceRef>::Ref	mSilhouetteTrack;
+
 	itp::multitrack::Controller::Ref	mMultitrackController;
+
+	itp::multitrack::FrameSetRecorderT<itp::KinectMatchedFrames>::Ref	mFrameSetRecorder;
 };
 
 void HelloKinectMultitrackApp::setup()
@@ -77,29 +99,56 @@ void HelloKinectMultitrackApp::setup()
 		ci::app::console() << "Unknown GLSL Error" << std::endl;
 		quit();
 	}
-	// Initialize Kinect and register callbacks:
+	// Setup depth-to-color table (only pixels whose depth moved more than 8mm are re-evaluated):
+	mDepthToColorTable = itp::DepthToColorTable::create();
+	mDepthToColorTable->setChangeThreshold(8);
+	// Setup depth display converter (depth texture is only refreshed when a new depth frame arrives):
+	mDepthConverter = itp::DepthConverter::create();
+	// Initialize Kinect and register callbacks (stream frames are handed to update() through a lock-free triple buffer):
+	mKinectFrames = itp::KinectFrameHandoff::create();
+	mFrameSetRecorder = itp::multitrack::FrameSetRecorderT<itp::KinectMatchedFrames>::create();
+	// Match stream frames by sensor timestamp, so each frame set comes from a single sensor tick:
+	mFrameSync = itp::KinectFrameSynchronizer::create();
+	mFrameSync->setMatchFn([&](const itp::KinectMatchedFrames& iFrames)
+	{
+		itp::KinectFrameSet& tFrames = mKinectFrames->getWriteBuffer();
+		tFrames.mColor = iFrames.mColor;
+		tFrames.mDepth = iFrames.mDepth;
+		tFrames.mBody = iFrames.mBody;
+		tFrames.mTimeStamp = iFrames.mTimeStamp;
+		mKinectFrames->publish();
+		// Record matched set on all set tracks at its sensor time:
+		mFrameSetRecorder->push(iFrames, iFrames.mTimeStamp);
+	});
 	mDevice = Kinect2::Device::create();
 	mDevice->start();
 	mDevice->connectBodyEventHandler([&](const Kinect2::BodyFrame& frame)
 	{
 		mBodyFrame = frame;
+		itp::multitrack::PointCloudRef tBodies = mBodyPool->acquire();
+		tBodies->set(frame, mDevice);
+		mFrameSync->pushBodies(tBodies, frame.getTimeStamp());
 	});
 	mDevice->connectBodyIndexEventHandler([&](const Kinect2::BodyIndexFrame& frame)
 	{
-		mChannelBody = frame.getChannel();
+		mFrameSync->pushBodyIndex(frame.getChannel(), frame.getTimeStamp());
 	});
 	mDevice->connectColorEventHandler([&](const Kinect2::ColorFrame& frame)
 	{
-		mSurfaceColor = frame.getSurface();
+		mFrameSync->pushColor(frame.getSurface(), frame.getTimeStamp());
 	});
 	mDevice->connectDepthEventHandler([&](const Kinect2::DepthFrame& frame)
 	{
-		mChannelDepth = frame.getChannel();
-		mTimeStamp = frame.getTimeStamp();
+		mFrameSync->pushDepth(frame.getChannel(), frame.getTimeStamp());
 	});
 	// Setup FBO:
 	ci::gl::Fbo::Format tSilhouetteFboFormat;
 	mSilhouetteFbo = ci::gl::Fbo::create(RAW_FRAME_WIDTH, RAW_FRAME_HEIGHT, tSilhouetteFboFormat.colorTexture());
+	// Setup frame pools (recorded frames are recycled once written):
+	mSurfacePool = itp::multitrack::FramePoolT<ci::SurfaceRef>::create();
+	mBodyPool = itp::multitrack::FramePoolT<itp::multitrack::PointCloudRef>::create();
+	// Setup asynchronous silhouette readback (frames return three captures later):
+	mSilhouetteReadback = itp::PboReadback::create(mSilhouetteFbo, 3, mSurfacePool);
 	// Setup multitrack controller:
 	mMultitrackController = itp::multitrack::Controller::create(getHomeDirectory() / "Desktop" / "Tests");
 	mMultitrackController->start();
@@ -107,26 +156,40 @@ void HelloKinectMultitrackApp::setup()
 
 void HelloKinectMultitrackApp::update()
 {
+	// Take latest frame set published by Kinect event handlers:
+	if (mKinectFrames->acquire()) {
+		const itp::KinectFrameSet& tFrames = mKinectFrames->getReadBuffer();
+		mSurfaceColor = tFrames.mColor;
+		mChannelDepth = tFrames.mDepth;
+		mChannelBody = tFrames.mBody;
+		mTimeStamp = tFrames.mTimeStamp;
+	}
 	// Check whether depth-to-color mapping update is needed:
 	if ((mTimeStamp != mTimeStampPrev) && mSurfaceColor && mChannelDepth) {
 		// Update timestamp:
 		mTimeStampPrev = mTimeStamp;
-		// Initialize lookup surface:
-		mSurfaceLookup = ci::Surface32f::create(mChannelDepth->getWidth(), mChannelDepth->getHeight(), false, ci::SurfaceChannelOrder::RGB);
-		// Get depth-to-color mapping points:
-		std::vector<ci::ivec2> tMappingPoints = mDevice->mapDepthToColor(mChannelDepth);
-		// Get color frame dimension:
-		ci::vec2 tColorFrameDim(Kinect2::ColorFrame().getSize());
-		// Prepare iterators:
-		ci::Surface32f::Iter iter = mSurfaceLookup->getIter();
-		std::vector<ci::ivec2>::iterator v = tMappingPoints.begin();
-		// Create lookup mapping:
-		while (iter.line()) {
-			while (iter.pixel()) {
-				iter.r() = (float)v->x / tColorFrameDim.x;
-				iter.g() = 1.0f - (float)v->y / tColorFrameDim.y;
-				iter.b() = 0.0f;
-				++v;
+		// Calibrate depth-to-color table once (falls back to full per-frame mapping if the fit is off by more than a color pixel):
+		if (!mDepthToColorTable->isCalibrated()) {
+			mDepthToColorTable->calibrate(mDevice, mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+			if (mDepthToColorTable->getFitError() > 1.0f) {
+				ci::app::console() << "Depth-to-color fit error " << mDepthToColorTable->getFitError() << "px, using full mapping" << std::endl;
+				mDepthToColorLookup = itp::DepthToColorLookup::create();
+			}
+		}
+		// Evaluate lookup surface from depth values, or map every depth pixel (buffers are reused across frames):
+		if (mDepthToColorLookup) {
+			mSurfaceLookup = mDepthToColorLookup->update(mDevice->mapDepthToColor(mChannelDepth), mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+		}
+		else {
+			mDepthToColorTable->update(mChannelDepth);
+			mSurfaceLookup = mDepthToColorTable->getSurface();
+		}
+		// Capture silhouette of new frame set and record capture that completed (cropped to its alpha bounds into a recycled frame), stamped with its sensor time:
+		if (mSilhouetteTrack) {
+			renderSilhouette();
+			itp::ReadbackFrame tFrame;
+			if (mSilhouetteReadback->capture(mTimeStamp, tFrame)) {
+				mSilhouetteTrack->push(itp::multitrack::crop_surface(*tFrame.mSurface, *mSilhouetteTrack->getPool()), tFrame.mTag);
 			}
 		}
 	}
@@ -157,32 +220,29 @@ void HelloKinectMultitrackApp::keyUp(KeyEvent event)
 {
 	switch (event.getChar()) {
 	case 'r': {
+		// Discard silhouettes still in flight:
+		std::vector<itp::ReadbackFrame> tFrames;
+		mSilhouetteReadback->flush(tFrames);
+		mSilhouetteTrack.reset();
+		// Stop feeding matched sets to set tracks before their recorders go away:
+		mFrameSetRecorder->clear();
 		mMultitrackController->cancelRecorder();
+		mMultitrackController->resetTimer();
 		mMultitrackController->start();
 		break;
 	}
 	case 'a': {
-		// Create image recorder callback lambda:
-		auto tImgRecorderCallbackFn = [&](void) -> ci::SurfaceRef
-		{
-			renderSilhouette();
-			return std::make_shared<Surface8u>(mSilhouetteFbo->readPixels8u(mSilhouetteFbo->getBounds()));
-		};
 		// Create image player callback lambda:
-		auto tImgPlayerCallbackFn = [&](const ci::SurfaceRef& iSurface) -> void
+		auto tImgPlayerCallbackFn = [&](const itp::multitrack::CroppedSurfaceRef& iFrame) -> void
 		{
-			if (iSurface.get() == NULL) return;
+			if (iFrame.get() == NULL || iFrame->mSurface.get() == NULL) return;
 			gl::enable(GL_TEXTURE_2D);
-			ci::gl::draw(ci::gl::Texture::create(*(iSurface.get())), ci::app::getWindowBounds());
+			// Draw cropped silhouette at its place in the full frame:
+			ci::gl::draw(ci::gl::Texture::create(*(iFrame->mSurface.get())), iFrame->getDrawRect(ci::Rectf(ci::app::getWindowBounds())));
 		};
-		// Create image recorder track:
-		mMultitrackController->addRecorder<ci::SurfaceRef>(tImgRecorderCallbackFn, tImgPlayerCallbackFn);
+		// Create image recorder track (push mode, fed by silhouette readback in update):
+		mSilhouetteTrack = mMultitrackController->addPushRecorder<itp::multitrack::CroppedSurfaceRef>(tImgPlayerCallbackFn);
 
-		// Create body recorder callback lambda:
-		auto tBodyRecorderCallbackFn = [&](void) -> itp::multitrack::PointCloudRef
-		{
-			return std::make_shared<itp::multitrack::PointCloud>(itp::multitrack::PointCloud(mBodyFrame, mDevice));
-		};
 		// Create body player callback lambda:
 		auto tBodyPlayerCallbackFn = [&](const itp::multitrack::PointCloudRef& iFrame) -> void
 		{
@@ -191,19 +251,110 @@ void HelloKinectMultitrackApp::keyUp(KeyEvent event)
 			gl::scale(vec2(getWindowSize()) / vec2(mChannelBody->getSize()));
 			gl::disable(GL_TEXTURE_2D);
 			gl::color(ColorAf::white());
-			for (const auto& pt : iFrame->mPoints) {
-				gl::drawSolidCircle(pt, 5.0f, 32);
+			for (size_t i = 0; i < iFrame->size(); i++) {
+				gl::drawSolidCircle(iFrame->getPoint(i), 5.0f, 32);
 			}
 		};
-		// Create body recorder track:
-		mMultitrackController->addRecorder<itp::multitrack::PointCloudRef>(tBodyRecorderCallbackFn, tBodyPlayerCallbackFn);
+		// Create body recorder track (push mode, quantized and delta coded in a container, fed with each matched frame set):
+		itp::multitrack::TrackT<itp::multitrack::PointCloudRef>::Ref tBodyTrack = mMultitrackController->addPushRecorder<itp::multitrack::PointCloudRef>(tBodyPlayerCallbackFn, itp::multitrack::TrackFormat::CONTAINER);
+		itp::multitrack::PointCloudCodecSettings tBodySettings;
+		tBodySettings.mQuantize = true;
+		tBodyTrack->setCodecSettings(tBodySettings);
+		mFrameSetRecorder->addTrack<itp::multitrack::PointCloudRef>(
+			tBodyTrack,
+			[](const itp::KinectMatchedFrames& iFrames) { return iFrames.mBodies; });
+
+		// Create depth player callback lambda (draws depth into lower-left corner of window):
+		auto tDepthPlayerCallbackFn = [&](const ci::Channel16uRef& iFrame) -> void
+		{
+			if (iFrame.get() == NULL) return;
+			if (!mChannelDepthPlayback || mChannelDepthPlayback->getSize() != iFrame->getSize()) {
+				mChannelDepthPlayback = ci::Channel8u::create(iFrame->getWidth(), iFrame->getHeight());
+			}
+			mDepthConverter->convert(*iFrame, *mChannelDepthPlayback);
+			gl::enable(GL_TEXTURE_2D);
+			gl::color(ColorAf::white());
+			ci::gl::draw(ci::gl::Texture::create(*(mChannelDepthPlayback.get())), Rectf(0.0f, getWindowHeight() * 0.75f, getWindowWidth() * 0.25f, (float)getWindowHeight()));
+		};
+		// Create depth recorder track (push mode, delta coded in a container, fed with each matched frame set):
+		mFrameSetRecorder->addTrack<ci::Channel16uRef>(
+			mMultitrackController->addPushRecorder<ci::Channel16uRef>(tDepthPlayerCallbackFn, itp::multitrack::TrackFormat::CONTAINER),
+			[](const itp::KinectMatchedFrames& iFrames) { return iFrames.mDepth; });
+
+		// Create body-index player callback lambda (expands runs and draws body index into lower-right corner of window):
+		auto tBodyIndexPlayerCallbackFn = [&](const itp::multitrack::BodyIndexRleRef& iFrame) -> void
+		{
+			if (iFrame.get() == NULL) return;
+			if (!mChannelBodyPlayback || mChannelBodyPlayback->getSize() != iFrame->getSize()) {
+				mChannelBodyPlayback = ci::Channel8u::create(iFrame->getWidth(), iFrame->getHeight());
+			}
+			iFrame->unpack(*mChannelBodyPlayback);
+			gl::enable(GL_TEXTURE_2D);
+			gl::color(ColorAf::white());
+			ci::gl::draw(ci::gl::Texture::create(*(mChannelBodyPlayback.get())), Rectf(getWindowWidth() * 0.75f, getWindowHeight() * 0.75f, (float)getWindowWidth(), (float)getWindowHeight()));
+		};
+		// Create body-index recorder track (push mode, run-length packed into recycled frames, fed with each matched frame set):
+		itp::multitrack::TrackT<itp::multitrack::BodyIndexRleRef>::Ref tBodyIndexTrack = mMultitrackController->addPushRecorder<itp::multitrack::BodyIndexRleRef>(tBodyIndexPlayerCallbackFn, itp::multitrack::TrackFormat::CONTAINER);
+		itp::multitrack::FramePoolT<itp::multitrack::BodyIndexRleRef>::Ref tBodyIndexPool = tBodyIndexTrack->getPool();
+		mFrameSetRecorder->addTrack<itp::multitrack::BodyIndexRleRef>(
+			tBodyIndexTrack,
+			[tBodyIndexPool](const itp::KinectMatchedFrames& iFrames) -> itp::multitrack::BodyIndexRleRef
+			{
+				if (!iFrames.mBody) return itp::multitrack::BodyIndexRleRef();
+				itp::multitrack::BodyIndexRleRef tFrame = tBodyIndexPool->acquire();
+				tFrame->pack(*iFrames.mBody);
+				return tFrame;
+			});
 		//
 		break;
 	}
 	case 'c': {
+		// Record silhouettes still in flight:
+		std::vector<itp::ReadbackFrame> tFrames;
+		mSilhouetteReadback->flush(tFrames);
+		for (const auto& tFrame : tFrames) {
+			mSilhouetteTrack->push(itp::multitrack::crop_surface(*tFrame.mSurface, *mSilhouetteTrack->getPool()), tFrame.mTag);
+		}
+		mSilhouetteTrack.reset();
+		// Stop feeding matched sets to set tracks before they switch to playback:
+		mFrameSetRecorder->clear();
 		mMultitrackController->completeRecorder();
 		break;
 	}
+	case 'e': {
+		// Export first ten seconds of sequence at 30 fps, compositing each step into an offscreen buffer:
+		ci::gl::FboRef tExportFbo = ci::gl::Fbo::create(getWindowWidth(), getWindowHeight());
+		gl::ScopedFramebuffer fbScp(tExportFbo);
+		gl::ScopedViewport scpVp(ivec2(0), tExportFbo->getSize());
+		gl::setMatricesWindow(tExportFbo->getSize());
+		gl::clear(Color(0, 0, 0));
+		auto tCaptureFn = [&](void) -> ci::SurfaceRef
+		{
+			ci::SurfaceRef tFrame = std::make_shared<Surface8u>(tExportFbo->readPixels8u(tExportFbo->getBounds()));
+			gl::clear(Color(0, 0, 0));
+			return tFrame;
+		};
+		mMultitrackController->render<ci::SurfaceRef>(30.0, 10.0, tCaptureFn, getHomeDirectory() / "Desktop" / "Tests" / "export");
+		break;
+	}
+	case 'l': {
+		// Benchmark depth-to-color lookup builders on current depth frame:
+		if (mChannelDepth) {
+			std::vector<ci::ivec2> tMappingPoints = mDevice->mapDepthToColor(mChannelDepth);
+			itp::DepthToColorLookupBenchmark tResult = itp::benchmark_depth_to_color_lookup(tMappingPoints, mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+			ci::app::console() << "Lookup (ms/frame): reference " << tResult.mReferenceMs << ", single " << tResult.mSingleMs << ", parallel " << tResult.mParallelMs << std::endl;
+		}
+		break;
+	}
+	case 'k': {
+		// Benchmark surface codecs on current silhouette frame:
+		renderSilhouette();
+		ci::Surface8u tSilhouette = mSilhouetteFbo->readPixels8u(mSilhouetteFbo->getBounds());
+		itp::multitrack::SurfaceCodecBenchmark tResult = itp::multitrack::benchmark_surface_codecs(tSilhouette);
+		ci::app::console() << "PNG: ratio " << tResult.mPngRatio << ", encode " << tResult.mPngEncodeMBps << " MB/s, decode " << tResult.mPngDecodeMBps << " MB/s" << std::endl;
+		ci::app::console() << "QOI: ratio " << tResult.mQoiRatio << ", encode " << tResult.mQoiEncodeMBps << " MB/s, decode " << tResult.mQoiDecodeMBps << " MB/s" << std::endl;
+		break;
+	}
 	default: { break; }
 	}
 }
@@ -227,11 +378,13 @@ void HelloKinectMultitrackApp::renderSilhouette()
 		// Bind color texture:
 		mTextureColor->bind(0);
 		// Generate depth texture:
-		if (mTextureDepth) {
-			mTextureDepth->update(*(Kinect2::channel16To8(mChannelDepth).get()));
-		}
-		else {
-			mTextureDepth = ci::gl::Texture::create(*(Kinect2::channel16To8(mChannelDepth).get()));
+		if (mDepthConverter->update(mChannelDepth, mTimeStamp, mChannelDepth8) || !mTextureDepth) {
+			if (mTextureDepth) {
+				mTextureDepth->update(*(mChannelDepth8.get()));
+			}
+			else {
+				mTextureDepth = ci::gl::Texture::create(*(mChannelDepth8.get()));
+			}
 		}
 		// Bind depth texture:
 		mTextureDepth->bind(1);
@@ -7,7 +7,12 @@
 
 #include "Kinect2.h"
 
+#include <FrameHandoff.h>
+#include <FrameReadback.h>
+#include <FrameSynchronizer.h>
+#include <KinectProcessingDepth.h>
 #include <KinectProcessingGlsl.h>
+#include <KinectProcessingLookup.h>
 #include <multitrack/Controller.h>
 
 #include <foil/oss/gesture/recognizer.hpp>
@@ -48,6 +53,7 @@ public:
 	void cancelRecording();
 
 	bool addGestureTemplate(const std::string& poseName);
+	bool updateGesturePoints();
 	void renderSilhouette();
 
 	long long							mTimeStamp;
@@ -62,8 +68,14 @@ public:
 	ci::Channel8uRef					mChannelBody;
 	ci::Surface8uRef					mSurfaceColor;
 	ci::Channel16uRef					mChannelDepth;
+	ci::Channel8uRef					mChannelDepth8;
+	itp::KinectFrameHandoff::Ref		mKinectFrames;
+	itp::KinectFrameSynchronizer::Ref	mFrameSync;
 
 	ci::Surface32fRef					mSurfaceLookup;
+	itp::DepthToColorTable::Ref			mDepthToColorTable;
+	itp::DepthToColorLookup::Ref		mDepthToColorLookup;
+	itp::DepthConverter::Ref			mDepthConverter;
 
 	ci::gl::TextureRef					mTextureBody;
 	ci::gl::TextureRef					mTextureColor;
@@ -72,6 +84,12 @@ public:
 
 	ci::gl::FboRef						mSilhouetteFbo;
 
+	itp::multitrack::FramePoolT<ci::SurfaceRef>::Ref	mSurfacePool;
+	itp::multitrack::FramePoolT<itp::multitrack::PointCloudRef>::Ref	mBodyPool;
+
+	itp::FrameReadback::Ref				mSilhouetteReadback;
+	itp::multitrack::TrackT<itp::multitrack::CroppedSurfaceRef>::Ref	mSilhouetteTrack;
+
 	itp::multitrack::Controller::Ref	mMultitrackController;
 
 	ci::Font							mFont;
@@ -84,6 +102,8 @@ public:
 	bool								mEstablishedPoseControl;
 
 	foil::gesture::Recognizer			mRecognizer;
+	itp::multitrack::PointCloud			mGestureCloud;
+	std::deque<ci::vec2>				mGesturePoints;
 };
 
 void HelloKinectMultitrackGestureApp::setup()
@@ -109,7 +129,25 @@ void HelloKinectMultitrackGestureApp::setup()
 		ci::app::console() << "Unknown GLSL Error" << std::endl;
 		quit();
 	}
-	// Initialize Kinect and register callbacks:
+	// Setup depth-to-color table (only pixels whose depth moved more than 8mm are re-evaluated):
+	mDepthToColorTable = itp::DepthToColorTable::create();
+	mDepthToColorTable->setChangeThreshold(8);
+	// Setup depth display converter (depth texture is only refreshed when a new depth frame arrives):
+	mDepthConverter = itp::DepthConverter::create();
+	// Initialize Kinect and register callbacks (stream frames are handed to update() through a lock-free triple buffer):
+	mKinectFrames = itp::KinectFrameHandoff::create();
+	// Match stream frames by sensor timestamp, so each frame set comes from a single sensor tick:
+	mFrameSync = itp::KinectFrameSynchronizer::create();
+	mFrameSync->setStreamEnabled(itp::KinectFrameSynchronizer::BODY, false);
+	mFrameSync->setMatchFn([&](const itp::KinectMatchedFrames& iFrames)
+	{
+		itp::KinectFrameSet& tFrames = mKinectFrames->getWriteBuffer();
+		tFrames.mColor = iFrames.mColor;
+		tFrames.mDepth = iFrames.mDepth;
+		tFrames.mBody = iFrames.mBody;
+		tFrames.mTimeStamp = iFrames.mTimeStamp;
+		mKinectFrames->publish();
+	});
 	mDevice = Kinect2::Device::create();
 	mDevice->start();
 	mDevice->connectBodyEventHandler([&](const Kinect2::BodyFrame& frame)
@@ -124,20 +162,24 @@ void HelloKinectMultitrackGestureApp::setup()
 	});
 	mDevice->connectBodyIndexEventHandler([&](const Kinect2::BodyIndexFrame& frame)
 	{
-		mChannelBody = frame.getChannel();
+		mFrameSync->pushBodyIndex(frame.getChannel(), frame.getTimeStamp());
 	});
 	mDevice->connectColorEventHandler([&](const Kinect2::ColorFrame& frame)
 	{
-		mSurfaceColor = frame.getSurface();
+		mFrameSync->pushColor(frame.getSurface(), frame.getTimeStamp());
 	});
 	mDevice->connectDepthEventHandler([&](const Kinect2::DepthFrame& frame)
 	{
-		mChannelDepth = frame.getChannel();
-		mTimeStamp = frame.getTimeStamp();
+		mFrameSync->pushDepth(frame.getChannel(), frame.getTimeStamp());
 	});
 	// Setup FBO:
 	ci::gl::Fbo::Format tSilhouetteFboFormat;
 	mSilhouetteFbo = ci::gl::Fbo::create(RAW_FRAME_WIDTH, RAW_FRAME_HEIGHT, tSilhouetteFboFormat.colorTexture());
+	// Setup frame pools (recorded frames are recycled once written):
+	mSurfacePool = itp::multitrack::FramePoolT<ci::SurfaceRef>::create();
+	mBodyPool = itp::multitrack::FramePoolT<itp::multitrack::PointCloudRef>::create();
+	// Setup asynchronous silhouette readback (frames return three captures later):
+	mSilhouetteReadback = itp::PboReadback::create(mSilhouetteFbo, 3, mSurfacePool);
 	// Setup multitrack controller:
 	mMultitrackController = itp::multitrack::Controller::create(getHomeDirectory() / "Desktop" / "Tests");
 	mMultitrackController->start();
@@ -153,26 +195,40 @@ void HelloKinectMultitrackGestureApp::setup()
 
 void HelloKinectMultitrackGestureApp::update()
 {
+	// Take latest frame set published by Kinect event handlers:
+	if (mKinectFrames->acquire()) {
+		const itp::KinectFrameSet& tFrames = mKinectFrames->getReadBuffer();
+		mSurfaceColor = tFrames.mColor;
+		mChannelDepth = tFrames.mDepth;
+		mChannelBody = tFrames.mBody;
+		mTimeStamp = tFrames.mTimeStamp;
+	}
 	// Check whether depth-to-color mapping update is needed:
 	if ((mTimeStamp != mTimeStampPrev) && mSurfaceColor && mChannelDepth) {
 		// Update timestamp:
 		mTimeStampPrev = mTimeStamp;
-		// Initialize lookup surface:
-		mSurfaceLookup = ci::Surface32f::create(mChannelDepth->getWidth(), mChannelDepth->getHeight(), false, ci::SurfaceChannelOrder::RGB);
-		// Get depth-to-color mapping points:
-		std::vector<ci::ivec2> tMappingPoints = mDevice->mapDepthToColor(mChannelDepth);
-		// Get color frame dimension:
-		ci::vec2 tColorFrameDim(Kinect2::ColorFrame().getSize());
-		// Prepare iterators:
-		ci::Surface32f::Iter iter = mSurfaceLookup->getIter();
-		std::vector<ci::ivec2>::iterator v = tMappingPoints.begin();
-		// Create lookup mapping:
-		while (iter.line()) {
-			while (iter.pixel()) {
-				iter.r() = (float)v->x / tColorFrameDim.x;
-				iter.g() = 1.0f - (float)v->y / tColorFrameDim.y;
-				iter.b() = 0.0f;
-				++v;
+		// Calibrate depth-to-color table once (falls back to full per-frame mapping if the fit is off by more than a color pixel):
+		if (!mDepthToColorTable->isCalibrated()) {
+			mDepthToColorTable->calibrate(mDevice, mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+			if (mDepthToColorTable->getFitError() > 1.0f) {
+				ci::app::console() << "Depth-to-color fit error " << mDepthToColorTable->getFitError() << "px, using full mapping" << std::endl;
+				mDepthToColorLookup = itp::DepthToColorLookup::create();
+			}
+		}
+		// Evaluate lookup surface from depth values, or map every depth pixel (buffers are reused across frames):
+		if (mDepthToColorLookup) {
+			mSurfaceLookup = mDepthToColorLookup->update(mDevice->mapDepthToColor(mChannelDepth), mChannelDepth->getSize(), ci::vec2(Kinect2::ColorFrame().getSize()));
+		}
+		else {
+			mDepthToColorTable->update(mChannelDepth);
+			mSurfaceLookup = mDepthToColorTable->getSurface();
+		}
+		// Capture silhouette of new frame set and record capture that completed (cropped to its alpha bounds into a recycled frame), stamped with its sensor time:
+		if (mSilhouetteTrack) {
+			renderSilhouette();
+			itp::ReadbackFrame tFrame;
+			if (mSilhouetteReadback->capture(mTimeStamp, tFrame)) {
+				mSilhouetteTrack->push(itp::multitrack::crop_surface(*tFrame.mSurface, *mSilhouetteTrack->getPool()), tFrame.mTag);
 			}
 		}
 	}
@@ -197,12 +253,10 @@ void HelloKinectMultitrackGestureApp::update()
 			else {
 				// Check whether recognizer has templates:
 				if (mRecognizer.hasTemplates()) {
-					// Get point cloud:
-					itp::multitrack::PointCloud tCloud = itp::multitrack::PointCloud(mBodyFrame, mDevice);
 					// Check for correct point count for single body:
-					if (tCloud.mPoints.size() == 25) {
+					if (updateGesturePoints()) {
 						// Get gesture guess:
-						foil::gesture::Result tResult = mRecognizer.recognizeBest({ tCloud.mPoints });
+						foil::gesture::Result tResult = mRecognizer.recognizeBest({ mGesturePoints });
 						// Check for control gesture:
 						if (tResult.mName == "CONTROL" && tResult.mScore >= kRecognitionThreshold) {
 							mAppState = AppState::BEGIN_RECORDING;
@@ -262,12 +316,10 @@ void HelloKinectMultitrackGestureApp::update()
 		else if (mAppState == AppState::RECORDING_TRACK) {
 			// Check whether recognizer has templates:
 			if (mRecognizer.hasTemplates()) {
-				// Get point cloud:
-				itp::multitrack::PointCloud tCloud = itp::multitrack::PointCloud(mBodyFrame, mDevice);
 				// Check for correct point count for single body:
-				if (tCloud.mPoints.size() == 25) {
+				if (updateGesturePoints()) {
 					// Get gesture guess:
-					foil::gesture::Result tResult = mRecognizer.recognizeBest({ tCloud.mPoints });
+					foil::gesture::Result tResult = mRecognizer.recognizeBest({ mGesturePoints });
 					// Check for control gesture:
 					if (tResult.mName == "CONTROL" && tResult.mScore >= kRecognitionThreshold) {
 						mAppState = AppState::END_RECORDING;
@@ -338,26 +390,23 @@ void HelloKinectMultitrackGestureApp::keyUp(KeyEvent event)
 
 void HelloKinectMultitrackGestureApp::startRecording()
 {
-	// Create image recorder callback lambda:
-	auto tImgRecorderCallbackFn = [&](void) -> ci::SurfaceRef
-	{
-		renderSilhouette();
-		return std::make_shared<Surface8u>(mSilhouetteFbo->readPixels8u(mSilhouetteFbo->getBounds()));
-	};
 	// Create image player callback lambda:
-	auto tImgPlayerCallbackFn = [&](const ci::SurfaceRef& iSurface) -> void
+	auto tImgPlayerCallbackFn = [&](const itp::multitrack::CroppedSurfaceRef& iFrame) -> void
 	{
-		if (iSurface.get() == NULL) return;
+		if (iFrame.get() == NULL || iFrame->mSurface.get() == NULL) return;
 		gl::enable(GL_TEXTURE_2D);
-		ci::gl::draw(ci::gl::Texture::create(*(iSurface.get())), ci::app::getWindowBounds());
+		// Draw cropped silhouette at its place in the full frame:
+		ci::gl::draw(ci::gl::Texture::create(*(iFrame->mSurface.get())), iFrame->getDrawRect(ci::Rectf(ci::app::getWindowBounds())));
 	};
-	// Create image recorder track:
-	mMultitrackController->addRecorder<ci::SurfaceRef>(tImgRecorderCallbackFn, tImgPlayerCallbackFn);
+	// Create image recorder track (push mode, fed by silhouette readback in update):
+	mSilhouetteTrack = mMultitrackController->addPushRecorder<itp::multitrack::CroppedSurfaceRef>(tImgPlayerCallbackFn);
 
 	// Create body recorder callback lambda:
 	auto tBodyRecorderCallbackFn = [&](void) -> itp::multitrack::PointCloudRef
 	{
-		return std::make_shared<itp::multitrack::PointCloud>(itp::multitrack::PointCloud(mBodyFrame, mDevice));
+		itp::multitrack::PointCloudRef tBodies = mBodyPool->acquire();
+		tBodies->set(mBodyFrame, mDevice);
+		return tBodies;
 	};
 	// Create body player callback lambda:
 	auto tBodyPlayerCallbackFn = [&](const itp::multitrack::PointCloudRef& iFrame) -> void
@@ -367,8 +416,8 @@ void HelloKinectMultitrackGestureApp::startRecording()
 		gl::scale(vec2(getWindowSize()) / vec2(mChannelBody->getSize()));
 		gl::disable(GL_TEXTURE_2D);
 		gl::color(ColorAf::white());
-		for (const auto& pt : iFrame->mPoints) {
-			gl::drawSolidCircle(pt, 5.0f, 32);
+		for (size_t i = 0; i < iFrame->size(); i++) {
+			gl::drawSolidCircle(iFrame->getPoint(i), 5.0f, 32);
 		}
 	};
 	// Create body recorder track:
@@ -377,23 +426,45 @@ void HelloKinectMultitrackGestureApp::startRecording()
 
 void HelloKinectMultitrackGestureApp::completeRecording()
 {
+	// Record silhouettes still in flight:
+	std::vector<itp::ReadbackFrame> tFrames;
+	mSilhouetteReadback->flush(tFrames);
+	for (const auto& tFrame : tFrames) {
+		mSilhouetteTrack->push(itp::multitrack::crop_surface(*tFrame.mSurface, *mSilhouetteTrack->getPool()), tFrame.mTag);
+	}
+	mSilhouetteTrack.reset();
 	mMultitrackController->completeRecorder();
+	mMultitrackController->resetTimer();
 	mMultitrackController->start();
 }
 
 void HelloKinectMultitrackGestureApp::cancelRecording()
 {
+	// Discard silhouettes still in flight:
+	std::vector<itp::ReadbackFrame> tFrames;
+	mSilhouetteReadback->flush(tFrames);
+	mSilhouetteTrack.reset();
 	mMultitrackController->cancelRecorder();
+	mMultitrackController->resetTimer();
 	mMultitrackController->start();
 }
 
+bool HelloKinectMultitrackGestureApp::updateGesturePoints()
+{
+	// Refill point cloud (no allocation):
+	mGestureCloud.set(mBodyFrame, mDevice);
+	// Check for correct point count for single body:
+	if (mGestureCloud.size() != itp::multitrack::PointCloud::kJointCount) return false;
+	// Copy points into reused recognizer input:
+	mGestureCloud.copyPoints(mGesturePoints);
+	return true;
+}
+
 bool HelloKinectMultitrackGestureApp::addGestureTemplate(const std::string& poseName)
 {
-	// Get point cloud:
-	itp::multitrack::PointCloud tCloud = itp::multitrack::PointCloud(mBodyFrame, mDevice);
 	// Check for correct point count for single body:
-	if (tCloud.mPoints.size() == 25) {
-		mRecognizer.addTemplate(poseName, { tCloud.mPoints });
+	if (updateGesturePoints()) {
+		mRecognizer.addTemplate(poseName, { mGesturePoints });
 		return true;
 	}
 	return false;
@@ -418,11 +489,13 @@ void HelloKinectMultitrackGestureApp::renderSilhouette()
 		// Bind color texture:
 		mTextureColor->bind(0);
 		// Generate depth texture:
-		if (mTextureDepth) {
-			mTextureDepth->update(*(Kinect2::channel16To8(mChannelDepth).get()));
-		}
-		else {
-			mTextureDepth = ci::gl::Texture::create(*(Kinect2::channel16To8(mChannelDepth).get()));
+		if (mDepthConverter->update(mChannelDepth, mTimeStamp, mChannelDepth8) || !mTextureDepth) {
+			if (mTextureDepth) {
+				mTextureDepth->update(*(mChannelDepth8.get()));
+			}
+			else {
+				mTextureDepth = ci::gl::Texture::create(*(mChannelDepth8.get()));
+			}
 		}
 		// Bind depth texture:
 		mTextureDepth->bind(1);
@@ -0,0 +1,327 @@
+/* ITP Future of Storytelling */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <multitrack/TypeTrack.h>
+
+using namespace itp;
+
+namespace {
+
+	/** @brief deterministic pseudo-random generator (LCG), so failures reproduce */
+	struct Lcg
+	{
+		uint32_t mState;
+
+		Lcg(uint32_t iSeed) : mState( iSeed ) { /* no-op */ }
+
+		uint32_t next()				{ mState = mState * 1664525u + 1013904223u; return mState >> 8; }
+		float nextUnit()			{ return (float)next() / (float)( 1u << 24 ); }
+	};
+
+	/** @brief prints one check and returns its outcome */
+	bool report(const char* iName, bool iOk)
+	{
+		std::printf( "%-40s %s\n", iName, iOk ? "ok" : "FAILED" );
+		return iOk;
+	}
+
+	/** @brief returns true if reading a container throws */
+	bool throws_on_open(const ci::fs::path& iPath, bool iMapped)
+	{
+		try {
+			multitrack::ContainerReader::create( iPath, iMapped );
+		}
+		catch( const std::runtime_error& ) {
+			return true;
+		}
+		return false;
+	}
+
+	/** @brief writes payloads into a container at 30 frames per second, flagging every fourth one as keyframe */
+	void write_container(const ci::fs::path& iPath, const std::vector<std::vector<uint8_t>>& iFrames)
+	{
+		multitrack::ContainerWriter::Ref tWriter = multitrack::ContainerWriter::create( iPath, "raw" );
+		for( size_t i = 0; i < iFrames.size(); i++ ) {
+			tWriter->append( (double)i / 30.0, iFrames[ i ], ( i % 4 == 0 ) ? multitrack::kContainerFrameKeyframe : 0 );
+		}
+		tWriter->close();
+	}
+
+	/** @brief writes frames of random sizes into a container, then reads them back streamed and mapped, after losing its index and with a corrupt index */
+	bool test_container(const ci::fs::path& iDirectory)
+	{
+		const size_t tFrameCount = 20;
+		ci::fs::path tPath = iDirectory / "container.bin";
+		Lcg tRandom( 7u );
+		std::vector<std::vector<uint8_t>> tFrames( tFrameCount );
+		for( size_t i = 0; i < tFrameCount; i++ ) {
+			tFrames[ i ].resize( ( i == 3 ) ? 0 : tRandom.next() % 300 );
+			for( uint8_t& tByte : tFrames[ i ] ) tByte = (uint8_t)tRandom.next();
+		}
+		write_container( tPath, tFrames );
+		bool tPassed = true;
+		// Read back index and payloads:
+		for( int tMapped = 0; tMapped < 2; tMapped++ ) {
+			multitrack::ContainerReader::Ref tReader = multitrack::ContainerReader::create( tPath, tMapped != 0 );
+			bool tOk = ( tReader->size() == tFrameCount && ! tReader->isRecovered() && tReader->getCodec() == "raw" );
+			std::vector<uint8_t> tData;
+			for( size_t i = 0; tOk && i < tFrameCount; i++ ) {
+				tReader->read( i, tData );
+				const multitrack::ContainerIndexEntry& tEntry = tReader->getIndex()[ i ];
+				tOk = ( tData == tFrames[ i ] && tEntry.mTime == (double)i / 30.0 && ( ( tEntry.mFlags & multitrack::kContainerFrameKeyframe ) != 0 ) == ( i % 4 == 0 ) );
+			}
+			tOk = tOk && ( multitrack::get_container_keyframes( tReader->getIndex() ).size() == 5 );
+			tPassed = report( tMapped ? "container round trip (mapped)" : "container round trip", tOk ) && tPassed;
+		}
+		// Drop index and half of the last payload, as if recording stopped abruptly:
+		uint64_t tTruncated;
+		{
+			multitrack::ContainerReader::Ref tReader = multitrack::ContainerReader::create( tPath );
+			const multitrack::ContainerIndexEntry& tLast = tReader->getIndex().back();
+			tTruncated = tLast.mOffset + tLast.mSize / 2;
+		}
+		ci::fs::path tRecoverPath = iDirectory / "recover.bin";
+		write_container( tRecoverPath, tFrames );
+		ci::fs::resize_file( tRecoverPath, tTruncated );
+		{
+			multitrack::ContainerReader::Ref tReader = multitrack::ContainerReader::create( tRecoverPath );
+			bool tOk = ( tReader->isRecovered() && tReader->size() == tFrameCount - 1 );
+			std::vector<uint8_t> tData;
+			for( size_t i = 0; tOk && i < tReader->size(); i++ ) {
+				tReader->read( i, tData );
+				tOk = ( tData == tFrames[ i ] );
+			}
+			tPassed = report( "container recovery", tOk ) && tPassed;
+		}
+		// Point an index entry past the end of the file:
+		ci::fs::path tCorruptPath = iDirectory / "corrupt.bin";
+		write_container( tCorruptPath, tFrames );
+		{
+			uint64_t tFileSize = ci::fs::file_size( tCorruptPath );
+			std::fstream tFile( tCorruptPath.string(), std::ios::in | std::ios::out | std::ios::binary );
+			multitrack::ContainerFooter tFooter;
+			tFile.seekg( static_cast<std::streamoff>( tFileSize - sizeof( tFooter ) ) );
+			tFile.read( reinterpret_cast<char*>( &tFooter ), sizeof( tFooter ) );
+			multitrack::ContainerIndexEntry tEntry;
+			std::streamoff tEntryOffset = static_cast<std::streamoff>( tFooter.mIndexOffset + 5 * sizeof( tEntry ) );
+			tFile.seekg( tEntryOffset );
+			tFile.read( reinterpret_cast<char*>( &tEntry ), sizeof( tEntry ) );
+			tEntry.mSize = ~0ULL - tEntry.mOffset / 2;
+			tFile.seekp( tEntryOffset );
+			tFile.write( reinterpret_cast<const char*>( &tEntry ), sizeof( tEntry ) );
+		}
+		tPassed = report( "container corrupt index", throws_on_open( tCorruptPath, false ) && throws_on_open( tCorruptPath, true ) ) && tPassed;
+		return tPassed;
+	}
+
+	/** @brief returns true if two channels hold equal values */
+	template<typename V> bool equal_channels(const ci::ChannelT<V>& iA, const ci::ChannelT<V>& iB)
+	{
+		if( iA.getSize() != iB.getSize() ) return false;
+		for( int32_t y = 0; y < iA.getHeight(); y++ ) {
+			for( int32_t x = 0; x < iA.getWidth(); x++ ) {
+				if( *iA.getData( ci::ivec2( x, y ) ) != *iB.getData( ci::ivec2( x, y ) ) ) return false;
+			}
+		}
+		return true;
+	}
+
+	/** @brief delta codes a channel sequence (partly changing frames and one size change), then decodes it in order, in reverse and at random, streamed and mapped */
+	template<typename V> bool test_channel_delta(const ci::fs::path& iDirectory, const char* iName, size_t iKeyframeInterval)
+	{
+		typedef std::shared_ptr<ci::ChannelT<V>> ChannelRef;
+		const size_t tFrameCount = 24;
+		Lcg tRandom( 11u );
+		std::vector<ChannelRef> tFrames;
+		for( size_t i = 0; i < tFrameCount; i++ ) {
+			ci::ivec2 tSize = ( i < 16 ) ? ci::ivec2( 37, 23 ) : ci::ivec2( 19, 41 );
+			ChannelRef tFrame = ci::ChannelT<V>::create( tSize.x, tSize.y );
+			// Copy previous frame of same size and change a band of it:
+			bool tCopy = ( i > 0 && tFrames.back()->getSize() == tSize );
+			int32_t tBand = (int32_t)( tRandom.next() % tSize.y );
+			for( int32_t y = 0; y < tSize.y; y++ ) {
+				for( int32_t x = 0; x < tSize.x; x++ ) {
+					V tValue = tCopy ? *tFrames.back()->getData( ci::ivec2( x, y ) ) : (V)tRandom.next();
+					if( std::abs( y - tBand ) < 2 ) tValue = (V)tRandom.next();
+					*tFrame->getData( ci::ivec2( x, y ) ) = tValue;
+				}
+			}
+			tFrames.push_back( tFrame );
+		}
+		// Encode into container:
+		ci::fs::path tPath = iDirectory / ( std::string( iName ) + ".bin" );
+		multitrack::FrameCodecSettings tSettings;
+		tSettings.mKeyframeInterval = iKeyframeInterval;
+		{
+			typename multitrack::ChannelDeltaEncoderT<V>::Ref tEncoder = multitrack::ChannelDeltaEncoderT<V>::create( tSettings );
+			multitrack::ContainerWriter::Ref tWriter = multitrack::ContainerWriter::create( tPath, "raw" );
+			std::vector<uint8_t> tData;
+			for( size_t i = 0; i < tFrameCount; i++ ) {
+				uint32_t tFlags = tEncoder->encode( tData, tFrames[ i ] );
+				tWriter->append( (double)i / 30.0, tData, tFlags );
+			}
+			tWriter->close();
+		}
+		// Decode in order, reverse and random order:
+		std::vector<size_t> tOrder;
+		for( size_t i = 0; i < tFrameCount; i++ ) tOrder.push_back( i );
+		for( size_t i = tFrameCount; i > 0; i-- ) tOrder.push_back( i - 1 );
+		for( size_t i = 0; i < tFrameCount; i++ ) tOrder.push_back( tRandom.next() % tFrameCount );
+		bool tPassed = true;
+		for( int tMapped = 0; tMapped < 2; tMapped++ ) {
+			multitrack::ContainerReader::Ref tReader = multitrack::ContainerReader::create( tPath, tMapped != 0 );
+			typename multitrack::ChannelDeltaDecoderT<V>::Ref tDecoder = multitrack::ChannelDeltaDecoderT<V>::create( tReader );
+			typename multitrack::FramePoolT<ChannelRef>::Ref tPool = multitrack::FramePoolT<ChannelRef>::create();
+			std::vector<uint8_t> tBuffer;
+			bool tOk = ( tDecoder->isTemporal() == ( iKeyframeInterval > 1 ) );
+			for( size_t tIndex : tOrder ) {
+				tOk = tOk && equal_channels<V>( *tDecoder->decode( tIndex, tBuffer, *tPool ), *tFrames[ tIndex ] );
+			}
+			// Raw tracks are viewed in place:
+			if( tMapped && ! tDecoder->isTemporal() ) {
+				for( size_t i = 0; tOk && i < tFrameCount; i++ ) {
+					std::shared_ptr<const ci::ChannelT<V>> tView = multitrack::view_channel_from_buffer<V>( tReader->getPayload( i ), static_cast<size_t>( tReader->getIndex()[ i ].mSize ), tReader->getMapping() );
+					tOk = equal_channels<V>( *tView, *tFrames[ i ] );
+				}
+			}
+			std::string tLabel = std::string( iName ) + ( tMapped ? " (mapped)" : "" );
+			tPassed = report( tLabel.c_str(), tOk ) && tPassed;
+		}
+		return tPassed;
+	}
+
+	/** @brief returns true if clouds hold the same points, with coordinates at most iTolerance apart */
+	bool equal_clouds(const multitrack::PointCloud& iA, const multitrack::PointCloud& iB, float iTolerance)
+	{
+		if( iA.size() != iB.size() || std::memcmp( iA.mBodyId, iB.mBodyId, sizeof( iA.mBodyId ) ) != 0 ) return false;
+		for( size_t i = 0; i < iA.size(); i++ ) {
+			if( std::abs( iA.mX[ i ] - iB.mX[ i ] ) > iTolerance || std::abs( iA.mY[ i ] - iB.mY[ i ] ) > iTolerance ) return false;
+			if( iA.mState[ i ] != iB.mState[ i ] || iA.mJoint[ i ] != iB.mJoint[ i ] || iA.mBody[ i ] != iB.mBody[ i ] ) return false;
+		}
+		return true;
+	}
+
+	/** @brief codes a moving two-body cloud sequence (a body leaves halfway) and decodes it in order and at random */
+	bool test_point_cloud(const ci::fs::path& iDirectory, const char* iName, bool iQuantize, multitrack::TrackFormat iFormat)
+	{
+		const size_t tFrameCount = 20;
+		Lcg tRandom( 13u );
+		std::vector<multitrack::PointCloudRef> tFrames;
+		for( size_t i = 0; i < tFrameCount; i++ ) {
+			multitrack::PointCloudRef tCloud = std::make_shared<multitrack::PointCloud>();
+			size_t tBodies = ( i < tFrameCount / 2 ) ? 2 : 1;
+			for( uint8_t b = 0; b < tBodies; b++ ) {
+				tCloud->mBodyId[ b ] = 1000 + b;
+				for( uint8_t j = 0; j < multitrack::PointCloud::kJointCount; j++ ) {
+					ci::vec2 tPoint( 100.0f + 200.0f * b + 3.0f * j + 0.5f * i + tRandom.nextUnit(), 50.0f + 11.0f * j - 0.25f * i + tRandom.nextUnit() );
+					tCloud->push_back( tPoint, (uint8_t)( tRandom.next() % 3 ), j, b );
+				}
+			}
+			tFrames.push_back( tCloud );
+		}
+		// Plain binary encoding is exact:
+		bool tPassed = true;
+		bool tOk = true;
+		std::vector<uint8_t> tData;
+		for( const multitrack::PointCloudRef& tCloud : tFrames ) {
+			multitrack::write_to_buffer<multitrack::PointCloudRef>( tData, tCloud );
+			tOk = tOk && equal_clouds( *multitrack::read_from_buffer<multitrack::PointCloudRef>( &tData[ 0 ], tData.size() ), *tCloud, 0.0f );
+		}
+		// Encode into container:
+		ci::fs::path tPath = iDirectory / ( std::string( iName ) + ".bin" );
+		multitrack::PointCloudCodecSettings tSettings;
+		tSettings.mQuantize			= iQuantize;
+		tSettings.mKeyframeInterval	= 6;
+		{
+			multitrack::PointCloudDeltaEncoder::Ref tEncoder = multitrack::PointCloudDeltaEncoder::create( tSettings, iFormat );
+			multitrack::ContainerWriter::Ref tWriter = multitrack::ContainerWriter::create( tPath, "pcb" );
+			for( size_t i = 0; i < tFrameCount; i++ ) {
+				uint32_t tFlags = tEncoder->encode( tData, tFrames[ i ] );
+				tWriter->append( (double)i / 30.0, tData, tFlags );
+			}
+			tWriter->close();
+		}
+		// Decode in order, then at random (quantized coordinates are off by at most half a step):
+		bool tMapped = ( iFormat == multitrack::TrackFormat::MAPPED );
+		float tTolerance = iQuantize ? 0.5f / tSettings.mScale + 1e-4f : 0.0f;
+		multitrack::ContainerReader::Ref tReader = multitrack::ContainerReader::create( tPath, tMapped );
+		multitrack::PointCloudDeltaDecoder::Ref tDecoder = multitrack::PointCloudDeltaDecoder::create( tReader );
+		multitrack::FramePoolT<multitrack::PointCloudRef>::Ref tPool = multitrack::FramePoolT<multitrack::PointCloudRef>::create();
+		std::vector<uint8_t> tBuffer;
+		tOk = tOk && ( tDecoder->isTemporal() == iQuantize );
+		for( size_t i = 0; i < 2 * tFrameCount; i++ ) {
+			size_t tIndex = ( i < tFrameCount ) ? i : tRandom.next() % tFrameCount;
+			tOk = tOk && equal_clouds( *tDecoder->decode( tIndex, tBuffer, *tPool ), *tFrames[ tIndex ], tTolerance );
+		}
+		// Float images of mapped tracks are viewed in place:
+		if( tMapped && ! iQuantize ) {
+			for( size_t i = 0; tOk && i < tFrameCount; i++ ) {
+				multitrack::PointCloudViewRef tView = multitrack::view_from_buffer<multitrack::PointCloudRef>( tReader->getPayload( i ), static_cast<size_t>( tReader->getIndex()[ i ].mSize ), tReader->getMapping() );
+				const multitrack::PointCloud& tCloud = *tFrames[ i ];
+				tOk = ( tView->size() == tCloud.size() && std::memcmp( tView->mX, tCloud.mX, tCloud.size() * sizeof( float ) ) == 0 && std::memcmp( tView->mY, tCloud.mY, tCloud.size() * sizeof( float ) ) == 0 );
+			}
+		}
+		return report( iName, tOk ) && tPassed;
+	}
+
+	/** @brief packs and unpacks body-index frames with runs of random length, and frames without bodies or of one body */
+	bool test_body_index_rle()
+	{
+		const ci::ivec2 tSize( 203, 61 );
+		Lcg tRandom( 17u );
+		bool tOk = true;
+		for( int tCase = 0; tCase < 3; tCase++ ) {
+			ci::Channel8u tBody( tSize.x, tSize.y );
+			uint8_t tValue = multitrack::BodyIndexRle::kBackground;
+			for( int32_t y = 0; y < tSize.y; y++ ) {
+				for( int32_t x = 0; x < tSize.x; x++ ) {
+					if( tCase == 0 && tRandom.next() % 13 == 0 ) tValue = ( tRandom.next() % 2 ) ? (uint8_t)( tRandom.next() % 6 ) : multitrack::BodyIndexRle::kBackground;
+					*tBody.getData( ci::ivec2( x, y ) ) = ( tCase == 1 ) ? multitrack::BodyIndexRle::kBackground : ( tCase == 2 ) ? (uint8_t)3 : tValue;
+				}
+			}
+			multitrack::BodyIndexRle tRle;
+			tRle.pack( tBody );
+			ci::Channel8u tUnpacked( tSize.x, tSize.y );
+			tRle.unpack( tUnpacked );
+			tOk = tOk && equal_channels<uint8_t>( tUnpacked, tBody );
+			// Round trip through payload:
+			std::vector<uint8_t> tData;
+			multitrack::write_to_buffer<multitrack::BodyIndexRleRef>( tData, std::make_shared<multitrack::BodyIndexRle>( tRle ) );
+			multitrack::BodyIndexRleRef tRead = multitrack::read_from_buffer<multitrack::BodyIndexRleRef>( &tData[ 0 ], tData.size() );
+			tRead->unpack( tUnpacked );
+			tOk = tOk && equal_channels<uint8_t>( tUnpacked, tBody );
+		}
+		return report( "body index runs", tOk );
+	}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ci::fs::path tDirectory = ( argc > 1 ) ? ci::fs::path( argv[ 1 ] ) : ci::fs::temp_directory_path() / "KinectRecordingToolsCodecTest";
+	bool tPassed = true;
+	try {
+		ci::fs::remove_all( tDirectory );
+		ci::fs::create_directories( tDirectory );
+		tPassed = test_container( tDirectory ) && tPassed;
+		tPassed = test_channel_delta<uint16_t>( tDirectory, "depth delta", multitrack::kDefaultKeyframeInterval ) && tPassed;
+		tPassed = test_channel_delta<uint16_t>( tDirectory, "depth raw", 1 ) && tPassed;
+		tPassed = test_channel_delta<uint8_t>( tDirectory, "body index delta", 5 ) && tPassed;
+		tPassed = test_point_cloud( tDirectory, "point cloud float", false, multitrack::TrackFormat::CONTAINER ) && tPassed;
+		tPassed = test_point_cloud( tDirectory, "point cloud image (mapped)", false, multitrack::TrackFormat::MAPPED ) && tPassed;
+		tPassed = test_point_cloud( tDirectory, "point cloud quantized", true, multitrack::TrackFormat::CONTAINER ) && tPassed;
+		tPassed = test_point_cloud( tDirectory, "point cloud quantized (mapped)", true, multitrack::TrackFormat::MAPPED ) && tPassed;
+		tPassed = test_body_index_rle() && tPassed;
+	}
+	catch( const std::exception& e ) {
+		std::fprintf( stderr, "CodecTest: %s\n", e.what() );
+		return 1;
+	}
+	ci::fs::remove_all( tDirectory );
+	return tPassed ? 0 : 1;
+}
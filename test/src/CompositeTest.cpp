@@ -0,0 +1,99 @@
+/* ITP Future of Storytelling */
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include <KinectProcessingComposite.h>
+
+using namespace itp;
+
+namespace {
+
+	/** @brief deterministic pseudo-random generator (LCG), so failures reproduce */
+	struct Lcg
+	{
+		uint32_t mState;
+
+		Lcg(uint32_t iSeed) : mState( iSeed ) { /* no-op */ }
+
+		uint32_t next()				{ mState = mState * 1664525u + 1013904223u; return mState >> 8; }
+		float nextUnit()			{ return (float)next() / (float)( 1u << 24 ); }
+	};
+
+	/** @brief returns number of pixels that differ between two RGBA surfaces of equal size */
+	size_t count_differences(const ci::Surface8u& iA, const ci::Surface8u& iB)
+	{
+		size_t tCount = 0;
+		for( int32_t y = 0; y < iA.getHeight(); y++ ) {
+			const uint8_t* tA = iA.getData( ci::ivec2( 0, y ) );
+			const uint8_t* tB = iB.getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < iA.getWidth() * 4; x += 4 ) {
+				if( tA[ x ] != tB[ x ] || tA[ x + 1 ] != tB[ x + 1 ] || tA[ x + 2 ] != tB[ x + 2 ] || tA[ x + 3 ] != tB[ x + 3 ] ) tCount++;
+			}
+		}
+		return tCount;
+	}
+
+	/** @brief returns number of pixels whose alpha is not 255 minus the body-index value */
+	size_t count_alpha_errors(const ci::Surface8u& iSurface, const ci::Channel8u& iBody)
+	{
+		size_t tCount = 0;
+		for( int32_t y = 0; y < iSurface.getHeight(); y++ ) {
+			const uint8_t* tDst = iSurface.getData( ci::ivec2( 0, y ) );
+			for( int32_t x = 0; x < iSurface.getWidth(); x++ ) {
+				if( tDst[ x * 4 + 3 ] != 255 - *iBody.getData( ci::ivec2( x, y ) ) ) tCount++;
+			}
+		}
+		return tCount;
+	}
+
+} // namespace
+
+int main(int, char*[])
+{
+	// Synthesize frames with widths off the SIMD step, lookups past the edges and a few NaNs:
+	const ci::ivec2 tBodySize( 203, 61 );
+	const ci::ivec2 tColorSize( 97, 53 );
+	Lcg tRandom( 12345u );
+	ci::Surface8uRef tColor = ci::Surface8u::create( tColorSize.x, tColorSize.y, false, ci::SurfaceChannelOrder::BGR );
+	for( int32_t y = 0; y < tColorSize.y; y++ ) {
+		uint8_t* tDst = tColor->getData( ci::ivec2( 0, y ) );
+		for( int32_t x = 0; x < tColorSize.x * tColor->getPixelInc(); x++ ) tDst[ x ] = (uint8_t)tRandom.next();
+	}
+	ci::Surface32fRef tLookup = ci::Surface32f::create( tBodySize.x, tBodySize.y, false );
+	ci::Channel8uRef tBody = ci::Channel8u::create( tBodySize.x, tBodySize.y );
+	for( int32_t y = 0; y < tBodySize.y; y++ ) {
+		float* tDst = tLookup->getData( ci::ivec2( 0, y ) );
+		for( int32_t x = 0; x < tBodySize.x; x++, tDst += tLookup->getPixelInc() ) {
+			tDst[ 0 ] = tRandom.nextUnit() * 1.4f - 0.2f;
+			tDst[ 1 ] = ( tRandom.next() % 97 == 0 ) ? std::numeric_limits<float>::quiet_NaN() : tRandom.nextUnit() * 1.4f - 0.2f;
+			uint32_t tValue = tRandom.next() % 10;
+			*tBody->getData( ci::ivec2( x, y ) ) = ( tValue < 6 ) ? (uint8_t)tValue : multitrack::BodyIndexRle::kBackground;
+		}
+	}
+	multitrack::BodyIndexRleRef tBodyRle = std::make_shared<multitrack::BodyIndexRle>();
+	tBodyRle->pack( *tBody );
+	// Composite every mode with scalar and SSE2 paths, from plain and run-length packed body-index frames:
+	SilhouetteCompositor::Ref tScalar	= SilhouetteCompositor::create();
+	SilhouetteCompositor::Ref tSimd		= SilhouetteCompositor::create( tScalar->getPool() );
+	tScalar->setSimdEnabled( false );
+	if( ! ITP_SIMD_SSE2 ) std::printf( "SSE2 path not compiled in, checking scalar path only\n" );
+	const SilhouetteCompositor::Mode	tModes[] = { SilhouetteCompositor::COLOR, SilhouetteCompositor::GRAYSCALE, SilhouetteCompositor::SILHOUETTE };
+	const char*							tNames[] = { "color", "grayscale", "silhouette" };
+	bool tPassed = true;
+	for( size_t i = 0; i < 3; i++ ) {
+		tScalar->setMode( tModes[ i ] );
+		tSimd->setMode( tModes[ i ] );
+		for( int tPacked = 0; tPacked < 2; tPacked++ ) {
+			const ci::Surface8uRef& tExpected	= tPacked ? tScalar->update( tColor, tLookup, tBodyRle ) : tScalar->update( tColor, tLookup, tBody );
+			const ci::Surface8uRef& tActual		= tPacked ? tSimd->update( tColor, tLookup, tBodyRle ) : tSimd->update( tColor, tLookup, tBody );
+			size_t tDifferences	= count_differences( *tExpected, *tActual );
+			size_t tAlphaErrors	= count_alpha_errors( *tExpected, *tBody );
+			bool tOk = ( tDifferences == 0 && tAlphaErrors == 0 );
+			std::printf( "%-10s %-7s differing pixels %zu  alpha errors %zu  %s\n", tNames[ i ], tPacked ? "packed" : "plain", tDifferences, tAlphaErrors, tOk ? "ok" : "FAILED" );
+			tPassed = tPassed && tOk;
+		}
+	}
+	return tPassed ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/* ITP Future of Storytelling */
+
+#include <cstdio>
+#include <string>
+
+#include <SyntheticBenchmark.h>
+
+using namespace itp;
+
+namespace {
+
+	/** @brief returns printable name of a track format */
+	const char* format_name(multitrack::TrackFormat iFormat)
+	{
+		switch( iFormat ) {
+			case multitrack::TrackFormat::FILE_SEQUENCE:	return "file sequence";
+			case multitrack::TrackFormat::CONTAINER:		return "container";
+			case multitrack::TrackFormat::MAPPED:			return "mapped";
+		}
+		return "unknown";
+	}
+
+	/** @brief records and plays back synthetic streams in one track format, printing the benchmark; returns false on regression */
+	bool run_pipeline(const ci::fs::path& iDirectory, const char* iName, const synthetic::Device::Format& iFormat, multitrack::TrackFormat iTrackFormat)
+	{
+		ci::fs::path tDirectory = iDirectory / ( std::string( iName ) + "_" + std::to_string( (int)iTrackFormat ) );
+		ci::fs::remove_all( tDirectory );
+		ci::fs::create_directories( tDirectory );
+		synthetic::PipelineBenchmark tResult = synthetic::benchmark_synthetic_pipeline( tDirectory, iFormat, 2.0, iTrackFormat );
+		std::printf( "%-6s %-13s recorded %4llu  shown %4llu  missing %3llu  mismatched %3llu  held %3llu  push %6.2f ms (max %6.2f)  step %6.2f ms (max %6.2f)  %s\n",
+			iName, format_name( iTrackFormat ),
+			(unsigned long long)tResult.mRecordedCount, (unsigned long long)tResult.mShownCount,
+			(unsigned long long)tResult.mMissingCount, (unsigned long long)tResult.mMismatchCount, (unsigned long long)tResult.mUnderrunCount,
+			tResult.mPushMeanMs, tResult.mPushMaxMs, tResult.mStepMeanMs, tResult.mStepMaxMs,
+			tResult.passed() ? "ok" : "FAILED" );
+		return tResult.passed() && tResult.mRecordedCount > 0;
+	}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ci::fs::path tDirectory = ( argc > 1 ) ? ci::fs::path( argv[ 1 ] ) : ci::fs::temp_directory_path() / "KinectRecordingToolsTest";
+	bool tPassed = true;
+	try {
+		// Streams at the same rate, and color at half rate (frame times fall between playback steps):
+		const synthetic::Device::Format tFormats[] = {
+			synthetic::Device::Format().colorSize( ci::ivec2( 960, 540 ) ),
+			synthetic::Device::Format().colorSize( ci::ivec2( 960, 540 ) ).colorFps( 15.0 ).bodyCount( 2 )
+		};
+		const char* tNames[] = { "even", "mixed" };
+		const multitrack::TrackFormat tTrackFormats[] = { multitrack::TrackFormat::FILE_SEQUENCE, multitrack::TrackFormat::CONTAINER, multitrack::TrackFormat::MAPPED };
+		for( size_t i = 0; i < 2; i++ ) {
+			for( multitrack::TrackFormat tTrackFormat : tTrackFormats ) {
+				tPassed = run_pipeline( tDirectory, tNames[ i ], tFormats[ i ], tTrackFormat ) && tPassed;
+			}
+		}
+	}
+	catch( const std::exception& e ) {
+		std::fprintf( stderr, "PipelineTest: %s\n", e.what() );
+		return 1;
+	}
+	ci::fs::remove_all( tDirectory );
+	return tPassed ? 0 : 1;
+}
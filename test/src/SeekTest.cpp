@@ -0,0 +1,183 @@
+/* ITP Future of Storytelling */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <multitrack/Controller.h>
+
+using namespace itp;
+
+namespace {
+
+	typedef std::shared_ptr<size_t> IndexRef; //!< stand-in frame holding its own index
+
+	/** @brief deterministic pseudo-random generator (LCG), so failures reproduce */
+	struct Lcg
+	{
+		uint32_t mState;
+
+		Lcg(uint32_t iSeed) : mState( iSeed ) { /* no-op */ }
+
+		uint32_t next()				{ mState = mState * 1664525u + 1013904223u; return mState >> 8; }
+	};
+
+	/** @brief prints one check and returns its outcome */
+	bool report(const char* iName, bool iOk)
+	{
+		std::printf( "%-40s %s\n", iName, iOk ? "ok" : "FAILED" );
+		return iOk;
+	}
+
+	/** @brief fills cache past its budget and checks that least recently used frames go first */
+	bool test_cache_eviction()
+	{
+		multitrack::FrameCacheT<IndexRef>::Ref tCache = multitrack::FrameCacheT<IndexRef>::create( 100 );
+		for( size_t i = 0; i < 10; i++ ) {
+			tCache->put( i, std::make_shared<size_t>( i ), 30 );
+		}
+		// Only the last three fit; touching one keeps it past the next insertion:
+		IndexRef tItem;
+		bool tOk = ( tCache->size() == 3 && tCache->getBytes() == 90 && tCache->getEvictionCount() == 7 );
+		tOk = tOk && tCache->get( 7, tItem ) && *tItem == 7 && ! tCache->get( 6, tItem );
+		tCache->put( 10, std::make_shared<size_t>( 10 ), 30 );
+		tOk = tOk && tCache->contains( 7 ) && ! tCache->contains( 8 ) && tCache->contains( 9 ) && tCache->contains( 10 );
+		// Frames larger than budget are not kept, and shrinking the budget evicts:
+		tCache->put( 11, std::make_shared<size_t>( 11 ), 101 );
+		tOk = tOk && ! tCache->contains( 11 ) && tCache->size() == 3;
+		tCache->setBudget( 30 );
+		tOk = tOk && tCache->size() == 1 && tCache->contains( 10 );
+		tOk = tOk && tCache->getHitCount() == 1 && tCache->getMissCount() == 1;
+		return report( "cache eviction", tOk );
+	}
+
+	/** @brief polls prefetcher until frames of a window are ready (or a second passed); returns true if all hold their index */
+	bool wait_for_window(multitrack::FramePrefetcherT<IndexRef>& iPrefetcher, size_t iTarget, int iDirection, size_t iDepth)
+	{
+		std::chrono::steady_clock::time_point tDeadline = std::chrono::steady_clock::now() + std::chrono::seconds( 1 );
+		for( size_t k = 0; k <= iDepth; k++ ) {
+			size_t tIndex = ( iDirection < 0 ) ? iTarget - k : iTarget + k;
+			IndexRef tItem;
+			while( ! iPrefetcher.acquire( tIndex, tItem ) ) {
+				if( std::chrono::steady_clock::now() > tDeadline ) return false;
+				std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			}
+			if( *tItem != tIndex ) return false;
+		}
+		return true;
+	}
+
+	/** @brief prefetches forward and in reverse with a zero cache budget, and reports decode errors */
+	bool test_prefetch()
+	{
+		const size_t tDepth = 4;
+		multitrack::FrameCacheT<IndexRef>::Ref tCache = multitrack::FrameCacheT<IndexRef>::create( 0 );
+		multitrack::FramePrefetcherT<IndexRef>::Ref tPrefetcher = multitrack::FramePrefetcherT<IndexRef>::create(
+			tCache,
+			[] ( size_t iIndex ) -> IndexRef {
+				if( iIndex == 40 ) throw std::runtime_error( "decode failed" );
+				return std::make_shared<size_t>( iIndex );
+			},
+			[] ( const IndexRef& ) { return sizeof( size_t ); },
+			64,
+			tDepth );
+		tPrefetcher->request( 5, 1 );
+		bool tOk = wait_for_window( *tPrefetcher, 5, 1, tDepth );
+		tPrefetcher->request( 20, -1 );
+		tOk = tOk && wait_for_window( *tPrefetcher, 20, -1, tDepth );
+		tOk = tOk && tPrefetcher->getDecodeCount() >= 2 * ( tDepth + 1 ) && tCache->size() == 0;
+		// Decode error reaches the consumer:
+		bool tThrown = false;
+		tPrefetcher->request( 40, 1 );
+		std::chrono::steady_clock::time_point tDeadline = std::chrono::steady_clock::now() + std::chrono::seconds( 1 );
+		while( ! tThrown && std::chrono::steady_clock::now() < tDeadline ) {
+			IndexRef tItem;
+			try { tPrefetcher->acquire( 40, tItem ); } catch( const std::runtime_error& ) { tThrown = true; }
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		tPrefetcher->stop();
+		return report( "prefetch", tOk && tThrown );
+	}
+
+	/** @brief records frames holding their own index at 30 frames per second, then seeks playback back and forth */
+	bool test_seek(const ci::fs::path& iDirectory, const char* iName, multitrack::TrackFormat iFormat)
+	{
+		const size_t	tFrameCount	= 45;
+		const double	tFrameRate	= 30.0;
+		const long long	tTicks		= 10000000LL;
+		ci::fs::path tDirectory = iDirectory / ( std::string( "seek_" ) + std::to_string( (int)iFormat ) );
+		ci::fs::create_directories( tDirectory );
+		multitrack::ManualClock::Ref tClock = multitrack::ManualClock::create();
+		multitrack::Controller::Ref tController = multitrack::Controller::create( tDirectory, tClock );
+		tController->start();
+		// Record depth frames filled with their index (delta coded between keyframes in containers):
+		long tShown = -1;
+		multitrack::TrackT<ci::Channel16uRef>::Ref tTrack = tController->addPushRecorder<ci::Channel16uRef>( [&] ( const ci::Channel16uRef& iFrame ) {
+			if( iFrame ) tShown = *iFrame->getData( ci::ivec2( 3, 2 ) );
+		}, iFormat );
+		tTrack->setPrefetchDepth( 0 );
+		for( size_t i = 0; i < tFrameCount; i++ ) {
+			ci::Channel16uRef tFrame = ci::Channel16u::create( 8, 6 );
+			for( int32_t y = 0; y < 6; y++ ) {
+				for( int32_t x = 0; x < 8; x++ ) *tFrame->getData( ci::ivec2( x, y ) ) = (uint16_t)( ( x < 4 ) ? i : 0 );
+			}
+			tTrack->push( tFrame, 5000000LL + (long long)std::llround( (double)i * tTicks / tFrameRate ) );
+			tClock->advance( 1.0 / tFrameRate );
+			tController->update();
+		}
+		tController->completeRecorder();
+		tController->stop();
+		tController->start();
+		// Seek to the middle of frames in random order, then backwards (final frame is only shown at its own time):
+		Lcg tRandom( 19u );
+		std::vector<size_t> tOrder;
+		for( size_t i = 0; i < tFrameCount; i++ ) tOrder.push_back( tRandom.next() % ( tFrameCount - 1 ) );
+		for( size_t i = tFrameCount - 1; i > 0; i-- ) tOrder.push_back( i - 1 );
+		bool tOk = true;
+		for( size_t tIndex : tOrder ) {
+			tController->seek( ( (double)tIndex + 0.5 ) / tFrameRate );
+			tController->update();
+			tController->draw();
+			tOk = tOk && ( tShown == (long)tIndex );
+		}
+		// Seek while stopped is kept by start:
+		tController->stop();
+		tController->seek( 20.5 / tFrameRate );
+		tController->start();
+		tController->update();
+		tController->draw();
+		tOk = tOk && ( tShown == 20 ) && std::abs( tController->getPlayhead() - 20.5 / tFrameRate ) < 1e-9;
+		// Offline render puts playhead back:
+		tController->render( tFrameRate, 0.5, std::function<void(size_t, double)>() );
+		tController->update();
+		tController->draw();
+		tOk = tOk && ( tShown == 20 ) && tTrack->isOffline() == false;
+		tController->stop();
+		return report( iName, tOk );
+	}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ci::fs::path tDirectory = ( argc > 1 ) ? ci::fs::path( argv[ 1 ] ) : ci::fs::temp_directory_path() / "KinectRecordingToolsSeekTest";
+	bool tPassed = true;
+	try {
+		ci::fs::remove_all( tDirectory );
+		ci::fs::create_directories( tDirectory );
+		tPassed = test_cache_eviction() && tPassed;
+		tPassed = test_prefetch() && tPassed;
+		tPassed = test_seek( tDirectory, "seek (file sequence)", multitrack::TrackFormat::FILE_SEQUENCE ) && tPassed;
+		tPassed = test_seek( tDirectory, "seek (container)", multitrack::TrackFormat::CONTAINER ) && tPassed;
+		tPassed = test_seek( tDirectory, "seek (mapped)", multitrack::TrackFormat::MAPPED ) && tPassed;
+	}
+	catch( const std::exception& e ) {
+		std::fprintf( stderr, "SeekTest: %s\n", e.what() );
+		return 1;
+	}
+	ci::fs::remove_all( tDirectory );
+	return tPassed ? 0 : 1;
+}